@@ -0,0 +1,443 @@
+/* Copyright (C) 2024 DiUS Computing Pty Ltd.
+ * Licensed under the Apache 2.0 license.
+ *
+ * @author J Mattsson <jmattsson@dius.com.au>
+ */
+#include "esp_picokbc.h"
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  CKB_RAWSIZE_OFFS = 0,
+  CKB_BLOCKSIZE_OFFS = 4,
+  CKB_NRBLOCKS_OFFS = 8,
+  CKB_BLOCKOFFS_OFFS = 12,
+};
+
+static uint32_t ckb_u32(const uint8_t *p, unsigned offs)
+{
+  p += offs;
+  return (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | p[1] << 8 | p[0];
+}
+
+
+// --- Raw DEFLATE decoder --------------------------------------------------
+// Small and slow(ish) canonical Huffman decoding in the style of zlib's
+// puff.c. The blocks are small, so simplicity wins over table lookups.
+
+#define INF_MAXBITS 15
+#define INF_MAXLCODES 286
+#define INF_MAXDCODES 30
+#define INF_FIXLCODES 288
+
+typedef struct {
+  uint16_t count[INF_MAXBITS + 1];
+  uint16_t symbol[INF_FIXLCODES];
+} huffman_t;
+
+typedef struct {
+  const uint8_t *in;
+  const uint8_t *in_end;
+  uint32_t bitbuf;
+  unsigned bitcnt;
+  uint8_t *out;
+  uint8_t *out_pos;
+  uint8_t *out_end;
+  bool err;
+} inflate_t;
+
+static const uint16_t len_base[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t len_extra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t dist_base[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+  8193, 12289, 16385, 24577 };
+static const uint8_t dist_extra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static unsigned inf_bits(inflate_t *s, unsigned n)
+{
+  while (s->bitcnt < n)
+  {
+    if (s->in == s->in_end)
+    {
+      s->err = true;
+      return 0;
+    }
+    s->bitbuf |= (uint32_t)*s->in++ << s->bitcnt;
+    s->bitcnt += 8;
+  }
+  unsigned val = s->bitbuf & ((1u << n) - 1);
+  s->bitbuf >>= n;
+  s->bitcnt -= n;
+  return val;
+}
+
+static int inf_decode(inflate_t *s, const huffman_t *h)
+{
+  int code = 0, first = 0, index = 0;
+  for (unsigned len = 1; len <= INF_MAXBITS; ++len)
+  {
+    code |= inf_bits(s, 1);
+    int count = h->count[len];
+    if (code - count < first)
+      return h->symbol[index + (code - first)];
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+  s->err = true;
+  return -1;
+}
+
+static bool inf_build(huffman_t *h, const uint8_t *lengths, unsigned n)
+{
+  uint16_t offs[INF_MAXBITS + 1];
+
+  memset(h->count, 0, sizeof(h->count));
+  for (unsigned sym = 0; sym < n; ++sym)
+    h->count[lengths[sym]]++;
+  if (h->count[0] == n)
+    return true; // no codes, only an error if actually used
+
+  int left = 1;
+  for (unsigned len = 1; len <= INF_MAXBITS; ++len)
+  {
+    left <<= 1;
+    left -= h->count[len];
+    if (left < 0)
+      return false; // over-subscribed
+  }
+
+  offs[1] = 0;
+  for (unsigned len = 1; len < INF_MAXBITS; ++len)
+    offs[len + 1] = offs[len] + h->count[len];
+  for (unsigned sym = 0; sym < n; ++sym)
+    if (lengths[sym] != 0)
+      h->symbol[offs[lengths[sym]]++] = sym;
+  return true;
+}
+
+static bool inf_stored(inflate_t *s)
+{
+  s->bitbuf = 0;
+  s->bitcnt = 0;
+  if (s->in_end - s->in < 4)
+    return false;
+  unsigned len = s->in[0] | s->in[1] << 8;
+  unsigned nlen = s->in[2] | s->in[3] << 8;
+  s->in += 4;
+  if (len != (~nlen & 0xffff) ||
+      len > (unsigned)(s->in_end - s->in) ||
+      len > (unsigned)(s->out_end - s->out_pos))
+    return false;
+  memcpy(s->out_pos, s->in, len);
+  s->in += len;
+  s->out_pos += len;
+  return true;
+}
+
+static bool inf_codes(inflate_t *s, const huffman_t *lencode, const huffman_t *distcode)
+{
+  for (;;)
+  {
+    int sym = inf_decode(s, lencode);
+    if (s->err)
+      return false;
+    if (sym < 256)
+    {
+      if (s->out_pos == s->out_end)
+        return false;
+      *s->out_pos++ = sym;
+    }
+    else if (sym == 256)
+      return true;
+    else
+    {
+      sym -= 257;
+      if (sym >= 29)
+        return false;
+      unsigned len = len_base[sym] + inf_bits(s, len_extra[sym]);
+      sym = inf_decode(s, distcode);
+      if (s->err || sym < 0 || sym >= 30)
+        return false;
+      unsigned dist = dist_base[sym] + inf_bits(s, dist_extra[sym]);
+      if (s->err ||
+          dist > (unsigned)(s->out_pos - s->out) ||
+          len > (unsigned)(s->out_end - s->out_pos))
+        return false;
+      const uint8_t *from = s->out_pos - dist;
+      while (len--)
+        *s->out_pos++ = *from++;
+    }
+  }
+}
+
+static bool inf_fixed(inflate_t *s)
+{
+  static huffman_t lencode, distcode;
+  static bool built;
+
+  if (!built)
+  {
+    uint8_t lengths[INF_FIXLCODES];
+    unsigned sym = 0;
+    for (; sym < 144; ++sym) lengths[sym] = 8;
+    for (; sym < 256; ++sym) lengths[sym] = 9;
+    for (; sym < 280; ++sym) lengths[sym] = 7;
+    for (; sym < INF_FIXLCODES; ++sym) lengths[sym] = 8;
+    inf_build(&lencode, lengths, INF_FIXLCODES);
+    for (sym = 0; sym < INF_MAXDCODES; ++sym) lengths[sym] = 5;
+    inf_build(&distcode, lengths, INF_MAXDCODES);
+    built = true;
+  }
+  return inf_codes(s, &lencode, &distcode);
+}
+
+static bool inf_dynamic(inflate_t *s)
+{
+  static const uint8_t order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+  uint8_t lengths[INF_MAXLCODES + INF_MAXDCODES];
+  huffman_t lencode, distcode;
+
+  unsigned nlen = inf_bits(s, 5) + 257;
+  unsigned ndist = inf_bits(s, 5) + 1;
+  unsigned ncode = inf_bits(s, 4) + 4;
+  if (s->err || nlen > INF_MAXLCODES || ndist > INF_MAXDCODES)
+    return false;
+
+  unsigned index = 0;
+  for (; index < ncode; ++index)
+    lengths[order[index]] = inf_bits(s, 3);
+  for (; index < 19; ++index)
+    lengths[order[index]] = 0;
+  if (s->err || !inf_build(&lencode, lengths, 19))
+    return false;
+
+  index = 0;
+  while (index < nlen + ndist)
+  {
+    int sym = inf_decode(s, &lencode);
+    if (s->err)
+      return false;
+    if (sym < 16)
+      lengths[index++] = sym;
+    else
+    {
+      uint8_t len = 0;
+      unsigned rep;
+      if (sym == 16)
+      {
+        if (index == 0)
+          return false;
+        len = lengths[index - 1];
+        rep = 3 + inf_bits(s, 2);
+      }
+      else if (sym == 17)
+        rep = 3 + inf_bits(s, 3);
+      else
+        rep = 11 + inf_bits(s, 7);
+      if (s->err || index + rep > nlen + ndist)
+        return false;
+      while (rep--)
+        lengths[index++] = len;
+    }
+  }
+  if (lengths[256] == 0)
+    return false;
+
+  if (!inf_build(&lencode, lengths, nlen) ||
+      !inf_build(&distcode, lengths + nlen, ndist))
+    return false;
+  return inf_codes(s, &lencode, &distcode);
+}
+
+static bool inflate_block(
+  const uint8_t *in, uint32_t inlen, uint8_t *out, uint32_t outlen)
+{
+  inflate_t s = {
+    .in = in, .in_end = in + inlen,
+    .out = out, .out_pos = out, .out_end = out + outlen,
+  };
+  bool last;
+  do {
+    last = inf_bits(&s, 1);
+    unsigned type = inf_bits(&s, 2);
+    bool ok;
+    switch (type)
+    {
+      case 0: ok = inf_stored(&s); break;
+      case 1: ok = inf_fixed(&s); break;
+      case 2: ok = inf_dynamic(&s); break;
+      default: ok = false; break;
+    }
+    if (!ok || s.err)
+      return false;
+  } while (!last);
+  return s.out_pos == s.out_end;
+}
+
+
+// --- Compressed knowledge base access -------------------------------------
+
+const uint8_t *esp_pico_kbc_raw(const uint8_t *ckb)
+{
+  uint32_t nrblocks = ckb_u32(ckb, CKB_NRBLOCKS_OFFS);
+  return ckb + CKB_BLOCKOFFS_OFFS + (nrblocks + 1) * 4;
+}
+
+
+static bool inflate_nth_block(
+  const uint8_t *ckb, uint32_t nr, uint8_t *out, uint32_t outlen)
+{
+  uint32_t offs = ckb_u32(ckb, CKB_BLOCKOFFS_OFFS + nr * 4);
+  uint32_t end = ckb_u32(ckb, CKB_BLOCKOFFS_OFFS + (nr + 1) * 4);
+  if (end < offs)
+    return false;
+  return inflate_block(ckb + offs, end - offs, out, outlen);
+}
+
+
+bool esp_pico_kbc_inflate_all(const uint8_t *ckb, uint8_t *out, uint32_t size)
+{
+  uint32_t rawsize = ckb_u32(ckb, CKB_RAWSIZE_OFFS);
+  uint32_t blocksize = ckb_u32(ckb, CKB_BLOCKSIZE_OFFS);
+  uint32_t nrblocks = ckb_u32(ckb, CKB_NRBLOCKS_OFFS);
+  if (rawsize > size || blocksize == 0 ||
+      (size - rawsize + blocksize - 1) / blocksize != nrblocks)
+    return false;
+
+  memcpy(out, esp_pico_kbc_raw(ckb), rawsize);
+  for (uint32_t nr = 0; nr < nrblocks; ++nr)
+  {
+    uint32_t offs = rawsize + nr * blocksize;
+    uint32_t len = size - offs < blocksize ? size - offs : blocksize;
+    if (!inflate_nth_block(ckb, nr, out + offs, len))
+      return false;
+  }
+  return true;
+}
+
+
+typedef struct {
+  uint32_t nr;
+  uint32_t stamp;
+} cache_tag_t;
+
+struct esp_pico_kbc {
+  picoknow_block_reader_t reader; // must be first
+  const uint8_t *ckb;
+  uint32_t size;
+  uint32_t nrblocks;
+  unsigned nslots;
+  uint32_t clock;
+  uint32_t hits;
+  uint32_t misses;
+  cache_tag_t *tags;
+  uint8_t *slots;
+};
+
+#define NO_BLOCK UINT32_MAX
+
+static picoos_uint8 *kbc_get_block(picoknow_BlockReader reader, picoos_uint32 nr)
+{
+  esp_pico_kbc_t *kbc = (esp_pico_kbc_t *)reader;
+  uint32_t blocksize = kbc->reader.blockSize;
+
+  if (nr >= kbc->nrblocks)
+    return NULL;
+
+  // Tiny cache, linear scan for hit or least recently used slot is fine
+  unsigned victim = 0;
+  for (unsigned i = 0; i < kbc->nslots; ++i)
+  {
+    if (kbc->tags[i].nr == nr)
+    {
+      kbc->tags[i].stamp = ++kbc->clock;
+      ++kbc->hits;
+      return kbc->slots + i * blocksize;
+    }
+    if (kbc->tags[i].stamp < kbc->tags[victim].stamp)
+      victim = i;
+  }
+
+  ++kbc->misses;
+  uint8_t *slot = kbc->slots + victim * blocksize;
+  uint32_t offs = kbc->reader.rawSize + nr * blocksize;
+  uint32_t len = kbc->size - offs < blocksize ? kbc->size - offs : blocksize;
+  if (!inflate_nth_block(kbc->ckb, nr, slot, len))
+  {
+    kbc->tags[victim].nr = NO_BLOCK;
+    kbc->tags[victim].stamp = 0;
+    return NULL;
+  }
+  kbc->tags[victim].nr = nr;
+  kbc->tags[victim].stamp = ++kbc->clock;
+  return slot;
+}
+
+
+esp_pico_kbc_t *esp_pico_kbc_new(
+  const uint8_t *ckb, uint32_t size, unsigned cacheBlocks)
+{
+  uint32_t rawsize = ckb_u32(ckb, CKB_RAWSIZE_OFFS);
+  uint32_t blocksize = ckb_u32(ckb, CKB_BLOCKSIZE_OFFS);
+  uint32_t nrblocks = ckb_u32(ckb, CKB_NRBLOCKS_OFFS);
+  if (rawsize > size || blocksize == 0 || cacheBlocks == 0 ||
+      (size - rawsize + blocksize - 1) / blocksize != nrblocks)
+    return NULL;
+
+  esp_pico_kbc_t *kbc = calloc(1, sizeof(esp_pico_kbc_t));
+  if (!kbc)
+    return NULL;
+  kbc->tags = calloc(cacheBlocks, sizeof(cache_tag_t));
+  kbc->slots = malloc(cacheBlocks * blocksize);
+  if (!kbc->tags || !kbc->slots)
+  {
+    esp_pico_kbc_free(kbc);
+    return NULL;
+  }
+  for (unsigned i = 0; i < cacheBlocks; ++i)
+    kbc->tags[i].nr = NO_BLOCK;
+
+  kbc->reader.getBlock = kbc_get_block;
+  kbc->reader.rawSize = rawsize;
+  kbc->reader.blockSize = blocksize;
+  kbc->ckb = ckb;
+  kbc->size = size;
+  kbc->nrblocks = nrblocks;
+  kbc->nslots = cacheBlocks;
+  return kbc;
+}
+
+
+picoknow_BlockReader esp_pico_kbc_reader(esp_pico_kbc_t *kbc)
+{
+  return &kbc->reader;
+}
+
+
+void esp_pico_kbc_stats(
+  const esp_pico_kbc_t *kbc, uint32_t *hits, uint32_t *misses)
+{
+  *hits = kbc->hits;
+  *misses = kbc->misses;
+}
+
+
+void esp_pico_kbc_free(esp_pico_kbc_t *kbc)
+{
+  if (kbc)
+  {
+    free(kbc->slots);
+    free(kbc->tags);
+    free(kbc);
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef ESP_PICOKBC_H
+#define ESP_PICOKBC_H
+
+#include "picoknow.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Block compressed knowledge base support. A compressed kb, as written by
+// tools/picorsrc.py, looks like this (all values little endian):
+//
+//   ckb = RAWSIZE4 BLOCKSIZE4 NRBLOCKS4 {BLOCKOFFS4}=NRBLOCKS+1 raw {block}
+//
+// The first RAWSIZE bytes of the kb are stored as-is in 'raw'. The remaining
+// bytes are split into BLOCKSIZE sized chunks, each compressed independently
+// as a raw DEFLATE stream. BLOCKOFFS are relative to the start of the ckb.
+
+typedef struct esp_pico_kbc esp_pico_kbc_t;
+
+// Returns a pointer to the raw (uncompressed) prefix of a compressed kb.
+const uint8_t *esp_pico_kbc_raw(const uint8_t *ckb);
+
+// Decompresses the entire kb of 'size' bytes into 'out'.
+bool esp_pico_kbc_inflate_all(const uint8_t *ckb, uint8_t *out, uint32_t size);
+
+// Creates a block reader for a compressed kb of 'size' bytes, backed by a
+// cache of 'cacheBlocks' decompressed blocks.
+esp_pico_kbc_t *esp_pico_kbc_new(
+  const uint8_t *ckb, uint32_t size, unsigned cacheBlocks);
+
+// The reader to hook up to the knowledge base's blockReader.
+picoknow_BlockReader esp_pico_kbc_reader(esp_pico_kbc_t *kbc);
+
+// Cache statistics, for tuning the cache size.
+void esp_pico_kbc_stats(
+  const esp_pico_kbc_t *kbc, uint32_t *hits, uint32_t *misses);
+
+void esp_pico_kbc_free(esp_pico_kbc_t *kbc);
+
+#endif
@@ -6,6 +6,13 @@
 #include "picoapi.h"
 #include "picoapid.h"
 #include "picorsrc.h"
+#include "picokdt.h"
+#include "picokfst.h"
+#include "esp_picokbc.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#include <stdlib.h>
+#include <string.h>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
@@ -17,24 +24,417 @@
 
 #pragma GCC diagnostic pop
 
+#ifndef CONFIG_PICOTTS_RESOURCE_CACHE_BLOCKS
+#define CONFIG_PICOTTS_RESOURCE_CACHE_BLOCKS 8
+#endif
+
+#ifndef CONFIG_PICOTTS_RESOURCE_PROMOTE_BUDGET
+#define CONFIG_PICOTTS_RESOURCE_PROMOTE_BUDGET 0
+#endif
+
+#ifndef CONFIG_PICOTTS_DT_COMPILE_BUDGET
+#define CONFIG_PICOTTS_DT_COMPILE_BUDGET 0
+#endif
+
+#ifndef CONFIG_PICOTTS_FST_DENSE_BUDGET
+#define CONFIG_PICOTTS_FST_DENSE_BUDGET 0
+#endif
+
+#ifdef CONFIG_PICOTTS_RESOURCE_PROMOTE_INTERNAL
+#define PROMOTE_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#else
+#define PROMOTE_CAPS MALLOC_CAP_8BIT
+#endif
+
+// Compiled trees are aligned to the cache line size, so that the nodes
+// near the root share as few lines as possible
+#define DT_COMPILE_ALIGN 32
+#ifdef CONFIG_PICOTTS_DT_COMPILE_INTERNAL
+#define DT_COMPILE_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#else
+#define DT_COMPILE_CAPS MALLOC_CAP_8BIT
+#endif
+
+#ifdef CONFIG_PICOTTS_FST_DENSE_INTERNAL
+#define FST_DENSE_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#else
+#define FST_DENSE_CAPS MALLOC_CAP_8BIT
+#endif
+
 
 static uint16_t esp_pico_load_pi_u16(const char *raw, unsigned offs)
 {
-  uint16_t a = raw[offs];
-  uint16_t b = raw[offs+1];
+  const uint8_t *p = (const uint8_t *)raw + offs;
+  uint16_t a = p[0];
+  uint16_t b = p[1];
   return (b << 8 | a);
 }
 
 static uint32_t esp_pico_load_pi_u32(const char *raw, unsigned offs)
 {
-  uint32_t a = raw[offs];
-  uint32_t b = raw[offs+1];
-  uint32_t c = raw[offs+2];
-  uint32_t d = raw[offs+3];
-  return (d << 24 || c << 16 | b << 8 | a);
+  const uint8_t *p = (const uint8_t *)raw + offs;
+  uint32_t a = p[0];
+  uint32_t b = p[1];
+  uint32_t c = p[2];
+  uint32_t d = p[3];
+  return (d << 24 | c << 16 | b << 8 | a);
+}
+
+
+// The staged resources may carry a precomputed knowledge base directory
+// right after the resource data (see tools/picorsrc.py). All values are
+// little endian, and the trailer starts on the first 4-byte aligned offset
+// (relative to the start of the resource) following the data:
+//
+//   kbdir   = MAGIC4 VERSION1 NRKBS1 RESERVED2 DATALEN4 {kbentry}=NRKBS CHECK4
+//   kbentry = KBID1 FLAGS1 PRIO1 RESERVED1 OFFSET4 SIZE4
+//
+// CHECK4 is the inverted 32bit sum of all preceding trailer words. Using the
+// directory avoids walking the kb name and entry tables in flash on load.
+//
+// If FLAGS has KBDIR_FLAG_COMPRESSED set, the kb at OFFSET is stored block
+// compressed (see esp_picokbc.h) and SIZE is its uncompressed size. Such kbs
+// are only described correctly by the directory.
+//
+// If FLAGS has KBDIR_FLAG_PROMOTE set, the kb is copied into RAM on load,
+// provided it fits in what is left of the promotion budget. Kbs are promoted
+// in order of PRIO, lowest first.
+enum {
+  KBDIR_MAGIC = 0x44424b50, // "PKBD"
+  KBDIR_VERSION = 1,
+  KBDIR_HEADER_LEN = 12,
+  KBDIR_ENTRY_LEN = 12,
+  KBDIR_ALIGN = 4,
+  KBDIR_FLAG_COMPRESSED = 0x01,
+  KBDIR_FLAG_PROMOTE = 0x02,
+};
+
+static const char *find_kbdir(const char *raw, const char *data, uint32_t len)
+{
+  uintptr_t end = (uintptr_t)(data - raw) + len;
+  const char *dir = raw + ((end + KBDIR_ALIGN - 1) & ~(KBDIR_ALIGN - 1));
+
+  if (esp_pico_load_pi_u32(dir, 0) != KBDIR_MAGIC ||
+      dir[4] != KBDIR_VERSION ||
+      esp_pico_load_pi_u32(dir, 8) != len)
+    return NULL;
+
+  unsigned numKbs = (uint8_t)dir[5];
+  if (numKbs > PICOKNOW_MAX_NUM_RESOURCE_KBS)
+    return NULL;
+
+  unsigned words = (KBDIR_HEADER_LEN + numKbs * KBDIR_ENTRY_LEN) / 4;
+  uint32_t sum = 0;
+  for (unsigned i = 0; i < words; ++i)
+    sum += esp_pico_load_pi_u32(dir, i * 4);
+  if (esp_pico_load_pi_u32(dir, words * 4) != ~sum)
+    return NULL;
+
+  return dir;
+}
+
+
+// Memory held on behalf of a loaded resource, i.e. decompressed, promoted,
+// compiled or dense kbs. Promoted, compiled and dense kbs count towards their
+// respective budgets until released.
+typedef struct rsrc_mem {
+  struct rsrc_mem *next;
+  picorsrc_Resource owner;
+  esp_pico_kbc_t *kbc;
+  uint8_t *buf;
+  uint32_t promoted;
+  uint32_t compiled;
+  uint32_t dense;
+} rsrc_mem_t;
+
+static rsrc_mem_t *rsrcMem;
+static uint32_t promotedBytes;
+static uint32_t compiledBytes;
+static uint32_t denseBytes;
+
+static rsrc_mem_t *rsrc_mem_new(picorsrc_Resource owner)
+{
+  rsrc_mem_t *mem = calloc(1, sizeof(rsrc_mem_t));
+  if (mem)
+  {
+    mem->owner = owner;
+    mem->next = rsrcMem;
+    rsrcMem = mem;
+  }
+  return mem;
+}
+
+static void rsrc_mem_release(picorsrc_Resource owner)
+{
+  rsrc_mem_t **pp = &rsrcMem;
+  while (*pp)
+  {
+    rsrc_mem_t *mem = *pp;
+    if (mem->owner == owner)
+    {
+      *pp = mem->next;
+      esp_pico_kbc_free(mem->kbc);
+      free(mem->buf);
+      promotedBytes -= mem->promoted;
+      compiledBytes -= mem->compiled;
+      denseBytes -= mem->dense;
+      free(mem);
+    }
+    else
+      pp = &mem->next;
+  }
+}
+
+
+// The lexicon kbs fetch their lexblocks via the kb block reader, any other
+// compressed kb gets fully decompressed into RAM.
+static bool has_block_reader_support(picoknow_kb_id_t kbid)
+{
+  return
+    kbid == PICOKNOW_KBID_LEX_MAIN ||
+    kbid == PICOKNOW_KBID_LEX_USER_1 ||
+    kbid == PICOKNOW_KBID_LEX_USER_2;
+}
+
+static pico_status_t open_compressed_kb(picorsrc_Resource res,
+  picoknow_kb_id_t kbid, picoos_uint8 **base, uint32_t size,
+  picoknow_BlockReader *reader)
+{
+  rsrc_mem_t *mem = rsrc_mem_new(res);
+  if (!mem)
+    return PICO_EXC_OUT_OF_MEM;
+
+  if (has_block_reader_support(kbid))
+  {
+    mem->kbc =
+      esp_pico_kbc_new(*base, size, CONFIG_PICOTTS_RESOURCE_CACHE_BLOCKS);
+    if (!mem->kbc)
+      return PICO_EXC_OUT_OF_MEM;
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wdiscarded-qualifiers"
+    *base = esp_pico_kbc_raw(*base);
+    #pragma GCC diagnostic pop
+    *reader = esp_pico_kbc_reader(mem->kbc);
+  }
+  else
+  {
+    mem->buf = malloc(size);
+    if (!mem->buf)
+      return PICO_EXC_OUT_OF_MEM;
+    if (!esp_pico_kbc_inflate_all(*base, mem->buf, size))
+      return PICO_EXC_FILE_CORRUPT;
+    *base = mem->buf;
+  }
+  return PICO_OK;
+}
+
+
+// Copies a kb into RAM, decompressing it on the way if need be. Failing to
+// promote is not an error, the kb is then simply used from flash.
+static bool promote_kb(picorsrc_Resource res,
+  picoos_uint8 **base, uint32_t size, bool compressed)
+{
+  rsrc_mem_t *mem = rsrc_mem_new(res);
+  if (!mem)
+    return false;
+  mem->buf = heap_caps_malloc(size, PROMOTE_CAPS);
+  if (!mem->buf)
+    return false;
+  if (compressed)
+  {
+    if (!esp_pico_kbc_inflate_all(*base, mem->buf, size))
+    {
+      free(mem->buf);
+      mem->buf = NULL;
+      return false;
+    }
+  }
+  else
+    memcpy(mem->buf, *base, size);
+  mem->promoted = size;
+  promotedBytes += size;
+  *base = mem->buf;
+  return true;
+}
+
+// Picks which of the kbs marked for promotion fit within the remaining
+// budget, going by their priority.
+static void select_promotions(const char *dir, bool *promote)
+{
+  unsigned numKbs = (uint8_t)dir[5];
+  const char *entries = dir + KBDIR_HEADER_LEN;
+  uint32_t budget = CONFIG_PICOTTS_RESOURCE_PROMOTE_BUDGET * 1024;
+  uint32_t avail = budget > promotedBytes ? budget - promotedBytes : 0;
+
+  for (unsigned prio = 1; prio <= UINT8_MAX && avail; ++prio)
+  {
+    for (unsigned i = 0; i < numKbs; ++i)
+    {
+      const char *entry = entries + i * KBDIR_ENTRY_LEN;
+      uint32_t size = esp_pico_load_pi_u32(entry, 8);
+      if ((entry[1] & KBDIR_FLAG_PROMOTE) && (uint8_t)entry[2] == prio &&
+          esp_pico_load_pi_u32(entry, 4) != 0 && size <= avail)
+      {
+        promote[i] = true;
+        avail -= size;
+      }
+    }
+  }
+}
+
+
+// Decision trees in the order they are compiled in, by classification time
+// saved per KB of RAM (see README.md).
+static const picoknow_kb_id_t compileOrder[] = {
+  PICOKNOW_KBID_DT_MGC1, PICOKNOW_KBID_DT_MGC2, PICOKNOW_KBID_DT_MGC3,
+  PICOKNOW_KBID_DT_MGC4, PICOKNOW_KBID_DT_MGC5,
+  PICOKNOW_KBID_DT_LFZ1, PICOKNOW_KBID_DT_LFZ2, PICOKNOW_KBID_DT_LFZ3,
+  PICOKNOW_KBID_DT_LFZ4, PICOKNOW_KBID_DT_LFZ5,
+  PICOKNOW_KBID_DT_ACC, PICOKNOW_KBID_DT_PHR, PICOKNOW_KBID_DT_DUR,
+  PICOKNOW_KBID_DT_G2P, PICOKNOW_KBID_DT_POSD, PICOKNOW_KBID_DT_POSP,
+};
+
+// Expands the decision trees of a resource into their compiled form, for as
+// long as they fit in what is left of the budget. As with promotion, failing
+// to compile is not an error, the tree is then simply used as is.
+static void compile_trees(picorsrc_Resource res)
+{
+  uint32_t budget = CONFIG_PICOTTS_DT_COMPILE_BUDGET * 1024;
+
+  for (unsigned i = 0; i < sizeof(compileOrder)/sizeof(compileOrder[0]); ++i)
+  {
+    picoknow_KnowledgeBase kb = res->kbList;
+    while (kb && kb->id != compileOrder[i])
+      kb = kb->next;
+
+    uint32_t size = picokdt_getCompiledTreeSize(kb);
+    if (size == 0 || compiledBytes + size > budget)
+      continue;
+
+    rsrc_mem_t *mem = rsrc_mem_new(res);
+    if (!mem)
+      return;
+    mem->buf = heap_caps_aligned_alloc(
+      DT_COMPILE_ALIGN, size, DT_COMPILE_CAPS);
+    if (!mem->buf)
+      continue;
+    if (picokdt_compileTree(kb, mem->buf, size) != PICO_OK)
+    {
+      free(mem->buf);
+      mem->buf = NULL;
+      continue;
+    }
+    mem->compiled = size;
+    compiledBytes += size;
+  }
+}
+
+
+// FSTs in the order they are made dense in: the phonology FSTs are applied
+// to every phoneme of every sentence, the phonetic alphabet FSTs only to
+// <phoneme> tags.
+static const picoknow_kb_id_t denseOrder[] = {
+  PICOKNOW_KBID_FST_SPHO_1, PICOKNOW_KBID_FST_SPHO_2, PICOKNOW_KBID_FST_SPHO_3,
+  PICOKNOW_KBID_FST_SPHO_4, PICOKNOW_KBID_FST_SPHO_5, PICOKNOW_KBID_FST_SPHO_6,
+  PICOKNOW_KBID_FST_SPHO_7, PICOKNOW_KBID_FST_SPHO_8, PICOKNOW_KBID_FST_SPHO_9,
+  PICOKNOW_KBID_FST_SPHO_10,
+  PICOKNOW_KBID_FST_WPHO_1, PICOKNOW_KBID_FST_WPHO_2, PICOKNOW_KBID_FST_WPHO_3,
+  PICOKNOW_KBID_FST_WPHO_4, PICOKNOW_KBID_FST_WPHO_5,
+  PICOKNOW_KBID_FST_XSAMPA_PARSE, PICOKNOW_KBID_FST_SVOXPA_PARSE,
+  PICOKNOW_KBID_FST_XSAMPA2SVOXPA,
+};
+
+// Expands the FSTs of a resource into their dense form, for as long as they
+// fit in what is left of the budget. FSTs not made dense are used as is.
+static void make_fsts_dense(picorsrc_Resource res)
+{
+  uint32_t budget = CONFIG_PICOTTS_FST_DENSE_BUDGET * 1024;
+
+  for (unsigned i = 0; i < sizeof(denseOrder)/sizeof(denseOrder[0]); ++i)
+  {
+    picoknow_KnowledgeBase kb = res->kbList;
+    while (kb && kb->id != denseOrder[i])
+      kb = kb->next;
+
+    uint32_t size = picokfst_getDenseSize(kb);
+    if (size == 0 || denseBytes + size > budget)
+      continue;
+
+    rsrc_mem_t *mem = rsrc_mem_new(res);
+    if (!mem)
+      return;
+    mem->buf = heap_caps_malloc(size, FST_DENSE_CAPS);
+    if (!mem->buf)
+      continue;
+    if (picokfst_makeDense(kb, mem->buf, size) != PICO_OK)
+    {
+      free(mem->buf);
+      mem->buf = NULL;
+      continue;
+    }
+    mem->dense = size;
+    denseBytes += size;
+  }
+}
+
+
+void esp_pico_getResourceMemUsage(uint32_t *promoted, uint32_t *compiled, uint32_t *dense)
+{
+  *promoted = promotedBytes;
+  *compiled = compiledBytes;
+  *dense = denseBytes;
+}
+
+
+static pico_status_t getKbListFromDir(picorsrc_ResourceManager this,
+  picorsrc_Resource res, const char *dir)
+{
+  pico_status_t status = PICO_OK;
+  unsigned numKbs = (uint8_t)dir[5];
+  const char *entry = dir + KBDIR_HEADER_LEN;
+
+  bool promote[PICOKNOW_MAX_NUM_RESOURCE_KBS] = { false };
+  select_promotions(dir, promote);
+
+  res->kbList = NULL;
+  for (unsigned i = 0; i < numKbs && status == PICO_OK; ++i)
+  {
+    picoknow_kb_id_t kbid = (picoknow_kb_id_t)(uint8_t)entry[0];
+    uint8_t flags = entry[1];
+    uint32_t offset = esp_pico_load_pi_u32(entry, 4);
+    uint32_t size = esp_pico_load_pi_u32(entry, 8);
+    entry += KBDIR_ENTRY_LEN;
+
+    // As with picorsrc_getKbList(), an offset of 0 means mentioned but empty
+    picoos_uint8 *base = offset ? res->start + offset : NULL;
+    bool compressed = (flags & KBDIR_FLAG_COMPRESSED) != 0;
+    picoknow_BlockReader reader = NULL;
+    if (base && promote[i] && promote_kb(res, &base, size, compressed))
+      compressed = false;
+    if (base && compressed)
+      status = open_compressed_kb(res, kbid, &base, size, &reader);
+
+    picoknow_KnowledgeBase kb;
+    if (status == PICO_OK)
+      status = picorsrc_createKnowledgeBase(
+        this, base, size, kbid, reader, &kb);
+    if (status == PICO_OK)
+    {
+      kb->next = res->kbList;
+      res->kbList = kb;
+    }
+  }
+  return status;
 }
 
 
+enum {
+  SVOXHDR_OFFS = 0, // first 13 bytes = " (C) SVOX AG " downshifted by 0x20
+  HEADER_LEN_OFFS = 13, // header length read as le u16 after that
+  DATA_OFFS = HEADER_LEN_OFFS + 2,
+};
+
+
 pico_status_t verify_svox_header(const char *raw)
 {
   const char marker[] = " (C) SVOX AG ";
@@ -47,6 +447,57 @@ pico_status_t verify_svox_header(const char *raw)
 }
 
 
+// A bundle of resources, as written by tools/picorsrc.py bundle:
+//
+//   bundle = MAGIC4 VERSION1 NUM1 RESERVED2 {OFFSET4 SIZE4}=NUM resources
+//
+// OFFSET is relative to the start of the bundle.
+enum {
+  BUNDLE_MAGIC = 0x444e4250, // "PBND"
+  BUNDLE_VERSION = 1,
+  BUNDLE_HEADER_LEN = 8,
+  BUNDLE_ENTRY_LEN = 8,
+};
+
+// Resource names start with the language, e.g. "en-GB_ta_1.1.0.0-0-1"
+static bool is_resource_for(const char *raw, const char *lang)
+{
+  if (verify_svox_header(raw + SVOXHDR_OFFS) != PICO_OK)
+    return false;
+
+  picoos_file_header_t header;
+  #pragma GCC diagnostic push
+  #pragma GCC diagnostic ignored "-Wdiscarded-qualifiers"
+  if (picoos_hdrParseHeader(&header, raw + DATA_OFFS) != PICO_OK)
+    return false;
+  #pragma GCC diagnostic pop
+
+  const char *name = (const char *)header.field[PICOOS_HEADER_NAME].value;
+  size_t len = strlen(lang);
+  return strncmp(name, lang, len) == 0 && name[len] == '_';
+}
+
+
+const void *esp_pico_findResource(const void *bundle, const char *lang)
+{
+  const char *raw = bundle;
+  if (esp_pico_load_pi_u32(raw, 0) != BUNDLE_MAGIC)
+    return is_resource_for(raw, lang) ? raw : NULL;
+
+  if (raw[4] != BUNDLE_VERSION)
+    return NULL;
+  unsigned num = (uint8_t)raw[5];
+  for (unsigned i = 0; i < num; ++i)
+  {
+    const char *rsrc = raw +
+      esp_pico_load_pi_u32(raw, BUNDLE_HEADER_LEN + i * BUNDLE_ENTRY_LEN);
+    if (is_resource_for(rsrc, lang))
+      return rsrc;
+  }
+  return NULL;
+}
+
+
 pico_status_t esp_pico_loadResource(pico_System sys, const void *raw, pico_Resource *outResource)
 {
   picorsrc_Resource *resource = (picorsrc_Resource *)outResource;
@@ -62,11 +513,6 @@ pico_status_t esp_pico_loadResource(pico_System sys, const void *raw, pico_Resou
       NULL, (picoos_char *)"no more than %i resources", PICO_MAX_NUM_RESOURCES);
   }
 
-  enum {
-    SVOXHDR_OFFS = 0, // first 13 bytes = " (C) SVOX AG " downshifted by 0x20
-    HEADER_LEN_OFFS = 13, // header length read as le u16 after that
-    DATA_OFFS = HEADER_LEN_OFFS + 2,
-  };
   pico_status_t status = verify_svox_header(raw + SVOXHDR_OFFS);
   if (status != PICO_OK)
     return picoos_emRaiseException(this->common->em, PICO_EXC_FILE_CORRUPT, NULL, NULL);
@@ -121,13 +567,25 @@ pico_status_t esp_pico_loadResource(pico_System sys, const void *raw, pico_Resou
       res->type = PICORSRC_TYPE_TEXTANA;
     else if (picoos_strcmp(ctype, PICORSRC_FIELD_VALUE_SIGGEN) == 0)
       res->type = PICORSRC_TYPE_SIGGEN;
+    else if (picoos_strcmp(ctype, PICORSRC_FIELD_VALUE_USERLEX) == 0)
+      res->type = PICORSRC_TYPE_USER_LEX;
     else
       res->type = PICORSRC_TYPE_OTHER;
 
-    // Create kb list from resource
-    status = picorsrc_getKbList(this, res->start, len, &res->kbList);
+    // Create kb list from resource, preferably via the precomputed directory
+    const char *dir = find_kbdir((const char *)raw, data, len);
+    if (dir)
+      status = getKbListFromDir(this, res, dir);
+    else
+      status = picorsrc_getKbList(this, res->start, len, &res->kbList);
   }
 
+  if (status == PICO_OK && CONFIG_PICOTTS_DT_COMPILE_BUDGET > 0)
+    compile_trees(res);
+
+  if (status == PICO_OK && CONFIG_PICOTTS_FST_DENSE_BUDGET > 0)
+    make_fsts_dense(res);
+
   if (status == PICO_OK)
   {
     res->next = this->resources;
@@ -136,6 +594,10 @@ pico_status_t esp_pico_loadResource(pico_System sys, const void *raw, pico_Resou
     *resource = res;
   }
   else {
+    if (res->kbList)
+      picorsrc_releaseKbList(this, &res->kbList);
+    rsrc_mem_release(res);
+    res->raw_mem = NULL; // points into flash, nothing to deallocate
     picorsrc_disposeResource(this->common->mm, &res);
   }
   return status;
@@ -172,6 +634,7 @@ pico_status_t esp_pico_unloadResource(pico_System sys, pico_Resource *inResource
 
   if (NULL != rsrc->kbList)
     picorsrc_releaseKbList(this, &rsrc->kbList);
+  rsrc_mem_release(rsrc);
 
   picoos_deallocate(this->common->mm,(void **)resource);
   this->numResources--;
@@ -2,9 +2,18 @@
 #define ESP_PICORSRC_H
 
 #include "picorsrc.h"
+#include <stdint.h>
+
+// Returns the resource for language 'lang' (e.g. "en-GB") within 'bundle',
+// or NULL if there is none. The bundle may also be a single resource.
+const void *esp_pico_findResource(const void *bundle, const char *lang);
 
 pico_status_t esp_pico_loadResource(pico_System sys, const void *raw, pico_Resource *resource);
 
 pico_status_t esp_pico_unloadResource(pico_System sys, pico_Resource *inResource);
 
+// Returns the RAM currently held across all loaded resources for promoted
+// kbs, compiled decision trees and dense FSTs, in bytes.
+void esp_pico_getResourceMemUsage(uint32_t *promoted, uint32_t *compiled, uint32_t *dense);
+
 #endif
@@ -0,0 +1,781 @@
+/* Copyright (C) 2024 DiUS Computing Pty Ltd.
+ * Licensed under the Apache 2.0 license.
+ *
+ * @author J Mattsson <jmattsson@dius.com.au>
+ */
+#include "esp_picossml.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+enum {
+  SSML_TEXT,
+  SSML_ENTITY,
+  SSML_TAG,
+  SSML_COMMENT,
+};
+
+// Longest entity name, "#x10FFFF"
+#define SSML_ENTITY_MAX 8
+
+#define SSML_MAX_ATTRS 6
+
+#define SSML_LEVEL_DEFAULT 100
+
+typedef struct
+{
+  const char *name;
+  unsigned nrAttrs;
+  const char *attrName[SSML_MAX_ATTRS];
+  const char *attrVal[SSML_MAX_ATTRS];
+} ssml_tag_t;
+
+typedef struct
+{
+  const char *name;
+  uint16_t level;
+} ssml_keyword_t;
+
+// How a <prosody> attribute maps onto an engine level. The engine levels
+// are percentages of the voice's default, within the limits picotok.c
+// enforces.
+typedef struct
+{
+  const char *attr;
+  const char *markup;
+  size_t offs;
+  uint16_t min;
+  uint16_t max;
+  // Level per unit of a plain number, 0 if plain numbers are not allowed
+  uint16_t plain;
+  // Logarithmic unit and the factor one step of it changes the level by
+  const char *unit;
+  float unitFactor;
+  ssml_keyword_t keywords[7];
+} ssml_prosody_attr_t;
+
+static const ssml_prosody_attr_t prosodyAttrs[] = {
+  {
+    "rate", "speed", offsetof(esp_pico_ssml_levels_t, speed), 20, 500,
+    100, NULL, 1.0f,
+    {
+      { "x-slow", 50 }, { "slow", 70 }, { "medium", 100 }, { "fast", 140 },
+      { "x-fast", 200 }, { "default", 100 }, { NULL, 0 }
+    },
+  },
+  {
+    "pitch", "pitch", offsetof(esp_pico_ssml_levels_t, pitch), 50, 200,
+    0, "st", 1.0594631f,
+    {
+      { "x-low", 60 }, { "low", 80 }, { "medium", 100 }, { "high", 125 },
+      { "x-high", 150 }, { "default", 100 }, { NULL, 0 }
+    },
+  },
+  {
+    "volume", "volume", offsetof(esp_pico_ssml_levels_t, volume), 0, 500,
+    1, "dB", 1.1220185f,
+    {
+      { "silent", 0 }, { "x-soft", 25 }, { "soft", 50 }, { "medium", 100 },
+      { "loud", 150 }, { "x-loud", 200 }, { "default", 100 }
+    },
+  },
+};
+
+// Break strengths, in ms
+static const ssml_keyword_t breakStrengths[] = {
+  { "x-weak", 100 }, { "weak", 200 }, { "medium", 400 }, { "strong", 700 },
+  { "x-strong", 1000 }, { NULL, 0 }
+};
+
+static const char *const spellTypes[] = {
+  "characters", "spell-out", "verbatim", NULL
+};
+
+
+static bool ssml_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+
+static bool ssml_letter(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+
+static bool ssml_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+
+// Writes engine input. A '<' that came from the text must not run into
+// something the engine would read as a markup tag, so a tab, which ends
+// the tag without being spoken, is put between them where needed.
+static void ssml_emit(esp_pico_ssml_t *ssml, const char *txt, unsigned len)
+{
+  if (!len)
+    return;
+  if (ssml->ltPending)
+  {
+    char c = txt[0];
+    if (c == '/' || c == ' ' || ssml_letter(c))
+      ssml->out("\t", 1, ssml->arg);
+    ssml->ltPending = false;
+  }
+  ssml->out(txt, len, ssml->arg);
+  ssml->ltPending = txt[len - 1] == '<';
+}
+
+
+static void ssml_emit_str(esp_pico_ssml_t *ssml, const char *str)
+{
+  ssml_emit(ssml, str, strlen(str));
+}
+
+
+// Writes text to be spoken, with line breaks and tabs as spaces.
+static void ssml_text(esp_pico_ssml_t *ssml, const char *txt, unsigned len)
+{
+  if (ssml->skip)
+    return;
+  const char *end = txt + len;
+  while (txt < end)
+  {
+    const char *run = txt;
+    while (txt < end && (*txt == ' ' || !ssml_space(*txt)))
+      ++txt;
+    ssml_emit(ssml, run, txt - run);
+    if (txt < end)
+    {
+      ssml_emit(ssml, " ", 1);
+      ++txt;
+    }
+  }
+}
+
+
+// Writes an attribute value for the engine markup, escaping its quotes.
+static void ssml_emit_value(esp_pico_ssml_t *ssml, const char *val)
+{
+  ssml_emit(ssml, "\"", 1);
+  while (*val)
+  {
+    size_t n = strcspn(val, "\"\\");
+    ssml_emit(ssml, val, n);
+    val += n;
+    if (*val)
+    {
+      ssml_emit(ssml, "\\", 1);
+      ssml_emit(ssml, val++, 1);
+    }
+  }
+  ssml_emit(ssml, "\"", 1);
+}
+
+
+// Decodes the entity 'name' (without & and ;) into 'utf8', returning the
+// number of bytes written, or 0 if it is not a valid entity.
+static unsigned ssml_entity(const char *name, char *utf8)
+{
+  static const struct {
+    const char *name;
+    char c;
+  } named[] = {
+    { "amp", '&' }, { "lt", '<' }, { "gt", '>' }, { "quot", '"' },
+    { "apos", '\'' },
+  };
+
+  uint32_t cp = 0;
+  if (name[0] == '#')
+  {
+    bool hex = name[1] == 'x' || name[1] == 'X';
+    const char *num = name + (hex ? 2 : 1);
+    char *end;
+    if (!ssml_digit(*num) && !(hex && strchr("abcdefABCDEF", *num)))
+      return 0;
+    cp = strtoul(num, &end, hex ? 16 : 10);
+    if (*end || cp == 0 || cp > 0x10ffff || (cp >= 0xd800 && cp < 0xe000))
+      return 0;
+  }
+  else
+  {
+    for (unsigned i = 0; i < sizeof(named) / sizeof(named[0]); ++i)
+    {
+      if (strcmp(name, named[i].name) == 0)
+      {
+        utf8[0] = named[i].c;
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  if (cp < 0x80)
+  {
+    utf8[0] = cp;
+    return 1;
+  }
+  else if (cp < 0x800)
+  {
+    utf8[0] = 0xc0 | (cp >> 6);
+    utf8[1] = 0x80 | (cp & 0x3f);
+    return 2;
+  }
+  else if (cp < 0x10000)
+  {
+    utf8[0] = 0xe0 | (cp >> 12);
+    utf8[1] = 0x80 | ((cp >> 6) & 0x3f);
+    utf8[2] = 0x80 | (cp & 0x3f);
+    return 3;
+  }
+  utf8[0] = 0xf0 | (cp >> 18);
+  utf8[1] = 0x80 | ((cp >> 12) & 0x3f);
+  utf8[2] = 0x80 | ((cp >> 6) & 0x3f);
+  utf8[3] = 0x80 | (cp & 0x3f);
+  return 4;
+}
+
+
+// Decodes the entities in an attribute value in place. Unknown entities
+// are left as they are.
+static void ssml_decode_value(char *val)
+{
+  char *out = val;
+  while (*val)
+  {
+    char *semi = NULL;
+    if (*val == '&')
+      semi = strchr(val, ';');
+    if (semi && semi - val <= SSML_ENTITY_MAX + 1)
+    {
+      char utf8[4];
+      *semi = 0;
+      unsigned n = ssml_entity(val + 1, utf8);
+      *semi = ';';
+      if (n)
+      {
+        memcpy(out, utf8, n);
+        out += n;
+        val = semi + 1;
+        continue;
+      }
+    }
+    *out++ = *val++;
+  }
+  *out = 0;
+}
+
+
+static const char *ssml_attr(const ssml_tag_t *t, const char *name)
+{
+  for (unsigned i = 0; i < t->nrAttrs; ++i)
+  {
+    if (strcmp(t->attrName[i], name) == 0)
+      return t->attrVal[i];
+  }
+  return NULL;
+}
+
+
+static bool ssml_keyword(
+  const ssml_keyword_t *kw, unsigned n, const char *name, uint16_t *level)
+{
+  for (unsigned i = 0; i < n && kw[i].name; ++i)
+  {
+    if (strcmp(kw[i].name, name) == 0)
+    {
+      *level = kw[i].level;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+// Applies an SSML prosody attribute value to the current level. Keywords
+// and plain numbers are relative to the default level; percentages and
+// semitone or decibel changes are relative to the current level. Values
+// that cannot be parsed leave the level as it is.
+static uint16_t ssml_prosody_level(
+  const ssml_prosody_attr_t *pa, const char *val, uint16_t cur)
+{
+  uint16_t level;
+  if (ssml_keyword(pa->keywords, 7, val, &level))
+    return level;
+
+  bool sign = val[0] == '+' || val[0] == '-';
+  char *unit;
+  float n = strtof(val, &unit);
+  if (unit == val)
+    return cur;
+
+  float x;
+  if (strcmp(unit, "%") == 0)
+    x = sign ? cur * (100.0f + n) / 100.0f : cur * n / 100.0f;
+  else if (pa->unit && strcmp(unit, pa->unit) == 0)
+    x = cur * powf(pa->unitFactor, n);
+  else if (!*unit && !sign && pa->plain)
+    x = n * pa->plain;
+  else
+    return cur;
+
+  if (x < pa->min)
+    return pa->min;
+  if (x > pa->max)
+    return pa->max;
+  return (uint16_t)lroundf(x);
+}
+
+
+static uint16_t *ssml_level_field(
+  esp_pico_ssml_levels_t *levels, const ssml_prosody_attr_t *pa)
+{
+  return (uint16_t *)((char *)levels + pa->offs);
+}
+
+
+// Writes the engine markup to go from one set of levels to another.
+static void ssml_emit_levels(
+  esp_pico_ssml_t *ssml,
+  esp_pico_ssml_levels_t *from, esp_pico_ssml_levels_t *to)
+{
+  for (unsigned i = 0; i < sizeof(prosodyAttrs) / sizeof(prosodyAttrs[0]); ++i)
+  {
+    const ssml_prosody_attr_t *pa = &prosodyAttrs[i];
+    uint16_t level = *ssml_level_field(to, pa);
+    if (*ssml_level_field(from, pa) != level)
+    {
+      char str[32];
+      int n = snprintf(str, sizeof(str), "<%s level=\"%u\">",
+        pa->markup, (unsigned)level);
+      ssml_emit(ssml, str, n);
+    }
+  }
+}
+
+
+static void ssml_reset(esp_pico_ssml_t *ssml)
+{
+  ssml->prosodyDepth = 0;
+  ssml->sayAs = ssml->phoneme = 0;
+  ssml->sayAsDepth = ssml->phonemeDepth = 0;
+  ssml->skip = 0;
+}
+
+
+static void ssml_speak(esp_pico_ssml_t *ssml, const ssml_tag_t *t, bool start)
+{
+  (void)t;
+  if (start)
+    return;
+  // Leave the engine as the next document expects to find it
+  unsigned top = ssml->prosodyDepth;
+  if (top > ESP_PICO_SSML_DEPTH)
+    top = ESP_PICO_SSML_DEPTH;
+  ssml_emit_levels(ssml, &ssml->levels[top], &ssml->levels[0]);
+  ssml_reset(ssml);
+  ssml_emit(ssml, "", 1);
+}
+
+
+// Nested <prosody> elements beyond ESP_PICO_SSML_DEPTH are ignored.
+static void ssml_prosody(esp_pico_ssml_t *ssml, const ssml_tag_t *t, bool start)
+{
+  unsigned depth = ssml->prosodyDepth;
+  if (start)
+  {
+    ssml->prosodyDepth = depth < 255 ? depth + 1 : depth;
+    if (depth >= ESP_PICO_SSML_DEPTH)
+      return;
+    esp_pico_ssml_levels_t *cur = &ssml->levels[depth];
+    esp_pico_ssml_levels_t *next = &ssml->levels[depth + 1];
+    *next = *cur;
+    for (unsigned i = 0; i < sizeof(prosodyAttrs) / sizeof(prosodyAttrs[0]); ++i)
+    {
+      const ssml_prosody_attr_t *pa = &prosodyAttrs[i];
+      const char *val = ssml_attr(t, pa->attr);
+      if (val)
+        *ssml_level_field(next, pa) =
+          ssml_prosody_level(pa, val, *ssml_level_field(cur, pa));
+    }
+    ssml_emit_levels(ssml, cur, next);
+  }
+  else if (depth > 0)
+  {
+    ssml->prosodyDepth = depth - 1;
+    if (depth <= ESP_PICO_SSML_DEPTH)
+      ssml_emit_levels(ssml, &ssml->levels[depth], &ssml->levels[depth - 1]);
+  }
+}
+
+
+static void ssml_break(esp_pico_ssml_t *ssml, const ssml_tag_t *t, bool start)
+{
+  if (!start)
+    return;
+  const char *time = ssml_attr(t, "time");
+  const char *strength = ssml_attr(t, "strength");
+  uint16_t ms = 400;
+  if (time)
+  {
+    char *unit;
+    float n = strtof(time, &unit);
+    if (unit == time || n < 0)
+      return;
+    if (strcmp(unit, "s") == 0)
+      n *= 1000.0f;
+    else if (strcmp(unit, "ms") != 0)
+      return;
+    ms = n > 65535.0f ? 65535 : (uint16_t)lroundf(n);
+  }
+  else if (strength && !ssml_keyword(breakStrengths, 6, strength, &ms))
+    return;
+
+  char str[32];
+  int n = snprintf(str, sizeof(str), "<break time=\"%ums\"/>", (unsigned)ms);
+  ssml_emit(ssml, str, n);
+}
+
+
+// Pushes (on start) or pops (on end) whether engine markup was written for
+// an element, returning that for the element popped.
+static bool ssml_nest(uint32_t *bits, uint8_t *depth, bool start, bool open)
+{
+  if (start)
+  {
+    if (*depth < 32)
+      *bits = (*bits << 1) | open;
+    if (*depth < 255)
+      ++*depth;
+    return open;
+  }
+  if (*depth == 0)
+    return false;
+  if (--*depth >= 32)
+    return false;
+  open = *bits & 1;
+  *bits >>= 1;
+  return open;
+}
+
+
+static void ssml_phoneme(esp_pico_ssml_t *ssml, const ssml_tag_t *t, bool start)
+{
+  bool open = false;
+  if (start && ssml->phonemeDepth < 32)
+  {
+    const char *alphabet = ssml_attr(t, "alphabet");
+    const char *ph = ssml_attr(t, "ph");
+    open = ph && (!alphabet ||
+      strcasecmp(alphabet, "x-sampa") == 0 ||
+      strcasecmp(alphabet, "xsampa") == 0);
+  }
+  if (ssml_nest(&ssml->phoneme, &ssml->phonemeDepth, start, open))
+  {
+    if (start)
+    {
+      ssml_emit_str(ssml, "<phoneme alphabet=\"xsampa\" ph=");
+      ssml_emit_value(ssml, ssml_attr(t, "ph"));
+      ssml_emit(ssml, ">", 1);
+    }
+    else
+      ssml_emit_str(ssml, "</phoneme>");
+  }
+}
+
+
+static void ssml_say_as(esp_pico_ssml_t *ssml, const ssml_tag_t *t, bool start)
+{
+  bool open = false;
+  if (start && ssml->sayAsDepth < 32)
+  {
+    const char *type = ssml_attr(t, "interpret-as");
+    for (unsigned i = 0; type && spellTypes[i]; ++i)
+      open |= strcmp(type, spellTypes[i]) == 0;
+  }
+  if (ssml_nest(&ssml->sayAs, &ssml->sayAsDepth, start, open))
+    ssml_emit_str(ssml, start ? "<spell>" : "</spell>");
+}
+
+
+// The engine plays the clip or file named by the source instead of speaking
+// the content, which is spoken if there is none of that name.
+static void ssml_audio(esp_pico_ssml_t *ssml, const ssml_tag_t *t, bool start)
+{
+  bool open = start && ssml->audioDepth < 32 && ssml_attr(t, "src");
+  if (ssml_nest(&ssml->audio, &ssml->audioDepth, start, open))
+  {
+    if (start)
+    {
+      ssml_emit_str(ssml, "<play file=");
+      ssml_emit_value(ssml, ssml_attr(t, "src"));
+      ssml_emit(ssml, ">", 1);
+    }
+    else
+      ssml_emit_str(ssml, "</play>");
+  }
+}
+
+
+static void ssml_mark(esp_pico_ssml_t *ssml, const ssml_tag_t *t, bool start)
+{
+  const char *name = ssml_attr(t, "name");
+  if (!start || !name)
+    return;
+  ssml_emit_str(ssml, "<mark name=");
+  ssml_emit_value(ssml, name);
+  ssml_emit_str(ssml, "/>");
+}
+
+
+static void ssml_s(esp_pico_ssml_t *ssml, const ssml_tag_t *t, bool start)
+{
+  (void)t;
+  ssml_emit_str(ssml, start ? "<s>" : "</s>");
+}
+
+
+static void ssml_p(esp_pico_ssml_t *ssml, const ssml_tag_t *t, bool start)
+{
+  (void)t;
+  ssml_emit_str(ssml, start ? "<p>" : "</p>");
+}
+
+
+// Elements whose content is not spoken, <sub> speaking its alias instead.
+static void ssml_skip(esp_pico_ssml_t *ssml, const ssml_tag_t *t, bool start)
+{
+  if (start)
+  {
+    const char *alias = ssml_attr(t, "alias");
+    if (alias)
+      ssml_text(ssml, alias, strlen(alias));
+    if (ssml->skip < 255)
+      ++ssml->skip;
+  }
+  else if (ssml->skip)
+    --ssml->skip;
+}
+
+
+typedef void (*ssml_element_fn)(
+  esp_pico_ssml_t *ssml, const ssml_tag_t *t, bool start);
+
+static const struct {
+  const char *name;
+  ssml_element_fn fn;
+} elements[] = {
+  { "speak", ssml_speak },
+  { "prosody", ssml_prosody },
+  { "break", ssml_break },
+  { "phoneme", ssml_phoneme },
+  { "say-as", ssml_say_as },
+  { "mark", ssml_mark },
+  { "audio", ssml_audio },
+  { "s", ssml_s },
+  { "p", ssml_p },
+  { "sub", ssml_skip },
+  { "desc", ssml_skip },
+  { "metadata", ssml_skip },
+};
+
+
+static void ssml_parse_attrs(char *p, ssml_tag_t *t)
+{
+  while (t->nrAttrs < SSML_MAX_ATTRS)
+  {
+    while (ssml_space(*p))
+      ++p;
+    char *name = p;
+    while (*p && *p != '=' && !ssml_space(*p))
+      ++p;
+    char *nameEnd = p;
+    while (ssml_space(*p))
+      ++p;
+    if (p == name || *p != '=')
+      return;
+    *nameEnd = 0;
+    ++p;
+    while (ssml_space(*p))
+      ++p;
+    char quote = *p;
+    if (quote != '"' && quote != '\'')
+      return;
+    char *val = ++p;
+    p = strchr(p, quote);
+    if (!p)
+      return;
+    *p++ = 0;
+    ssml_decode_value(val);
+    t->attrName[t->nrAttrs] = name;
+    t->attrVal[t->nrAttrs] = val;
+    t->nrAttrs++;
+  }
+}
+
+
+// Handles the tag collected in the buffer, i.e. everything between < and >.
+static void ssml_tag(esp_pico_ssml_t *ssml)
+{
+  char *p = ssml->buf;
+  unsigned len = ssml->len;
+  p[len] = 0;
+  if (*p == '?' || *p == '!')
+    return;
+
+  bool end = *p == '/';
+  bool empty = !end && len > 0 && p[len - 1] == '/';
+  if (end)
+    ++p;
+  if (empty)
+    p[len - 1] = 0;
+
+  ssml_tag_t t = { .name = p };
+  while (*p && !ssml_space(*p))
+    ++p;
+  if (*p)
+    *p++ = 0;
+  const char *colon = strrchr(t.name, ':');
+  if (colon)
+    t.name = colon + 1;
+  // The attributes of a tag too long for the buffer are not all there
+  if (!end && !ssml->overflow)
+    ssml_parse_attrs(p, &t);
+
+  for (unsigned i = 0; i < sizeof(elements) / sizeof(elements[0]); ++i)
+  {
+    if (strcmp(t.name, elements[i].name) != 0)
+      continue;
+    // Only the elements that skip content are tracked while skipping
+    if (ssml->skip && elements[i].fn != ssml_skip)
+      return;
+    if (!end)
+      elements[i].fn(ssml, &t, true);
+    if (end || empty)
+      elements[i].fn(ssml, &t, false);
+    return;
+  }
+}
+
+
+void esp_pico_ssml_init(esp_pico_ssml_t *ssml, esp_pico_ssml_out_fn out, void *arg)
+{
+  memset(ssml, 0, sizeof(*ssml));
+  ssml->out = out;
+  ssml->arg = arg;
+  ssml->state = SSML_TEXT;
+  ssml->levels[0].speed = SSML_LEVEL_DEFAULT;
+  ssml->levels[0].pitch = SSML_LEVEL_DEFAULT;
+  ssml->levels[0].volume = SSML_LEVEL_DEFAULT;
+}
+
+
+void esp_pico_ssml_feed(esp_pico_ssml_t *ssml, const char *in, unsigned len)
+{
+  const char *end = in + len;
+  while (in < end)
+  {
+    char c = *in;
+    switch (ssml->state)
+    {
+      case SSML_TEXT:
+      {
+        const char *run = in;
+        while (in < end && *in != '<' && *in != '&')
+          ++in;
+        ssml_text(ssml, run, in - run);
+        if (in < end)
+        {
+          ssml->state = *in++ == '<' ? SSML_TAG : SSML_ENTITY;
+          ssml->len = 0;
+          ssml->quote = 0;
+          ssml->overflow = false;
+        }
+        break;
+      }
+      case SSML_ENTITY:
+        if (c == ';')
+        {
+          char utf8[4];
+          ssml->buf[ssml->len] = 0;
+          unsigned n = ssml_entity(ssml->buf, utf8);
+          if (n)
+            ssml_text(ssml, utf8, n);
+          else
+          {
+            ssml_text(ssml, "&", 1);
+            ssml_text(ssml, ssml->buf, ssml->len);
+            ssml_text(ssml, ";", 1);
+          }
+          ssml->state = SSML_TEXT;
+          ++in;
+        }
+        else if (ssml->len < SSML_ENTITY_MAX &&
+          (ssml_letter(c) || ssml_digit(c) || c == '#'))
+        {
+          ssml->buf[ssml->len++] = c;
+          ++in;
+        }
+        else
+        {
+          // Not an entity after all, the & is just text
+          ssml_text(ssml, "&", 1);
+          ssml_text(ssml, ssml->buf, ssml->len);
+          ssml->state = SSML_TEXT;
+        }
+        break;
+      case SSML_TAG:
+        // A < that cannot start a tag is just text
+        if (ssml->len == 0 && !ssml_letter(c) &&
+            c != '/' && c != '?' && c != '!' && c != '_' && c != ':')
+        {
+          ssml_text(ssml, "<", 1);
+          ssml->state = SSML_TEXT;
+          break;
+        }
+        ++in;
+        if (ssml->quote)
+        {
+          if (c == ssml->quote)
+            ssml->quote = 0;
+        }
+        else if (c == '"' || c == '\'')
+          ssml->quote = c;
+        else if (c == '>')
+        {
+          ssml_tag(ssml);
+          ssml->state = SSML_TEXT;
+          break;
+        }
+        // Once full, the last character keeps getting replaced, so that
+        // the / of an overlong empty tag is still seen
+        if (ssml->len < sizeof(ssml->buf) - 1)
+          ssml->buf[ssml->len++] = c;
+        else
+        {
+          ssml->overflow = true;
+          ssml->buf[ssml->len - 1] = c;
+        }
+        if (ssml->len == 3 && memcmp(ssml->buf, "!--", 3) == 0)
+        {
+          ssml->state = SSML_COMMENT;
+          ssml->dashes = 0;
+        }
+        break;
+      case SSML_COMMENT:
+        ++in;
+        if (c == '>' && ssml->dashes >= 2)
+          ssml->state = SSML_TEXT;
+        else if (c == '-')
+          ssml->dashes = ssml->dashes < 2 ? ssml->dashes + 1 : 2;
+        else
+          ssml->dashes = 0;
+        break;
+    }
+  }
+}
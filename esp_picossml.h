@@ -0,0 +1,77 @@
+#ifndef ESP_PICOSSML_H
+#define ESP_PICOSSML_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Streaming translation of an SSML subset into the engine's own markup.
+// Input may be split at any byte; nothing but the tag currently being read
+// is buffered, so memory use is fixed regardless of document size.
+//
+//   <speak>            dropped, </speak> flushes the engine with \0
+//   <prosody>          rate, pitch and volume become absolute speed, pitch
+//                      and volume levels, restored at </prosody>
+//   <break>            time or strength becomes <break time="Nms"/>
+//   <phoneme>          x-sampa (or no alphabet) passes through, other
+//                      alphabets are dropped and the content spoken instead
+//   <say-as>           characters, spell-out and verbatim become <spell>,
+//                      other types are dropped and the content spoken
+//   <audio>            the source becomes <play file="...">, the content
+//                      being spoken if there is no clip or file of that name
+//   <mark>, <s>, <p>   pass through
+//   <sub>              the alias is spoken instead of the content
+//
+// Other elements are dropped and their content spoken, except for <desc>
+// and <metadata> whose content is skipped. Comments, processing
+// instructions and declarations are skipped. Entities are decoded, and
+// line breaks become spaces so that blank lines do not end sentences.
+
+// Longest tag, including its attributes, that is translated. Longer tags
+// are still recognised, but their attributes are ignored.
+#define ESP_PICO_SSML_TAG_SIZE 256
+
+// Number of nested <prosody> elements whose levels are restored.
+#define ESP_PICO_SSML_DEPTH 8
+
+typedef void (*esp_pico_ssml_out_fn)(const char *txt, unsigned len, void *arg);
+
+typedef struct
+{
+  uint16_t speed;
+  uint16_t pitch;
+  uint16_t volume;
+} esp_pico_ssml_levels_t;
+
+typedef struct
+{
+  esp_pico_ssml_out_fn out;
+  void *arg;
+  uint8_t state;
+  char quote;
+  uint8_t dashes;
+  bool overflow;
+  bool ltPending;
+  uint16_t len;
+  char buf[ESP_PICO_SSML_TAG_SIZE];
+  // Open <prosody> elements, [0] holding the default levels
+  uint8_t prosodyDepth;
+  esp_pico_ssml_levels_t levels[ESP_PICO_SSML_DEPTH + 1];
+  // Open <say-as>, <phoneme> and <audio> elements, one bit each telling
+  // whether engine markup was written for it and needs closing
+  uint32_t sayAs;
+  uint32_t phoneme;
+  uint32_t audio;
+  uint8_t sayAsDepth;
+  uint8_t phonemeDepth;
+  uint8_t audioDepth;
+  // Depth of elements whose content is skipped
+  uint8_t skip;
+} esp_pico_ssml_t;
+
+// Prepares a translator writing its output through 'out'.
+void esp_pico_ssml_init(esp_pico_ssml_t *ssml, esp_pico_ssml_out_fn out, void *arg);
+
+// Translates the next 'len' bytes of the document.
+void esp_pico_ssml_feed(esp_pico_ssml_t *ssml, const char *in, unsigned len);
+
+#endif
@@ -7,27 +7,79 @@
 #include "picoapi.h"
 #include "picoapid.h"
 #include "esp_picorsrc.h"
+#include "esp_picossml.h"
 #include "esp_log.h"
 #include "esp_partition.h"
+#include "esp_timer.h"
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <math.h>
 
 // Yep, that's 1.1MB needed by PicoTTS, not counting the resource files which
 // we access directly from flash.
 #define PICO_MEM_SIZE 1100000
 
-#define PICOTASK_EXIT  0x0000001u
+#define PICOTASK_EXIT    0x0000001u
+#define PICOTASK_SWITCH  0x0000002u
+#define PICOTASK_LEXICON 0x0000004u
+#define PICOTASK_CLIP    0x0000008u
 
 #define IDLE_WAIT_COUNT 5
 
+#define MAX_LANGUAGES 6
+#define LANGUAGE_NAME_LEN 8
+#define MAX_USER_LEXICA 4
+#define MAX_CLIPS 16
+
+// A language whose resources have been loaded. The language name doubles
+// as the name of its voice definition.
+typedef struct {
+  char name[LANGUAGE_NAME_LEN];
+  pico_Resource ta;
+  pico_Resource sg;
+} esp_pico_lang_t;
+
+// A phoneme to viseme table set via picotts_set_visemes().
+typedef struct {
+  char lang[LANGUAGE_NAME_LEN];
+  const uint8_t *table;
+} esp_pico_visemes_t;
+
+// A user lexicon added via picotts_add_user_lexicon(). It is loaded and
+// added to the voice definition of its language along with the language.
+typedef struct {
+  char lang[LANGUAGE_NAME_LEN];
+  const void *raw;
+  pico_Resource rsrc;
+} esp_pico_ulex_t;
+
+// A clip added via picotts_add_clip(). It is added to the engine's system
+// again on reinitialisation.
+typedef struct {
+  char name[PICO_MAX_FILE_NAME_SIZE];
+  const int16_t *samples;
+  unsigned count;
+} esp_pico_clip_t;
+
 static picotts_output_fn outputCb;
 static picotts_error_notify_fn errorCb;
 static picotts_idle_notify_fn idleCb;
+static picotts_mark_notify_fn markCb;
+static picotts_phoneme_notify_fn phonemeCb;
+static picotts_word_notify_fn wordCb;
+
+// Samples passed to outputCb since picotts_init(), to place marks
+static uint64_t samplesOut;
+
+// Text bytes passed to the engine since picotts_init(), and their number
+// when the current engine was created, as the engine counts words from there
+static uint32_t bytesIn;
+static uint32_t engineBytesIn;
 
 static SemaphoreHandle_t exitLock;
 static QueueHandle_t textQ;
@@ -36,11 +88,28 @@ static TaskHandle_t picoTask;
 static void *picoMemArea;
 
 static pico_System   picoSystem;
-static pico_Resource picoTaResource;
-static pico_Resource picoSgResource;
 static pico_Engine   picoEngine;
 
-static const pico_Char voiceName[] = "PicoVoice";
+static const void *taBundle;
+static const void *sgBundle;
+
+static esp_pico_lang_t languages[MAX_LANGUAGES];
+static esp_pico_lang_t *curLang;
+
+static char initLang[LANGUAGE_NAME_LEN] = CONFIG_PICOTTS_DEFAULT_LANGUAGE;
+static esp_pico_ulex_t userLexica[MAX_USER_LEXICA];
+static esp_pico_visemes_t visemeTables[MAX_LANGUAGES];
+static esp_pico_clip_t clips[MAX_CLIPS];
+
+static char switchLang[LANGUAGE_NAME_LEN];
+static esp_pico_ulex_t *lexiconReq;
+static esp_pico_clip_t *clipReq;
+static bool requestOk;
+static SemaphoreHandle_t requestLock;
+static SemaphoreHandle_t requestDone;
+
+static esp_pico_ssml_t ssmlState;
+
 static const char tag[] = "picotts";
 
 
@@ -127,6 +196,221 @@ static void esp_pico_err_print(const char *what, int code)
 }
 
 
+// Passes the output of the SSML translation on to the engine.
+static void esp_pico_ssml_out(const char *txt, unsigned len, void *arg)
+{
+  (void)arg;
+  picotts_add(txt, len);
+}
+
+
+// Loads a user lexicon and adds it to the voice definition of its language.
+static bool esp_pico_load_user_lexicon(esp_pico_ulex_t *ulex)
+{
+  pico_Retstring str;
+  int ret = esp_pico_loadResource(picoSystem, ulex->raw, &ulex->rsrc);
+  if (ret == 0)
+    ret = pico_getResourceName(picoSystem, ulex->rsrc, str);
+  if (ret == 0)
+    ret = pico_addResourceToVoiceDefinition(
+      picoSystem, (const pico_Char *)ulex->lang, (const pico_Char *)str);
+  if (ret != 0)
+  {
+    esp_pico_err_print("User lexicon load failed", ret);
+    if (ulex->rsrc)
+      esp_pico_unloadResource(picoSystem, &ulex->rsrc);
+    ulex->rsrc = NULL;
+    return false;
+  }
+  return true;
+}
+
+
+// Adds a clip to the system, to be played by the engine.
+static bool esp_pico_add_clip(esp_pico_clip_t *clip)
+{
+  int ret = pico_addClip(picoSystem, (const pico_Char *)clip->name,
+    clip->samples, clip->count);
+  if (ret != 0)
+  {
+    esp_pico_err_print("Clip add failed", ret);
+    return false;
+  }
+  return true;
+}
+
+
+// Returns the language, loading its resources and creating its voice
+// definition if this has not already been done.
+static esp_pico_lang_t *esp_pico_get_language(const char *name)
+{
+  esp_pico_lang_t *lang = NULL;
+  for (unsigned i = 0; i < MAX_LANGUAGES; ++i)
+  {
+    if (strcmp(languages[i].name, name) == 0)
+      return &languages[i];
+    else if (!lang && !languages[i].name[0])
+      lang = &languages[i];
+  }
+  if (!lang)
+  {
+    ESP_LOGE(tag, "Too many languages");
+    return NULL;
+  }
+
+  const void *ta = esp_pico_findResource(taBundle, name);
+  const void *sg = esp_pico_findResource(sgBundle, name);
+  if (!ta || !sg)
+  {
+    ESP_LOGE(tag, "Language '%s' not available", name);
+    return NULL;
+  }
+  ESP_LOGI(tag, "Loading '%s' resources from %p and %p", name, ta, sg);
+
+  #define PICO_LANG_CHECK(msg) \
+    if (ret != 0) \
+    { \
+      esp_pico_err_print(msg, ret); \
+      goto fail; \
+    }
+
+  int ret = esp_pico_loadResource(picoSystem, ta, &lang->ta);
+  PICO_LANG_CHECK("Text analysis load failed");
+  ret = esp_pico_loadResource(picoSystem, sg, &lang->sg);
+  PICO_LANG_CHECK("Signal generator load failed");
+
+  const pico_Char *voiceName = (const pico_Char *)name;
+  ret = pico_createVoiceDefinition(picoSystem, voiceName);
+  PICO_LANG_CHECK("Voice creation failed");
+
+  pico_Retstring str;
+
+  ret = pico_getResourceName(picoSystem, lang->ta, str);
+  PICO_LANG_CHECK("TA resource name error");
+  ret = pico_addResourceToVoiceDefinition(
+    picoSystem, voiceName, (const pico_Char *)str);
+  PICO_LANG_CHECK("TA resource add failed");
+
+  ret = pico_getResourceName(picoSystem, lang->sg, str);
+  PICO_LANG_CHECK("SG resource name error");
+  ret = pico_addResourceToVoiceDefinition(
+    picoSystem, voiceName, (const pico_Char *)str);
+  PICO_LANG_CHECK("SG resource add failed");
+
+  #undef PICO_LANG_CHECK
+
+  // A user lexicon failing to load leaves the language usable without it
+  for (unsigned i = 0; i < MAX_USER_LEXICA; ++i)
+  {
+    if (strcmp(userLexica[i].lang, name) == 0)
+      esp_pico_load_user_lexicon(&userLexica[i]);
+  }
+
+  strcpy(lang->name, name);
+  return lang;
+
+fail:
+  pico_releaseVoiceDefinition(picoSystem, voiceName);
+  if (lang->sg)
+    esp_pico_unloadResource(picoSystem, &lang->sg);
+  if (lang->ta)
+    esp_pico_unloadResource(picoSystem, &lang->ta);
+  lang->sg = lang->ta = NULL;
+  return NULL;
+}
+
+
+// Creates the engine for the language, replacing any existing engine.
+static bool esp_pico_use_language(const char *name)
+{
+  int64_t t_start = esp_timer_get_time();
+
+  if (curLang && picoEngine && strcmp(curLang->name, name) == 0)
+    return true;
+
+  esp_pico_lang_t *lang = esp_pico_get_language(name);
+  if (!lang)
+    return false;
+
+  if (picoEngine)
+  {
+    pico_disposeEngine(picoSystem, &picoEngine);
+    picoEngine = NULL;
+    curLang = NULL;
+  }
+
+  int ret =
+    pico_newEngine(picoSystem, (const pico_Char *)lang->name, &picoEngine);
+  if (ret != 0)
+  {
+    esp_pico_err_print("Engine creation failed", ret);
+    return false;
+  }
+  curLang = lang;
+  engineBytesIn = bytesIn;
+
+  ESP_LOGI(tag, "Language '%s' ready after %lld us",
+    name, (long long)(esp_timer_get_time() - t_start));
+  uint32_t promoted, compiled, dense;
+  esp_pico_getResourceMemUsage(&promoted, &compiled, &dense);
+  ESP_LOGI(tag, "Resource RAM: %u promoted, %u compiled trees, %u dense FSTs",
+    (unsigned)promoted, (unsigned)compiled, (unsigned)dense);
+  return true;
+}
+
+
+// Loads a newly added user lexicon if its language is already loaded, and
+// recreates the engine if the language is in use.
+static bool esp_pico_apply_user_lexicon(esp_pico_ulex_t *ulex)
+{
+  esp_pico_lang_t *lang = NULL;
+  for (unsigned i = 0; i < MAX_LANGUAGES; ++i)
+  {
+    if (strcmp(languages[i].name, ulex->lang) == 0)
+      lang = &languages[i];
+  }
+  if (!lang)
+    return true;
+
+  if (!esp_pico_load_user_lexicon(ulex))
+    return false;
+
+  if (lang != curLang)
+    return true;
+  pico_disposeEngine(picoSystem, &picoEngine);
+  picoEngine = NULL;
+  curLang = NULL;
+  return esp_pico_use_language(lang->name);
+}
+
+
+// Reports a phone returned by the engine, as its id followed by its
+// duration in samples.
+static void esp_pico_report_phoneme(const uint8_t *data)
+{
+  uint32_t count =
+    data[1] | (data[2] << 8) | (data[3] << 16) | ((uint32_t)data[4] << 24);
+  uint8_t viseme = 0;
+  for (unsigned i = 0; curLang && i < MAX_LANGUAGES; ++i)
+  {
+    const uint8_t *table = visemeTables[i].table;
+    if (table && strcmp(visemeTables[i].lang, curLang->name) == 0)
+      viseme = table[data[0]];
+  }
+  phonemeCb(data[0], viseme, samplesOut, count);
+}
+
+
+// Reports a word returned by the engine, as its offset in the text passed
+// to the engine.
+static void esp_pico_report_word(const uint8_t *data)
+{
+  uint32_t offset =
+    data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+  wordCb(engineBytesIn + offset, samplesOut);
+}
+
+
 static void esp_pico_run(void *)
 {
   ESP_LOGI(tag, "Task started");
@@ -135,14 +419,26 @@ static void esp_pico_run(void *)
     WAITING_FOR_BYTES, WAITING_FOR_OUTPUT
   } state = WAITING_FOR_BYTES;
   unsigned idles = 0;
+  bool switchPending = false;
+  bool lexiconPending = false;
 
   while(!error)
   {
     uint32_t flags;
     if (xTaskNotifyWait(0, ~0, &flags, 0) == pdPASS)
     {
+      // Clips are only looked up by name, so one can be added right away
+      if (flags & PICOTASK_CLIP)
+      {
+        requestOk = esp_pico_add_clip(clipReq);
+        xSemaphoreGive(requestDone);
+      }
       if (flags & PICOTASK_EXIT)
         break;
+      if (flags & PICOTASK_SWITCH)
+        switchPending = true;
+      if (flags & PICOTASK_LEXICON)
+        lexiconPending = true;
     }
 
     uint8_t c;
@@ -161,6 +457,7 @@ static void esp_pico_run(void *)
         if (processed)
         {
           xQueueReceive(textQ, &c, 0);
+          ++bytesIn;
           if (state == WAITING_FOR_BYTES)
             state = WAITING_FOR_OUTPUT;
         }
@@ -170,6 +467,33 @@ static void esp_pico_run(void *)
     switch (state)
     {
       case WAITING_FOR_BYTES:
+        // Only switch language once all text queued before the switch
+        // request has been spoken
+        if (switchPending && uxQueueMessagesWaiting(textQ) == 0)
+        {
+          requestOk = esp_pico_use_language(switchLang);
+          switchPending = false;
+          xSemaphoreGive(requestDone);
+          if (!curLang)
+          {
+            ESP_LOGE(tag, "No language available, stopping TTS");
+            error = true;
+            break;
+          }
+        }
+        // Likewise for user lexica, which need the engine recreated
+        if (lexiconPending && uxQueueMessagesWaiting(textQ) == 0)
+        {
+          requestOk = esp_pico_apply_user_lexicon(lexiconReq);
+          lexiconPending = false;
+          xSemaphoreGive(requestDone);
+          if (!curLang)
+          {
+            ESP_LOGE(tag, "No language available, stopping TTS");
+            error = true;
+            break;
+          }
+        }
         if (idles < IDLE_WAIT_COUNT)
         {
           if (++idles == IDLE_WAIT_COUNT && idleCb)
@@ -183,12 +507,32 @@ static void esp_pico_run(void *)
         do {
           int16_t outbuf[128];
           int16_t bytes = 0, type = 0;
-          // Note: Only PICO_DATA_PCM_16BIT is defined as output type, so we
-          // don't propagate that information. Rather, it's a fixed property.
+          // Marks are returned as their name, leave room to terminate it
           status =
-            pico_getData(picoEngine, outbuf, sizeof(outbuf), &bytes, &type);
-          if (bytes > 0)
+            pico_getData(picoEngine, outbuf, sizeof(outbuf) - 1, &bytes, &type);
+          if (bytes <= 0)
+            continue;
+          if (type == PICO_DATA_MARK)
+          {
+            ((char *)outbuf)[bytes] = '\0';
+            if (markCb)
+              markCb((const char *)outbuf, samplesOut);
+          }
+          else if (type == PICO_DATA_PHONE)
+          {
+            if (phonemeCb && bytes == 5)
+              esp_pico_report_phoneme((const uint8_t *)outbuf);
+          }
+          else if (type == PICO_DATA_WORD)
+          {
+            if (wordCb && bytes == 4)
+              esp_pico_report_word((const uint8_t *)outbuf);
+          }
+          else
+          {
             outputCb(outbuf, bytes/2);
+            samplesOut += bytes/2;
+          }
         } while (status == PICO_STEP_BUSY);
         if (status != PICO_STEP_IDLE)
         {
@@ -205,6 +549,11 @@ static void esp_pico_run(void *)
     }
   }
   ESP_LOGI(tag, "Exiting task");
+  if (switchPending || lexiconPending)
+  {
+    requestOk = false;
+    xSemaphoreGive(requestDone);
+  }
   xSemaphoreGive(exitLock);
   vTaskDelete(NULL);
 
@@ -225,20 +574,27 @@ static void esp_pico_cleanup(void)
   if (picoEngine)
   {
     pico_disposeEngine(picoSystem, &picoEngine);
-    pico_releaseVoiceDefinition(picoSystem, voiceName);
     picoEngine = NULL;
   }
+  curLang = NULL;
 
-  if (picoSgResource)
+  for (unsigned i = 0; i < MAX_LANGUAGES; ++i)
   {
-    esp_pico_unloadResource(picoSystem, &picoSgResource);
-    picoSgResource = NULL;
+    esp_pico_lang_t *lang = &languages[i];
+    if (!lang->name[0])
+      continue;
+    pico_releaseVoiceDefinition(picoSystem, (const pico_Char *)lang->name);
+    esp_pico_unloadResource(picoSystem, &lang->sg);
+    esp_pico_unloadResource(picoSystem, &lang->ta);
+    memset(lang, 0, sizeof(*lang));
   }
 
-  if (picoTaResource)
+  // User lexica stay added, to be loaded again after reinitialisation
+  for (unsigned i = 0; i < MAX_USER_LEXICA; ++i)
   {
-    esp_pico_unloadResource(picoSystem, &picoTaResource);
-    picoTaResource = NULL;
+    if (userLexica[i].rsrc)
+      esp_pico_unloadResource(picoSystem, &userLexica[i].rsrc);
+    userLexica[i].rsrc = NULL;
   }
 
   if (picoSystem)
@@ -260,8 +616,14 @@ static void esp_pico_cleanup(void)
 
 bool picotts_init(unsigned prio, picotts_output_fn cb, int core)
 {
+  int64_t t_start = esp_timer_get_time();
+
   if (!exitLock)
     exitLock = xSemaphoreCreateBinary();
+  if (!requestLock)
+    requestLock = xSemaphoreCreateMutex();
+  if (!requestDone)
+    requestDone = xSemaphoreCreateBinary();
 
   outputCb = cb;
 
@@ -288,51 +650,39 @@ bool picotts_init(unsigned prio, picotts_output_fn cb, int core)
   int ret = pico_initialize(picoMemArea, PICO_MEM_SIZE, &picoSystem);
   PICO_INIT_CHECK("init failed");
 
-  const void *ta = find_ta_bin_start();
-  if (!ta)
+  // A clip failing to be added leaves the others usable
+  for (unsigned i = 0; i < MAX_CLIPS; ++i)
+  {
+    if (clips[i].samples)
+      esp_pico_add_clip(&clips[i]);
+  }
+
+  taBundle = find_ta_bin_start();
+  if (!taBundle)
   {
     ESP_LOGE(tag, "Unable to find text analysis resource");
+    esp_pico_cleanup();
     return false;
   }
-  else
-    ESP_LOGI(tag, "Loading text analysis resource from %p", ta);
 
-  ret = esp_pico_loadResource(picoSystem, ta, &picoTaResource);
-  PICO_INIT_CHECK("Text analysis load failed");
-
-  const void *sg = find_sg_bin_start();
-  if (!sg)
+  sgBundle = find_sg_bin_start();
+  if (!sgBundle)
   {
     ESP_LOGE(tag, "Unable to find signal generator resource");
+    esp_pico_cleanup();
     return false;
   }
-  else
-    ESP_LOGI(tag, "Loading signal generator resource from %p", sg);
 
-  ret = esp_pico_loadResource(picoSystem, sg, &picoSgResource);
-  PICO_INIT_CHECK("Signal generator load failed");
-
-  ret = pico_createVoiceDefinition(picoSystem, voiceName);
-  PICO_INIT_CHECK("Voice creation failed");
-
-  pico_Retstring str;
-
-  ret = pico_getResourceName(picoSystem, picoTaResource, str);
-  PICO_INIT_CHECK("TA resource name error");
-  ret = pico_addResourceToVoiceDefinition(
-    picoSystem, voiceName, (const pico_Char *)str);
-  PICO_INIT_CHECK("TA resource add failed");
-
-  ret = pico_getResourceName(picoSystem, picoSgResource, str);
-  PICO_INIT_CHECK("SG resource name error");
-  ret = pico_addResourceToVoiceDefinition(
-    picoSystem, voiceName, (const pico_Char *)str);
-  PICO_INIT_CHECK("SG resource add failed");
+  #undef PICO_INIT_CHECK
 
-  ret = pico_newEngine(picoSystem, voiceName, &picoEngine);
-  PICO_INIT_CHECK("Engine creation failed");
+  if (!esp_pico_use_language(initLang))
+  {
+    esp_pico_cleanup();
+    return false;
+  }
 
-  #undef PICO_INIT_CHECK
+  ESP_LOGI(tag, "Engine ready after %lld us",
+    (long long)(esp_timer_get_time() - t_start));
 
   textQ = xQueueCreate(CONFIG_PICOTTS_INPUT_QUEUE_SIZE, sizeof(char));
   if (!textQ)
@@ -342,6 +692,8 @@ bool picotts_init(unsigned prio, picotts_output_fn cb, int core)
     return false;
   }
 
+  esp_pico_ssml_init(&ssmlState, esp_pico_ssml_out, NULL);
+
   if (xTaskCreatePinnedToCore(esp_pico_run, "picotts", 8192, NULL,
         prio, &picoTask, core == -1 ? tskNO_AFFINITY : core)
       != pdPASS)
@@ -362,9 +714,139 @@ void picotts_add(const char *text, unsigned len)
 }
 
 
+void picotts_add_ssml(const char *ssml, unsigned len)
+{
+  esp_pico_ssml_feed(&ssmlState, ssml, len);
+}
+
+
+bool picotts_set_language(const char *lang)
+{
+  if (strlen(lang) >= LANGUAGE_NAME_LEN)
+    return false;
+
+  if (!picoTask)
+  {
+    strcpy(initLang, lang);
+    return true;
+  }
+
+  xSemaphoreTake(requestLock, portMAX_DELAY);
+  strcpy(switchLang, lang);
+  xTaskNotify(picoTask, PICOTASK_SWITCH, eSetBits);
+  xSemaphoreTake(requestDone, portMAX_DELAY);
+  bool ok = requestOk;
+  xSemaphoreGive(requestLock);
+  return ok;
+}
+
+
+bool picotts_add_user_lexicon(const char *lang, const void *lexicon)
+{
+  if (strlen(lang) >= LANGUAGE_NAME_LEN ||
+      esp_pico_findResource(lexicon, lang) != lexicon)
+  {
+    ESP_LOGE(tag, "Not a user lexicon for '%s'", lang);
+    return false;
+  }
+
+  // The task only looks at the user lexica while handling a request
+  bool running = picoTask != NULL;
+  if (running)
+    xSemaphoreTake(requestLock, portMAX_DELAY);
+
+  esp_pico_ulex_t *ulex = NULL;
+  bool ok = true;
+  for (unsigned i = 0; i < MAX_USER_LEXICA; ++i)
+  {
+    if (userLexica[i].raw == lexicon)
+      goto out;
+    else if (!ulex && !userLexica[i].raw)
+      ulex = &userLexica[i];
+  }
+  if (!ulex)
+  {
+    ESP_LOGE(tag, "Too many user lexica");
+    ok = false;
+    goto out;
+  }
+  strcpy(ulex->lang, lang);
+  ulex->raw = lexicon;
+
+  if (running)
+  {
+    lexiconReq = ulex;
+    xTaskNotify(picoTask, PICOTASK_LEXICON, eSetBits);
+    xSemaphoreTake(requestDone, portMAX_DELAY);
+    ok = requestOk;
+    if (!ok)
+      memset(ulex, 0, sizeof(*ulex));
+  }
+
+out:
+  if (running)
+    xSemaphoreGive(requestLock);
+  return ok;
+}
+
+
+bool picotts_add_clip(const char *name, const int16_t *samples, unsigned count)
+{
+  if (!name[0] || strlen(name) >= PICO_MAX_FILE_NAME_SIZE || !samples)
+    return false;
+
+  // The task only looks at the clips while handling a request
+  bool running = picoTask != NULL;
+  if (running)
+    xSemaphoreTake(requestLock, portMAX_DELAY);
+
+  esp_pico_clip_t *clip = NULL;
+  bool ok = true;
+  for (unsigned i = 0; i < MAX_CLIPS; ++i)
+  {
+    if (clips[i].samples && strcmp(clips[i].name, name) == 0)
+    {
+      ESP_LOGE(tag, "Clip '%s' already added", name);
+      ok = false;
+      goto out;
+    }
+    else if (!clip && !clips[i].samples)
+      clip = &clips[i];
+  }
+  if (!clip)
+  {
+    ESP_LOGE(tag, "Too many clips");
+    ok = false;
+    goto out;
+  }
+  strcpy(clip->name, name);
+  clip->samples = samples;
+  clip->count = count;
+
+  if (running)
+  {
+    clipReq = clip;
+    xTaskNotify(picoTask, PICOTASK_CLIP, eSetBits);
+    xSemaphoreTake(requestDone, portMAX_DELAY);
+    ok = requestOk;
+    if (!ok)
+      memset(clip, 0, sizeof(*clip));
+  }
+
+out:
+  if (running)
+    xSemaphoreGive(requestLock);
+  return ok;
+}
+
+
 void picotts_shutdown(void)
 {
   esp_pico_cleanup();
+  memset(userLexica, 0, sizeof(userLexica));
+  memset(clips, 0, sizeof(clips));
+  samplesOut = 0;
+  bytesIn = engineBytesIn = 0;
 
 #if CONFIG_PICOTTS_RESOURCE_MODE_PARTITION
   unmap_partitions();
@@ -382,3 +864,51 @@ void picotts_set_idle_notify(picotts_idle_notify_fn cb)
 {
   idleCb = cb;
 }
+
+
+void picotts_set_mark_notify(picotts_mark_notify_fn cb)
+{
+  markCb = cb;
+}
+
+
+void picotts_set_phoneme_notify(picotts_phoneme_notify_fn cb)
+{
+  phonemeCb = cb;
+}
+
+
+void picotts_set_word_notify(picotts_word_notify_fn cb)
+{
+  wordCb = cb;
+}
+
+
+bool picotts_set_visemes(const char *lang, const uint8_t *table)
+{
+  if (strlen(lang) >= LANGUAGE_NAME_LEN)
+    return false;
+
+  esp_pico_visemes_t *entry = NULL;
+  for (unsigned i = 0; i < MAX_LANGUAGES; ++i)
+  {
+    if (strcmp(visemeTables[i].lang, lang) == 0)
+    {
+      entry = &visemeTables[i];
+      break;
+    }
+    else if (!entry && !visemeTables[i].lang[0])
+      entry = &visemeTables[i];
+  }
+  if (!entry)
+  {
+    ESP_LOGE(tag, "Too many viseme tables");
+    return false;
+  }
+
+  // Clear the table first, so a table is never used for another language
+  entry->table = NULL;
+  strcpy(entry->lang, lang);
+  entry->table = table;
+  return true;
+}
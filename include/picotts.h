@@ -41,6 +41,90 @@ bool picotts_init(unsigned prio, picotts_output_fn output_cb, int core);
  */
 void picotts_add(const char *txt, unsigned len);
 
+/**
+ * Adds SSML to be synthesised. The SSML is translated into the engine's
+ * own markup as it is added, so a document may be passed in pieces split
+ * at any byte, and is never held in memory as a whole. The end of the
+ * @c speak element acts like \0, starting the speech generation.
+ *
+ * Supported are @c speak, @c prosody (rate, pitch and volume), @c break,
+ * @c phoneme (X-SAMPA), @c say-as (characters, spell-out and verbatim),
+ * @c mark, @c sub, @c audio (clips added with @c picotts_add_clip()), @c s
+ * and @c p. Other elements are ignored, and their content spoken as plain
+ * text.
+ *
+ * As with @c picotts_add(), this blocks while the queue is full. The
+ * translation state is shared, so text added with @c picotts_add() while
+ * a document is only partly added becomes part of that document.
+ *
+ * @param ssml The pointer to the next part of the SSML document, in UTF8
+ *   format. It is copied, so the pointer may be invalidated immediately
+ *   upon return from this call.
+ * @param len The number of bytes available in @c ssml.
+ */
+void picotts_add_ssml(const char *ssml, unsigned len);
+
+/**
+ * Selects the language to speak in. The language must have been bundled
+ * via Kconfig. Its resources are loaded on first use, and stay loaded until
+ * @c picotts_shutdown(), so switching back to a language used before is
+ * cheap.
+ *
+ * If called before @c picotts_init(), this sets the language to use from
+ * initialisation, overriding the Kconfig default. Otherwise the switch takes
+ * place once all text added so far has been spoken, and this function
+ * blocks until then. Text not ended by a sentence stop or \0 is discarded.
+ *
+ * @param lang The language tag, e.g. "en-GB", "de-DE".
+ * @returns True on success. If the language is not available, the previous
+ *   language remains in use.
+ */
+bool picotts_set_language(const char *lang);
+
+/**
+ * Adds a user lexicon to a language. Words in a user lexicon are looked up
+ * before the language's own lexicon, and are spoken with the pronunciation
+ * given there instead of a looked up or predicted one. User lexica are
+ * built from a word list by @c tools/picorsrc.py @c ulex.
+ *
+ * If the language is in use, the lexicon takes effect once all text added
+ * so far has been spoken, and this function blocks until then. Otherwise
+ * it is loaded along with the language. Up to two user lexica, built for
+ * different slots, may be added to each language.
+ *
+ * @param lang The language tag the lexicon was built for, e.g. "en-GB".
+ * @param lexicon The lexicon, 4 byte aligned. It is used in place, so it
+ *   must remain valid until @c picotts_shutdown().
+ * @returns True on success, false if the lexicon is not valid for the
+ *   language or could not be loaded.
+ */
+bool picotts_add_user_lexicon(const char *lang, const void *lexicon);
+
+/**
+ * Adds a clip, such as an earcon or chime, to be played by name where the
+ * text contains @c <play file="name"/>, or @c audio with that source in
+ * SSML. The clip is played in sequence with the speech around it, at its
+ * volume, and replaces the content of the element, which is spoken instead
+ * if there is no clip (or file) of that name.
+ *
+ * The clip is played straight from its samples, so it may be held in
+ * flash, e.g. embedded in the application or in a memory-mapped partition.
+ * Text added after this function returns may play the clip. If the engine
+ * is running, this blocks until it has synthesised the text passed to it
+ * so far, but not the text still queued. Clips stay added until
+ * @c picotts_shutdown().
+ *
+ * @param name The name to play the clip by, up to 63 bytes.
+ * @param samples The samples, 16 bit mono at @c PICOTTS_SAMPLE_FREQ_HZ,
+ *   2 byte aligned. They are used in place, so they must remain valid
+ *   until @c picotts_shutdown(). At the default volume, the clip is
+ *   played at half its level, like the speech.
+ * @param count The number of samples.
+ * @returns True on success, false if a clip of that name was already
+ *   added or there is no room for another clip.
+ */
+bool picotts_add_clip(const char *name, const int16_t *samples, unsigned count);
+
 /**
  * Stops the TTS engine task and frees the used memory resources.
  * Call @c picotts_init() again to reinitialise, if needed.
@@ -72,6 +156,69 @@ typedef void (*picotts_idle_notify_fn)(void);
  */
 void picotts_set_idle_notify(picotts_idle_notify_fn cb);
 
+
+typedef void (*picotts_mark_notify_fn)(const char *name, uint64_t sample);
+
+/**
+ * Sets a callback function which gets called when speech reaches a mark,
+ * as set by @c <mark name="..."/> in the text, or @c mark in SSML.
+ * @param cb The callback handler. Invoked from the TTS task, in order with
+ *   the output callback: all samples before the mark have been passed to
+ *   the output callback, and the ones after it have not. The @c sample
+ *   argument is the index of the first sample after the mark, counting the
+ *   samples passed to the output callback since @c picotts_init(). Marks
+ *   at the end of a sentence may be reported up to 20ms early. Pass NULL
+ *   to unregister a set callback function.
+ */
+void picotts_set_mark_notify(picotts_mark_notify_fn cb);
+
+
+typedef void (*picotts_phoneme_notify_fn)(
+  uint8_t phoneme, uint8_t viseme, uint64_t sample, uint32_t count);
+
+/**
+ * Sets a callback function which gets called as each phoneme starts to be
+ * spoken, e.g. to drive lip sync. Requires the phoneme timing option in
+ * Kconfig; without it the callback is never invoked.
+ * @param cb The callback handler. Invoked from the TTS task, in order with
+ *   the output callback, like the mark callback. The @c phoneme argument is
+ *   the language's phoneme id, and @c viseme its entry in the language's
+ *   viseme table (0 without one). The phoneme starts at sample @c sample,
+ *   counted as for marks, and lasts @c count samples; pauses are reported
+ *   as phonemes too. Pass NULL to unregister a set callback function.
+ */
+void picotts_set_phoneme_notify(picotts_phoneme_notify_fn cb);
+
+/**
+ * Sets the viseme table of a language, which maps phoneme ids to the
+ * visemes reported to the phoneme callback. Tables are built from a
+ * phoneme to viseme list by @c tools/picorsrc.py @c visemes.
+ * @param lang The language tag, e.g. "en-GB".
+ * @param table The 256 entry table, indexed by phoneme id. It is used in
+ *   place, so it must remain valid while set. Pass NULL to remove the
+ *   language's table.
+ * @returns True on success, false if there are too many tables.
+ */
+bool picotts_set_visemes(const char *lang, const uint8_t *table);
+
+
+typedef void (*picotts_word_notify_fn)(uint32_t offset, uint64_t sample);
+
+/**
+ * Sets a callback function which gets called as each word starts to be
+ * spoken, e.g. to highlight live captions. Requires the word timing option
+ * in Kconfig; without it the callback is never invoked.
+ * @param cb The callback handler. Invoked from the TTS task, in order with
+ *   the output callback, like the mark callback. The @c offset argument is
+ *   the byte offset of the word's first character, counting the bytes added
+ *   with @c picotts_add() since @c picotts_init(); for SSML these are the
+ *   bytes of the translated document. The word starts at sample @c sample,
+ *   counted as for marks. Text read as a whole, such as a date or a number
+ *   written with separators, is reported once, as a single word. Pass NULL
+ *   to unregister a set callback function.
+ */
+void picotts_set_word_notify(picotts_word_notify_fn cb);
+
 #ifdef __cplusplus
 }
 #endif
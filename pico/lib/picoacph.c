@@ -138,9 +138,10 @@ typedef struct acph_subobj {
 
     picoos_uint8 tmpbuf[PICODATA_MAX_ITEMSIZE];  /* tmp. location for an item */
 
-    picoacph_headx_t headx[PICOACPH_MAXNR_HEADX];
+    picoacph_headx_t headx[PICOACPH_MAXNR_HEADX + PICODATA_MAXNR_WORDCMDS];
     picoos_uint16 headxBottom; /* bottom */
     picoos_uint16 headxLen;    /* length, 0 if empty */
+    picoos_uint16 headxWords;  /* word commands collected, set aside during processing */
 
     picoos_uint8 cbuf[PICOACPH_MAXSIZE_CBUF];
     picoos_uint16 cbufBufSize; /* actually allocated size */
@@ -176,11 +177,12 @@ static pico_status_t acphInitialize(register picodata_ProcessingUnit this, picoo
 
     acph->headxBottom = 0;
     acph->headxLen = 0;
+    acph->headxWords = 0;
     acph->cbufBufSize = PICOACPH_MAXSIZE_CBUF;
     acph->cbufLen = 0;
 
     /* init headx, cbuf */
-    for (i = 0; i < PICOACPH_MAXNR_HEADX; i++){
+    for (i = 0; i < (PICOACPH_MAXNR_HEADX + PICODATA_MAXNR_WORDCMDS); i++){
         acph->headx[i].head.type = 0;
         acph->headx[i].head.info1 = 0;
         acph->headx[i].head.info2 = 0;
@@ -1009,6 +1011,77 @@ static picoos_uint8 acphPutBoundItem(register picodata_ProcessingUnit this,
 
 
 
+/* ***********************************************************************/
+/* word command functions */
+/* ***********************************************************************/
+
+/* Word commands mark where a word starts in the input text and must not
+   influence phrasing and accentuation. Before processing they are moved
+   behind the phrase, remembering in 'boundstrength' the index of the item
+   they preceded, and afterwards they are put back in place. A word
+   command put back takes over the boundary of the item following it so
+   that a BOUND item is output before the command, not between command
+   and word. */
+
+static picoos_uint8 acphIsWordCmd(const picoacph_headx_t *headx) {
+    return ((headx->head.type == PICODATA_ITEM_CMD) &&
+            (headx->head.info1 == PICODATA_ITEMINFO1_CMD_WORD));
+}
+
+
+static void acphHideWordCmds(register acph_subobj_t *acph) {
+    picoacph_headx_t tmp;
+    picoos_uint16 len;
+    picoos_uint16 nr;
+    picoos_uint16 i;
+
+    len = acph->headxLen;
+    nr = 0;
+    i = 0;
+    while (i < (len - nr)) {
+        if (acphIsWordCmd(&(acph->headx[i]))) {
+            tmp = acph->headx[i];
+            tmp.boundstrength = (picoos_uint8)i;
+            picoos_mem_copy(&(acph->headx[i + 1]), &(acph->headx[i]),
+                            (len - i - 1) * sizeof(picoacph_headx_t));
+            acph->headx[len - 1] = tmp;
+            nr++;
+        } else {
+            i++;
+        }
+    }
+    acph->headxWords = nr;
+    acph->headxLen = len - nr;
+}
+
+
+static void acphRestoreWordCmds(register acph_subobj_t *acph) {
+    picoacph_headx_t tmp;
+    picoos_uint16 last;
+    picoos_uint16 pos;
+
+    /* the command set aside last is always at the end and goes back first */
+    last = acph->headxLen + acph->headxWords - 1;
+    while (acph->headxWords > 0) {
+        tmp = acph->headx[last];
+        pos = tmp.boundstrength;
+        picoos_mem_copy(&(acph->headx[pos]), &(acph->headx[pos + 1]),
+                        (last - pos) * sizeof(picoacph_headx_t));
+        tmp.boundstrength = 0;
+        tmp.boundtype = 0;
+        if (pos < last) {
+            tmp.boundstrength = acph->headx[pos + 1].boundstrength;
+            tmp.boundtype = acph->headx[pos + 1].boundtype;
+            acph->headx[pos + 1].boundstrength = 0;
+            acph->headx[pos + 1].boundtype = 0;
+        }
+        acph->headx[pos] = tmp;
+        acph->headxWords--;
+        acph->headxLen++;
+    }
+}
+
+
 /* ***********************************************************************/
 /*                          acphStep function                              */
 /* ***********************************************************************/
@@ -1108,8 +1181,16 @@ static picodata_step_result_t acphStep(register picodata_ProcessingUnit this,
                         acph->needsmoreitems = FALSE;
                     }
 
+                    /* word commands do not count against the item limit */
+                    if (acphIsWordCmd(&(acph->headx[acph->headxLen]))) {
+                        acph->headxWords++;
+                    }
+
                     /* check/set inspaceok, keep spare slot for forcing */
-                    if ((acph->headxLen >= (PICOACPH_MAXNR_HEADX - 2))
+                    if (((acph->headxLen - acph->headxWords)
+                            >= (PICOACPH_MAXNR_HEADX - 2))
+                            || (acph->headxLen >= (PICOACPH_MAXNR_HEADX
+                                    + PICODATA_MAXNR_WORDCMDS - 2))
                             || ((acph->cbufBufSize - acph->cbufLen)
                                     < PICODATA_MAX_ITEMSIZE)) {
                         acph->inspaceok = FALSE;
@@ -1177,6 +1258,7 @@ static picodata_step_result_t acphStep(register picodata_ProcessingUnit this,
                     /* we have a phrase in headx, cbuf1 (can be
                        single PUNC item), do phrasing and modify headx */
 
+                    acphHideWordCmds(acph);
                     if (PICO_OK != acphSubPhrasing(this, acph)) {
                         picoos_emRaiseException(this->common->em,
                                                 PICO_ERR_OTHER, NULL, NULL);
@@ -1252,6 +1334,7 @@ static picodata_step_result_t acphStep(register picodata_ProcessingUnit this,
                                                 PICO_ERR_OTHER, NULL, NULL);
                         return PICODATA_PU_ERROR;
                     }
+                    acphRestoreWordCmds(acph);
                     acph->procState = SA_STEPSTATE_FEED;
                 } else if (acph->headxLen == 0) {    /* no items in inBuf */
                     PICODBG_WARN(("no items in inBuf"));
@@ -1402,7 +1485,7 @@ static picodata_step_result_t acphStep(register picodata_ProcessingUnit this,
                 acph->headxBottom = 0;
                 acph->headxLen = 0;
                 acph->cbufLen = 0;
-                for (i = 0; i < PICOACPH_MAXNR_HEADX; i++) {
+                for (i = 0; i < (PICOACPH_MAXNR_HEADX + PICODATA_MAXNR_WORDCMDS); i++) {
                     acph->headx[i].boundstrength = 0;
                 }
 
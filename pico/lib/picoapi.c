@@ -107,6 +107,8 @@ pico_Status pico_initialize_priv(
                     sys->common->em = sysEM;
                     sys->common->mm = sysMM;
                     sys->engine = NULL;
+                    sys->clips = NULL;
+                    sys->common->clipList = &(sys->clips);
 
                     picorsrc_createDefaultResource(sys->rm /*,&defaultResource */);
 
@@ -493,6 +495,64 @@ PICO_FUNC pico_releaseVoiceDefinition(
 
 
 
+/* *** Clips ******************************************************************/
+
+/**
+ * pico_addClip : Adds a clip played instead of a file of the same name
+ * @param    system : pointer to a pico_System struct
+ * @param    *clipName : name of the clip
+ * @param    *samples : the samples, 16 bit linear at 16kHz
+ * @param    nrSamples : number of samples
+ * @return  PICO_OK : successful
+ * @return     PICO_ERR_INVALID_HANDLE, PICO_ERR_NULLPTR_ACCESS : errors
+ * @return     PICO_ERR_INVALID_ARGUMENT, PICO_EXC_NAME_CONFLICT : errors
+ * @return     PICO_EXC_OUT_OF_MEM : error
+ * @callgraph
+ * @callergraph
+*/
+PICO_FUNC pico_addClip(
+        pico_System system,
+        const pico_Char *clipName,
+        const pico_Int16 *samples,
+        const pico_Uint32 nrSamples
+        )
+{
+    pico_Status status = PICO_OK;
+    picoos_Clip clip;
+
+    if (!is_valid_system_handle(system)) {
+        status = PICO_ERR_INVALID_HANDLE;
+    } else if ((clipName == NULL) || (samples == NULL)) {
+        status = PICO_ERR_NULLPTR_ACCESS;
+    } else if ((picoos_strlen((picoos_char *) clipName) == 0) ||
+            (picoos_strlen((picoos_char *) clipName) >= PICO_MAX_FILE_NAME_SIZE)) {
+        status = PICO_ERR_INVALID_ARGUMENT;
+    } else {
+        picoos_emReset(system->common->em);
+        if (picoos_findClip(system->common, (picoos_char *) clipName) != NULL) {
+            status = picoos_emRaiseException(system->common->em, PICO_EXC_NAME_CONFLICT,
+                        NULL, (picoos_char *) "clip '%s' already added", clipName);
+        } else {
+            clip = (picoos_Clip) picoos_allocate(system->common->mm, sizeof(*clip));
+            if (clip == NULL) {
+                status = picoos_emRaiseException(system->common->em, PICO_EXC_OUT_OF_MEM,
+                            (picoos_char *) "out of memory adding clip", NULL);
+            } else {
+                picoos_strlcpy(clip->name, (picoos_char *) clipName, PICO_MAX_FILE_NAME_SIZE);
+                clip->samples = samples;
+                clip->nrSamples = nrSamples;
+                /* an engine running may look clips up: link the clip last */
+                clip->next = system->clips;
+                system->clips = clip;
+            }
+        }
+    }
+
+    return status;
+}
+
+
+
 /* *** Engine creation and deletion functions *********************************/
 
 /**
@@ -529,6 +589,7 @@ PICO_FUNC pico_newEngine(
             *outEngine = (pico_Engine) picoctrl_newEngine(system->common->mm, system->rm, voiceName);
             if (*outEngine != NULL) {
                 system->engine = (picoctrl_Engine) *outEngine;
+                picoctrl_engGetCommon(system->engine)->clipList = system->common->clipList;
             } else {
                 status = picoos_emRaiseException(system->common->em, PICO_EXC_OUT_OF_MEM,
                             (picoos_char *) "out of memory creating new engine", NULL);
@@ -636,7 +697,9 @@ PICO_FUNC pico_getData(
         )
 {
     pico_Status status = PICO_OK;
+    picoos_uint8 cmd;
 
+    *outDataType = PICO_DATA_PCM_16BIT;
     if (!picoctrl_isValidEngineHandle((picoctrl_Engine) engine)) {
         status = PICO_STEP_ERROR;
     } else if (buffer == NULL) {
@@ -647,13 +710,18 @@ PICO_FUNC pico_getData(
         status = PICO_STEP_ERROR;
     } else {
         picoctrl_engResetExceptionManager((picoctrl_Engine) engine);
-        status = picoctrl_engFetchOutputItemBytes((picoctrl_Engine) engine, (picoos_char *)buffer, bufferSize, bytesReceived);
+        status = picoctrl_engFetchOutputItemBytes((picoctrl_Engine) engine, (picoos_char *)buffer, bufferSize, bytesReceived, &cmd);
         if ((status != PICO_STEP_IDLE) && (status != PICO_STEP_BUSY)) {
             status = PICO_STEP_ERROR;
+        } else if (cmd == PICODATA_ITEMINFO1_CMD_MARKER) {
+            *outDataType = PICO_DATA_MARK;
+        } else if (cmd == PICODATA_ITEMINFO1_CMD_PHONE) {
+            *outDataType = PICO_DATA_PHONE;
+        } else if (cmd == PICODATA_ITEMINFO1_CMD_WORD) {
+            *outDataType = PICO_DATA_WORD;
         }
     }
 
-    *outDataType = PICO_DATA_PCM_16BIT;
     return status;
 }
 
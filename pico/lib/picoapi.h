@@ -341,6 +341,23 @@ PICO_FUNC pico_releaseVoiceDefinition(
         );
 
 
+/* Clips **************************************************************/
+
+/**
+   Adds a clip named 'clipName' of 'nrSamples' samples at 'samples',
+   16 bit linear at 16kHz, to be played by the 'play' text-input command
+   instead of a file of that name. The samples are read in place, e.g.
+   from flash, and must remain valid until the system is terminated. It
+   is an error to add a clip with a previously added name.
+*/
+PICO_FUNC pico_addClip(
+        pico_System system,
+        const pico_Char *clipName,
+        const pico_Int16 *samples,
+        const pico_Uint32 nrSamples
+        );
+
+
 /* Engine creation and deletion functions *****************************/
 
 /**
@@ -402,7 +419,11 @@ PICO_FUNC pico_putTextUtf8(
    'outBuffer'. The type of data returned in 'outBuffer' (e.g. 8 or 16
    bit PCM samples) is returned in 'outDataType' and depends on the
    lingware resources. Possible 'outDataType' values are listed in
-   picodefs.h (PICO_DATA_*).
+   picodefs.h (PICO_DATA_*). When the speech reaches a mark, its name is
+   returned instead, with 'outDataType' PICO_DATA_MARK; at the start of
+   each phone, if enabled, its id and duration are returned with
+   'outDataType' PICO_DATA_PHONE, and at the start of each word, if
+   enabled, its text offset with 'outDataType' PICO_DATA_WORD.
    This function returns PICO_STEP_BUSY while processing input and
    producing speech output. Once all data is returned and there is no
    more input text available in the Pico text input buffer,
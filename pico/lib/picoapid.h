@@ -52,6 +52,7 @@ typedef struct pico_system {
     picoos_Common common;
     picorsrc_ResourceManager rm;
     picoctrl_Engine engine;
+    picoos_Clip clips;          /* clips added, most recent first */
 } pico_system_t;
 
 
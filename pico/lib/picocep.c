@@ -76,6 +76,12 @@ extern "C" {
 
 #define PICOCEP_OUT_DATA_FORMAT PICODATA_ITEMINFO1_FRAME_PAR_DATA_FORMAT_FIXED /* we output coefficients as fixed point values */
 
+/* if non-zero, a phone command announcing each phone and its duration is
+ * output ahead of the phone's first frame */
+#ifndef PICOCEP_PHONE_EVENTS
+#define PICOCEP_PHONE_EVENTS 0
+#endif
+
 #define PICOCEP_STEPSTATE_COLLECT         0
 #define PICOCEP_STEPSTATE_PROCESS_PARSE   1
 #define PICOCEP_STEPSTATE_PROCESS_SMOOTH  2
@@ -171,7 +177,7 @@ typedef struct cep_subobj
     picoos_uint16 inReadPos, inWritePos; /* next pos to read/write from/to inBuf*/
     picoos_uint16 nextInPos;
 
-    picoacph_headx_t headx[PICOCEP_MAXNR_HEADX];
+    picoacph_headx_t headx[PICOCEP_MAXNR_HEADX + PICODATA_MAXNR_WORDCMDS];
     picoos_uint16 headxBottom; /* bottom */
     picoos_uint16 headxWritePos; /* next free position; headx is empty if headxBottom == headxWritePos */
 
@@ -208,6 +214,10 @@ typedef struct cep_subobj
 
     /* this is used for input and output */
     picoos_uint8 phoneId[PICOCEP_MAXWINLEN]; /* synchronised with indexReadPos */
+#if PICOCEP_PHONE_EVENTS
+    /* one bit per frame, set for the first frame of each phone until announced */
+    picoos_uint8 phoneStart[(PICOCEP_MAXWINLEN + 7) / 8];
+#endif
 
     /*---------------------- coefficients --------------------------------------*/
     /* output coefficients buffer */
@@ -269,6 +279,10 @@ static void treat_phone(cep_subobj_t * cep, picodata_itemhead_t * ihead);
 
 static picoos_uint8 forwardingItem(picodata_itemhead_t * ihead);
 
+#if PICOCEP_PHONE_EVENTS
+static void put_phone_event(cep_subobj_t * cep);
+#endif
+
 static picodata_step_result_t cepStep(register picodata_ProcessingUnit this,
         picoos_int16 mode, picoos_uint16 * numBytesOutput);
 
@@ -1446,6 +1460,9 @@ static void treat_phone(cep_subobj_t * cep, picodata_itemhead_t * ihead)
     picoos_uint16 indlfz, indmgc;
     picoos_uint16 pos;
     picoos_uint8  bufferFull;
+#if PICOCEP_PHONE_EVENTS
+    picoos_bool first = TRUE; /* next frame is the first of the phone */
+#endif
 
     /* treat all states
      *    for each state, repeat putting the index into the index buffer framesperstate times.
@@ -1488,6 +1505,14 @@ static void treat_phone(cep_subobj_t * cep, picodata_itemhead_t * ihead)
             cep->indicesMGC[cep->indexWritePos] = indmgc;
             cep->indicesLFZ[cep->indexWritePos] = indlfz;
             cep->phoneId[cep->indexWritePos] = ihead->info1;
+#if PICOCEP_PHONE_EVENTS
+            if (first) {
+                cep->phoneStart[cep->indexWritePos >> 3] |= (picoos_uint8) (1 << (cep->indexWritePos & 7));
+                first = FALSE;
+            } else {
+                cep->phoneStart[cep->indexWritePos >> 3] &= (picoos_uint8) ~(1 << (cep->indexWritePos & 7));
+            }
+#endif
             cep->indexWritePos++;
             frame++;
         }
@@ -1506,6 +1531,39 @@ static void treat_phone(cep_subobj_t * cep, picodata_itemhead_t * ihead)
     PICODBG_DEBUG(("finished phone, advancing inReadPos to %i",cep->inReadPos));
 }
 
+#if PICOCEP_PHONE_EVENTS
+/**
+ * puts a phone command for the phone starting with the current frame into outBuf
+ * @param    cep : the cep sub-object
+ * @remarks  the phone's duration is counted up to the next phone's first frame
+ *           or the end of the active frames
+ * @callgraph
+ * @callergraph
+ */
+static void put_phone_event(cep_subobj_t * cep)
+{
+    picoos_uint16 i;
+    picoos_uint32 frames;
+
+    i = cep->indexReadPos;
+    cep->phoneStart[i >> 3] &= (picoos_uint8) ~(1 << (i & 7));
+    do {
+        i++;
+    } while ((i < cep->activeEndPos)
+            && !(cep->phoneStart[i >> 3] & (1 << (i & 7))));
+    frames = i - cep->indexReadPos;
+
+    cep->outWritePos = cep->outReadPos = 0;
+    cep->outBuf[cep->outWritePos++] = PICODATA_ITEM_CMD;
+    cep->outBuf[cep->outWritePos++] = PICODATA_ITEMINFO1_CMD_PHONE;
+    cep->outBuf[cep->outWritePos++] = cep->phoneId[cep->indexReadPos];
+    cep->outBuf[cep->outWritePos++] = 4;
+    for (i = 0; i < 4; i++) {
+        cep->outBuf[cep->outWritePos++] = (picoos_uint8) (frames >> (8 * i));
+    }
+}
+#endif
+
 /**
  * Returns true if an Item has to be forwarded to next PU
  * @param   ihead : pointer to item head structure
@@ -1698,7 +1756,7 @@ static picodata_step_result_t cepStep(register picodata_ProcessingUnit this,
                             cep->feedFollowState
                                     = PICOCEP_STEPSTATE_PROCESS_PARSE;
                             cep->procState = PICOCEP_STEPSTATE_FEED;
-                        } else if ((cep->headxWritePos < PICOCEP_MAXNR_HEADX)
+                        } else if ((cep->headxWritePos < (PICOCEP_MAXNR_HEADX + PICODATA_MAXNR_WORDCMDS))
                                 && (cep->cbufWritePos + ihead.len
                                         < cep->cbufBufSize)) {
                             /* there is enough space to store item */
@@ -1732,6 +1790,8 @@ static picodata_step_result_t cepStep(register picodata_ProcessingUnit this,
                             cep->headxWritePos++;
                         } else {
                             /* buffer full, smooth and output whatever we got */
+                            cep->activeEndPos = cep->indexWritePos;
+                            cep->sentenceEnd = TRUE;
                             PICODBG_DEBUG(("PARSE is forced to smooth prematurely; setting activeEndPos to %i", cep->activeEndPos));
                             cep->procState = PICOCEP_STEPSTATE_PROCESS_SMOOTH;
                             /* don't consume item yet */
@@ -1846,6 +1906,18 @@ static picodata_step_result_t cepStep(register picodata_ProcessingUnit this,
                     break;
                 }
 
+#if PICOCEP_PHONE_EVENTS
+                if ((cep->indexReadPos < cep->activeEndPos)
+                        && (cep->phoneStart[cep->indexReadPos >> 3]
+                                & (1 << (cep->indexReadPos & 7)))) {
+                    /* announce the phone starting with this frame, then come back */
+                    put_phone_event(cep);
+                    cep->feedFollowState = PICOCEP_STEPSTATE_PROCESS_FRAME;
+                    cep->procState = PICOCEP_STEPSTATE_FEED;
+                    break;
+                }
+#endif
+
                 if (cep->indexReadPos < cep->activeEndPos) {
                     /*------------  there are frames to output ----------------------------------------*/
                     /* still frames to output, create new FRAME_PAR item */
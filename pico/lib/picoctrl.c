@@ -741,8 +741,14 @@ pico_status_t picoctrl_engFeedText(picoctrl_Engine this,
  * @param    buffer : the destination buffer
  * @param    bufferSize : max size of the destinatioon buffer
  * @param    *bytesReceived : the number of bytes effectively returned
+ * @param    *cmdReceived : 0 if speech data was returned, otherwise the
+ *              command (PICODATA_ITEMINFO1_CMD_*) whose contents were returned
  * @return    PICO_OK : feeding succeded
  * @return    PICO_ERR_OTHER : if error
+ * @remarks    of the commands reaching the output, marks are returned, with
+ *             their name truncated to bufferSize, word commands as the text
+ *             offset and phone commands as the phone id followed by the
+ *             duration; others are dropped
  * @callgraph
  * @callergraph
  */
@@ -750,10 +756,12 @@ picodata_step_result_t picoctrl_engFetchOutputItemBytes(
         picoctrl_Engine this,
         picoos_char *buffer,
         picoos_int16 bufferSize,
-        picoos_int16 *bytesReceived) {
+        picoos_int16 *bytesReceived,
+        picoos_uint8 *cmdReceived) {
     picoos_uint16 ui;
     picodata_step_result_t stepResult;
     pico_status_t rv;
+    picoos_uint8 item[PICODATA_MAX_ITEMSIZE];
 
     if (NULL == this) {
         return (picodata_step_result_t)PICO_STEP_ERROR;
@@ -762,8 +770,39 @@ picodata_step_result_t picoctrl_engFetchOutputItemBytes(
     stepResult = this->control->step(this->control,/* mode */0,&ui);
     if (PICODATA_PU_ERROR != stepResult) {
         PICODBG_TRACE(("filling output buffer"));
-        rv = picodata_cbGetSpeechData(this->cbOut, (picoos_uint8 *)buffer,
-                                      bufferSize, &ui);
+        *cmdReceived = 0;
+        if (PICODATA_ITEM_CMD == picodata_cbGetFrontItemType(this->cbOut)) {
+            rv = picodata_cbGetItem(this->cbOut, item, PICODATA_MAX_ITEMSIZE, &ui);
+            if ((PICO_OK == rv) && (ui > 0)
+                    && (PICODATA_ITEMINFO1_CMD_MARKER == item[PICODATA_ITEMIND_INFO1])) {
+                ui = item[PICODATA_ITEMIND_LEN];
+                if (ui > bufferSize) {
+                    ui = bufferSize;
+                }
+                picoos_mem_copy(item + PICODATA_ITEM_HEADSIZE, buffer, ui);
+                *cmdReceived = PICODATA_ITEMINFO1_CMD_MARKER;
+            } else if ((PICO_OK == rv) && (ui > 0)
+                    && (PICODATA_ITEMINFO1_CMD_PHONE == item[PICODATA_ITEMIND_INFO1])
+                    && (item[PICODATA_ITEMIND_LEN] == 4) && (bufferSize >= 5)) {
+                /* phone id followed by its duration in samples */
+                buffer[0] = (picoos_char) item[PICODATA_ITEMIND_INFO2];
+                picoos_mem_copy(item + PICODATA_ITEM_HEADSIZE, buffer + 1, 4);
+                ui = 5;
+                *cmdReceived = PICODATA_ITEMINFO1_CMD_PHONE;
+            } else if ((PICO_OK == rv) && (ui > 0)
+                    && (PICODATA_ITEMINFO1_CMD_WORD == item[PICODATA_ITEMIND_INFO1])
+                    && (item[PICODATA_ITEMIND_LEN] == 4) && (bufferSize >= 4)) {
+                /* byte offset of the word in the input text */
+                picoos_mem_copy(item + PICODATA_ITEM_HEADSIZE, buffer, 4);
+                ui = 4;
+                *cmdReceived = PICODATA_ITEMINFO1_CMD_WORD;
+            } else {
+                ui = 0;
+            }
+        } else {
+            rv = picodata_cbGetSpeechData(this->cbOut, (picoos_uint8 *)buffer,
+                                          bufferSize, &ui);
+        }
 
         if (ui > 255) {   /* because picoapi uses signed int16 */
             return (picodata_step_result_t)PICO_STEP_ERROR;
@@ -78,7 +78,8 @@ picodata_step_result_t picoctrl_engFetchOutputItemBytes(
         picoctrl_Engine engine,
         picoos_char * buffer,
         picoos_int16 bufferSize,
-        picoos_int16  * bytesReceived
+        picoos_int16  * bytesReceived,
+        picoos_uint8  * cmdReceived
 );
 
 void picoctrl_engResetExceptionManager(
@@ -889,6 +889,14 @@ extern picoos_uint8 picodata_getPuTypeFromExtension(picoos_uchar * filename, pic
     return PICODATA_ITEMINFO2_CMD_TO_UNKNOWN;
 }
 
+extern picoos_uint8 picodata_getPuTypeForPlay(picoos_Common common, picoos_uchar * name)
+{
+    if (NULL != picoos_findClip(common, (picoos_char *) name)) {
+        return PICODATA_ITEMINFO2_CMD_TO_SIG;
+    }
+    return picodata_getPuTypeFromExtension(name, /*input*/TRUE);
+}
+
 
 
 
@@ -200,6 +200,10 @@ typedef struct picodata_itemhead
 #define PICODATA_ITEMINFO1_CMD_CONTEXT        'c' /* context command : context name in item content */
 #define PICODATA_ITEMINFO1_CMD_VOICE          'v' /* context command : voice name in item content */
 #define PICODATA_ITEMINFO1_CMD_MARKER         'm' /* marker command : marker name in item content */
+#define PICODATA_ITEMINFO1_CMD_WORD           'w' /* word start command : byte offset of the word in the input text as
+                                                    little endian uint32 in item content */
+#define PICODATA_ITEMINFO1_CMD_PHONE          'h' /* phone timing command : phone id in info 2, duration as little endian
+                                                    uint32 in item content, in frames up to sig and in samples after */
 #define PICODATA_ITEMINFO1_CMD_PITCH          'P' /* 80 pitch command : abs/rel info in info 2; pitch level as little endian
                                                      uint16 in item content; relative value is in promille */
 #define PICODATA_ITEMINFO1_CMD_SPEED          'R' /* 82 speed command : abs/rel info in info 2, speed level as little endian
@@ -438,6 +442,18 @@ picoos_uint8 picodata_is_valid_itemhead(const picodata_itemhead_t *head);
 
 #define PICODATA_MAX_ITEMSIZE (picoos_uint16) (PICODATA_ITEM_HEADSIZE + 256)
 
+/* if non-zero, the tokenizer outputs a word command ahead of each word, and
+ * the PUs collecting whole phrases or sentences make room for up to
+ * PICODATA_MAXNR_WORDCMDS of them on top of their own item limit */
+#ifndef PICODATA_WORD_EVENTS
+#define PICODATA_WORD_EVENTS 0
+#endif
+#if PICODATA_WORD_EVENTS
+#define PICODATA_MAXNR_WORDCMDS 60
+#else
+#define PICODATA_MAXNR_WORDCMDS 0
+#endif
+
 /* different buffer sizes per processing unit */
 #define PICODATA_BUFSIZE_DEFAULT (picoos_uint16) PICODATA_MAX_ITEMSIZE
 #define PICODATA_BUFSIZE_TEXT    (picoos_uint16)  1 * PICODATA_BUFSIZE_DEFAULT
@@ -553,6 +569,10 @@ typedef struct picodata_processing_unit
 
 picoos_uint8 picodata_getPuTypeFromExtension(picoos_uchar * filename, picoos_bool input);
 
+/* PU type to play 'name' with: sig for a clip, otherwise the PU reading
+   files with the extension of 'name' */
+picoos_uint8 picodata_getPuTypeForPlay(picoos_Common common, picoos_uchar * name);
+
 #define PICODATA_XSAMPA (picoos_uchar *)"xsampa"
 #define PICODATA_SAMPA (picoos_uchar *)"sampa"
 #define PICODATA_SVOXPA (picoos_uchar *)"svoxpa"
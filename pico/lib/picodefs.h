@@ -171,6 +171,20 @@ typedef signed int pico_Status;
 /* 16 bit PCM samples, native endianness of platform */
 #define PICO_DATA_PCM_16BIT             (pico_Int16)  1
 
+/* name of a mark (not zero terminated), reached at this point of the
+   sequence of samples */
+#define PICO_DATA_MARK                  (pico_Int16)  2
+
+/* start of a phone: 1 byte phone id followed by the phone duration in
+   samples, 4 bytes little endian (only if the engine was built with
+   PICOCEP_PHONE_EVENTS) */
+#define PICO_DATA_PHONE                 (pico_Int16)  3
+
+/* start of a word: byte offset of the word in the text put to the engine
+   since its creation or last reset, 4 bytes little endian (only if the
+   engine was built with PICODATA_WORD_EVENTS) */
+#define PICO_DATA_WORD                  (pico_Int16)  4
+
 #ifdef __cplusplus
 }
 #endif
@@ -253,6 +253,9 @@ typedef struct {
     /*picoos_uint8  nrvfields;*/  /* fix PICOKDT_NODEINFO_NRVFIELDS */
     /*picoos_uint8  nrqfields;*/  /* fix PICOKDT_NODEINFO_NRQFIELDS */
 
+    /* compiled tree (see picokdt_compileTree), NULL if not compiled */
+    const picoos_uint32 *cnodes;
+
     /* direct output vector (no output mapping) */
     picoos_uint8 dset;    /* TRUE if class set, FALSE otherwise */
     picoos_uint16 dclass;
@@ -271,10 +274,25 @@ typedef struct {
     picoos_uint8 inveclen;  /* nr of ele set in invec; must be =nrattributes */
 } kdtposd_subobj_t;
 
+/* number of graph attributes in the G2P input vector (invec[0:8]) */
+#define KDT_G2P_NRGRAPHATT  9
+
+/* mapped value of a graph attribute for which mapping failed without
+   fallback */
+#define KDT_G2P_UNMAPPED  0xFFFF
+
 typedef struct {
     kdt_subobj_t dt;
     picoos_uint16 invec[PICOKDT_NRATT_G2P];    /* input vector */
     picoos_uint8 inveclen;  /* nr of ele set in invec; must be =nrattributes */
+
+    /* word level construction, see picokdt_dtG2PsetWord */
+    picoos_uint8 bordersmapped;  /* TRUE if outsidemap and eowmap are set */
+    picoos_uint16 outsidemap[KDT_G2P_NRGRAPHATT];  /* mapped OUTSIDEGRAPH */
+    picoos_uint16 eowmap[KDT_G2P_NRGRAPHATT];  /* mapped OUTSIDEGRAPH_EOW */
+    picoos_uint16 wordmap[KDT_G2P_NRGRAPHATT][PICOKDT_G2P_MAXWORDLEN];
+    picoos_uint16 wordpos;  /* mapped POS of the word */
+    picoos_uint16 wordlen;  /* nr of graphemes of the word */
 } kdtg2p_subobj_t;
 
 typedef struct {
@@ -381,6 +399,7 @@ static pico_status_t kdtDtInitialize(register picoknow_KnowledgeBase this,
             return picoos_emRaiseException(common->em, PICO_EXC_FILE_CORRUPT,
                                            NULL, NULL);
         }
+        dtp->cnodes = NULL;
         dtp->dset = 0;
         dtp->dclass = 0;
         PICODBG_DEBUG(("tree init: nratt: %d, posomt: %d, postree: %d",
@@ -522,6 +541,9 @@ static pico_status_t kdtG2PInitialize(register picoknow_KnowledgeBase this,
         dtg2p->invec[i] = 0;
     }
     dtg2p->inveclen = 0;
+    dtg2p->bordersmapped = FALSE;
+    dtg2p->wordpos = KDT_G2P_UNMAPPED;
+    dtg2p->wordlen = 0;
     PICODBG_DEBUG(("g2p tree initialized"));
     return PICO_OK;
 }
@@ -1201,6 +1223,370 @@ static picoos_int8 kdtAskTree(register kdt_subobj_t *this,
 
 
 
+/* ************************************************************/
+/* decision tree support functions, compiled tree */
+/* ************************************************************/
+
+/* Walking the tree with kdtAskTree means decoding every node bit by
+   bit, including the subsets and children not taken. Optionally
+   (picokdt_compileTree) a tree is expanded once into an array of 32 bit
+   cells, in which each node holds its question, threshold or subsets
+   and children already decoded:
+
+   - cnode = HEADER {SUBSET}=NRFORKS-1 {CHILD}=NRFORKS
+   - HEADER: bits 0-1 node type, bits 2-9 question,
+             continuous: bits 10-31 threshold,
+             discrete: bits 10-15 NRFORKS, bits 16-31 offset from the
+             header to the first child
+   - SUBSET (discrete only): bits 0-14 first value, bits 15-29 second
+             value or group size, bits 30-31 subset type; a bit mask
+             subset is followed by the mask, 32 bits per cell, bit 0
+             of the first cell standing for the first value
+   - CHILD: index of the child's header, or KDT_CNODE_LEAF plus the
+            decision
+
+   Binary and continuous nodes have exactly two children which follow
+   the header directly. The nodes of the tree body are stored breadth
+   first, with each node's first child jumped to from the end of the
+   preceding node; cnodes keep this order. */
+
+#define KDT_CNODE_LEAF          0x80000000
+#define KDT_CNODE_MAXVAL        0x7fff
+#define KDT_CNODE_MAXCUT        0x3fffff
+#define KDT_CNODE_MAXFORKS      0x3f
+#define KDT_CNODE_MAXKIDSOFF    0xffff
+
+#define KDT_CNODE_TYPE(h)       ((h) & 0x3)
+#define KDT_CNODE_QUESTION(h)   (((h) >> 2) & 0xff)
+#define KDT_CNODE_CUT(h)        ((h) >> 10)
+#define KDT_CNODE_NRFORKS(h)    (((h) >> 10) & KDT_CNODE_MAXFORKS)
+#define KDT_CNODE_KIDSOFF(h)    ((h) >> 16)
+
+
+/* returns the number of children and the offset to the first one for
+   the cnode with header 'hdr' */
+static picoos_uint32 kdtCNodeKids(const picoos_uint32 hdr,
+                                  picoos_uint32 *kidsoff) {
+    switch (KDT_CNODE_TYPE(hdr)) {
+        case eNBinary:
+        case eNContinuous:
+            *kidsoff = 1;
+            return 2;
+        case eNDiscrete:
+            *kidsoff = KDT_CNODE_KIDSOFF(hdr);
+            return KDT_CNODE_NRFORKS(hdr);
+        default:
+            *kidsoff = 1;
+            return 0;
+    }
+}
+
+
+/* Name    :   kdtCompile
+   Function:   expands the tree body into cnodes
+   Input   :   cnodes  array of at least *nrcells cells to compile into,
+                       or NULL to only determine the number of cells
+   Output  :   nrcells number of cells used
+   Returns :   TRUE if the tree was compiled, FALSE if it is not in the
+               expected form or exceeds the limits of the cnode fields
+*/
+static picoos_uint8 kdtCompile(register kdt_subobj_t *this,
+                               picoos_uint32 *cnodes,
+                               picoos_uint32 *nrcells) {
+    picoos_uint32 iByteNo = 0;
+    picoos_int8 iBitNo = 7;
+    picoos_uint32 bodybits, nodepos, maxcells;
+    picoos_uint32 pending = 1;  /* nodes referred to, not yet compiled */
+    picoos_uint32 n = 0;        /* cells used */
+    picoos_uint32 fixnode = 0;  /* next child to point to its node, */
+    picoos_uint32 fixkid = 0;   /* as header index and child nr */
+    picoos_uint32 hdr, kidsoff, nrkids;
+    picoos_uint32 iNodeType, iQuestion, iForks, iSubsetType;
+    picoos_uint32 iVal, iBitPos, iBitCount, iJump, i, j;
+
+    bodybits = ((picoos_uint32) this->treebody[-1] << 24 |
+                (picoos_uint32) this->treebody[-2] << 16 |
+                (picoos_uint32) this->treebody[-3] << 8 |
+                (picoos_uint32) this->treebody[-4]) * 8;
+    maxcells = (NULL == cnodes) ? KDT_CNODE_LEAF : *nrcells;
+
+    while (pending > 0) {
+        nodepos = (iByteNo * 8) + (7 - iBitNo);
+        if (nodepos >= bodybits) {
+            return FALSE;
+        }
+        pending--;
+
+        /* let the first child still pointing into the tree body point
+           to this node instead, it must be the one jumping here */
+        if ((NULL != cnodes) && (n > 0)) {
+            while (TRUE) {
+                nrkids = kdtCNodeKids(cnodes[fixnode], &kidsoff);
+                while ((fixkid < nrkids) &&
+                       (cnodes[fixnode + kidsoff + fixkid] & KDT_CNODE_LEAF)) {
+                    fixkid++;
+                }
+                if (fixkid < nrkids) {
+                    break;
+                }
+                fixnode += kidsoff + nrkids;
+                fixkid = 0;
+            }
+            if (cnodes[fixnode + kidsoff + fixkid] != nodepos) {
+                return FALSE;
+            }
+            cnodes[fixnode + kidsoff + fixkid] = n;
+            fixkid++;
+        }
+
+        iNodeType = kdtGetShiftVal(this, PICOKDT_NODETYPE_NRBITS,
+                                   &iByteNo, &iBitNo);
+        iQuestion = kdtGetShiftVal(this, this->vfields[eQuestion],
+                                   &iByteNo, &iBitNo);
+        if ((iQuestion >= this->nrattributes) || (iNodeType == eNTerminal)) {
+            return FALSE;
+        }
+        hdr = iNodeType | (iQuestion << 2);
+        iForks = 2;
+        kidsoff = 1;
+        if (n + 1 > maxcells) {
+            return FALSE;
+        }
+
+        if (iNodeType == eNContinuous) {
+            iVal = kdtGetShiftVal(this, kdtGetQFieldsVal(this, iQuestion, eCut),
+                                  &iByteNo, &iBitNo);
+            if (iVal > KDT_CNODE_MAXCUT) {
+                return FALSE;
+            }
+            hdr |= iVal << 10;
+        } else if (iNodeType == eNDiscrete) {
+            iForks = kdtGetShiftVal(this,
+                                    kdtGetQFieldsVal(this, iQuestion,
+                                                     eForkCount),
+                                    &iByteNo, &iBitNo);
+            if ((iForks < 1) || (iForks > KDT_CNODE_MAXFORKS)) {
+                return FALSE;
+            }
+            for (i = 0; i < iForks - 1; i++) {
+                iSubsetType = kdtGetShiftVal(this, PICOKDT_SUBSETTYPE_NRBITS,
+                                             &iByteNo, &iBitNo);
+                iBitPos = kdtGetShiftVal(this,
+                                         kdtGetQFieldsVal(this, iQuestion,
+                                                          eBitNo),
+                                         &iByteNo, &iBitNo);
+                iBitCount = 0;
+                if (iSubsetType != eOneValue) {
+                    iBitCount = kdtGetShiftVal(this,
+                                               kdtGetQFieldsVal(this,
+                                                                iQuestion,
+                                                                eBitCount),
+                                               &iByteNo, &iBitNo);
+                }
+                if ((iBitPos > KDT_CNODE_MAXVAL) ||
+                    (iBitCount > KDT_CNODE_MAXVAL) ||
+                    (n + kidsoff + 1 + ((iBitCount + 31) / 32) > maxcells)) {
+                    return FALSE;
+                }
+                if (NULL != cnodes) {
+                    cnodes[n + kidsoff] =
+                        iBitPos | (iBitCount << 15) | (iSubsetType << 30);
+                }
+                kidsoff++;
+                if (iSubsetType == eBitMask) {
+                    for (j = 0; j < iBitCount; j++) {
+                        if ((j % 32) == 0) {
+                            if (NULL != cnodes) {
+                                cnodes[n + kidsoff] = 0;
+                            }
+                            kidsoff++;
+                        }
+                        if (kdtGetShiftVal(this, 1, &iByteNo, &iBitNo) &&
+                            (NULL != cnodes)) {
+                            cnodes[n + kidsoff - 1] |=
+                                ((picoos_uint32) 1) << (j % 32);
+                        }
+                    }
+                }
+            }
+            if (kidsoff > KDT_CNODE_MAXKIDSOFF) {
+                return FALSE;
+            }
+            hdr |= (iForks << 10) | (kidsoff << 16);
+        }
+
+        if (n + kidsoff + iForks > maxcells) {
+            return FALSE;
+        }
+        for (i = 0; i < iForks; i++) {
+            if (kdtGetShiftVal(this, PICOKDT_ISDECIDE_NRBITS,
+                               &iByteNo, &iBitNo)) {
+                iVal = kdtGetShiftVal(this, this->vfields[eDecide],
+                                      &iByteNo, &iBitNo);
+                iVal |= KDT_CNODE_LEAF;
+            } else {
+                /* bit position of the child, to be replaced with its
+                   cell index once it is compiled */
+                iJump = kdtGetShiftVal(this,
+                                       kdtGetQFieldsVal(this, iQuestion, eJump),
+                                       &iByteNo, &iBitNo);
+                iVal = (iByteNo * 8) + (7 - iBitNo) + iJump;
+                if (iVal >= bodybits) {
+                    return FALSE;
+                }
+                pending++;
+            }
+            if (NULL != cnodes) {
+                cnodes[n + kidsoff + i] = iVal;
+            }
+        }
+        if (NULL != cnodes) {
+            cnodes[n] = hdr;
+        }
+        n += kidsoff + iForks;
+    }
+    *nrcells = n;
+    return TRUE;
+}
+
+
+/* Name    :   kdtAskCompiledTree
+   Function:   classifies invec with the compiled tree, the equivalent of
+               calling kdtAskTree until a solution is found
+   Returns :   =0    solution found
+               <0    error, no solution found
+*/
+static picoos_int8 kdtAskCompiledTree(register kdt_subobj_t *this,
+                                      const picoos_uint16 *invec) {
+    const picoos_uint32 *cnodes = this->cnodes;
+    const picoos_uint32 *node = cnodes;
+    const picoos_uint32 *subset;
+    picoos_uint32 hdr, kid, iVal, iBitPos, iBitCount;
+    picoos_int32 iForks, iID, i;
+
+    while (TRUE) {
+        hdr = node[0];
+        iVal = invec[KDT_CNODE_QUESTION(hdr)];
+        switch (KDT_CNODE_TYPE(hdr)) {
+            case eNBinary:
+                if (iVal > 1) {
+                    this->dset = FALSE;
+                    return -1;
+                }
+                kid = node[1 + iVal];
+                break;
+            case eNContinuous:
+                kid = node[(iVal <= KDT_CNODE_CUT(hdr)) ? 1 : 2];
+                break;
+            default: /* eNDiscrete */
+                iForks = KDT_CNODE_NRFORKS(hdr);
+                iID = iForks - 1;
+                subset = node + 1;
+                for (i = 0; i < iForks - 1; i++) {
+                    iBitPos = *subset & KDT_CNODE_MAXVAL;
+                    iBitCount = (*subset >> 15) & KDT_CNODE_MAXVAL;
+                    switch (*subset >> 30) {
+                        case eOneValue:
+                            if (iVal == iBitPos) {
+                                iID = i;
+                            }
+                            subset++;
+                            break;
+                        case eTwoValues:
+                            if ((iVal == iBitPos) || (iVal == iBitCount)) {
+                                iID = i;
+                            }
+                            subset++;
+                            break;
+                        case eWithoutBitMask:
+                            if ((iVal >= iBitPos) &&
+                                (iVal < (iBitPos + iBitCount))) {
+                                iID = i;
+                            }
+                            subset++;
+                            break;
+                        default: /* eBitMask */
+                            if ((iVal >= iBitPos) &&
+                                (iVal < (iBitPos + iBitCount)) &&
+                                ((subset[1 + ((iVal - iBitPos) / 32)] >>
+                                  ((iVal - iBitPos) % 32)) & 1)) {
+                                iID = i;
+                            }
+                            subset += 1 + ((iBitCount + 31) / 32);
+                            break;
+                    }
+                    if (iID == i) {
+                        break;
+                    }
+                }
+                kid = node[KDT_CNODE_KIDSOFF(hdr) + iID];
+                break;
+        }
+        if (kid & KDT_CNODE_LEAF) {
+            this->dclass = (picoos_uint16) kid;
+            this->dset = TRUE;
+            return 0;    /* solution found */
+        }
+        node = cnodes + kid;
+    }
+}
+
+
+/* classifies invec, with the compiled tree if there is one */
+static picoos_int8 kdtClassify(register kdt_subobj_t *this,
+                               picoos_uint16 *invec,
+                               const kdt_nratt_t invecmax) {
+    picoos_uint32 iByteNo;
+    picoos_int8 iBitNo;
+    picoos_int8 rv;
+
+    if (NULL != this->cnodes) {
+        return kdtAskCompiledTree(this, invec);
+    }
+    iByteNo = 0;
+    iBitNo = 7;
+    while ((rv = kdtAskTree(this, invec, invecmax, &iByteNo, &iBitNo)) > 0) {
+        PICODBG_TRACE(("asking tree"));
+    }
+    return rv;
+}
+
+
+picoos_uint32 picokdt_getCompiledTreeSize(const picoknow_KnowledgeBase this) {
+    picoos_uint32 nrcells;
+
+    if ((NULL == this) || (NULL == this->subObj) ||
+        (this->subDeallocate != kdtSubObjDeallocate)) {
+        return 0;
+    }
+    if (!kdtCompile((kdt_subobj_t *) this->subObj, NULL, &nrcells)) {
+        return 0;
+    }
+    return nrcells * sizeof(picoos_uint32);
+}
+
+
+pico_status_t picokdt_compileTree(picoknow_KnowledgeBase this,
+                                  void *mem, picoos_uint32 size) {
+    kdt_subobj_t *dt;
+    picoos_uint32 nrcells = size / sizeof(picoos_uint32);
+
+    if ((NULL == this) || (NULL == this->subObj) ||
+        (this->subDeallocate != kdtSubObjDeallocate) || (NULL == mem)) {
+        return PICO_ERR_OTHER;
+    }
+    dt = (kdt_subobj_t *) this->subObj;
+    dt->cnodes = NULL;
+    if (!kdtCompile(dt, (picoos_uint32 *) mem, &nrcells)) {
+        PICODBG_WARN(("tree of kb %i not compiled", this->id));
+        return PICO_ERR_OTHER;
+    }
+    dt->cnodes = (const picoos_uint32 *) mem;
+    PICODBG_DEBUG(("tree of kb %i compiled into %i cells", this->id, nrcells));
+    return PICO_OK;
+}
+
+
 /* ************************************************************/
 /* decision tree support functions, mappings */
 /* ************************************************************/
@@ -1329,10 +1715,8 @@ static picoos_uint8 kdtMapInGraph(const kdt_subobj_t *dt,
     }
 
     /* go forward to the needed tablenr */
-    for (i = 0; i < imtnr; i++) {
-        lentable = ((picoos_uint16)(dt->inpmaptable[pos+1])) << 8 |
-            dt->inpmaptable[pos];
-        pos += lentable;
+    if (imtnr > 0) {
+        pos = dt->beg_offset[imtnr];
     }
 
     /* get length and check type of inpmaptable */
@@ -1859,20 +2243,13 @@ picoos_uint8 picokdt_dtPosPconstructInVec(const picokdt_DtPosP this,
 
 
 picoos_uint8 picokdt_dtPosPclassify(const picokdt_DtPosP this) {
-    picoos_uint32 iByteNo;
-    picoos_int8 iBitNo;
     picoos_int8 rv;
     kdtposp_subobj_t *dtposp;
     kdt_subobj_t *dt;
 
     dtposp = (kdtposp_subobj_t *)this;
     dt = &(dtposp->dt);
-    iByteNo = 0;
-    iBitNo = 7;
-    while ((rv = kdtAskTree(dt, dtposp->invec, PICOKDT_NRATT_POSP,
-                            &iByteNo, &iBitNo)) > 0) {
-        PICODBG_TRACE(("asking tree"));
-    }
+    rv = kdtClassify(dt, dtposp->invec, PICOKDT_NRATT_POSP);
     PICODBG_DEBUG(("done: %d", dt->dclass));
     return ((rv == 0) && dt->dset);
 }
@@ -1942,20 +2319,13 @@ picoos_uint8 picokdt_dtPosDconstructInVec(const picokdt_DtPosD this,
 
 picoos_uint8 picokdt_dtPosDclassify(const picokdt_DtPosD this,
                                     picoos_uint16 *treeout) {
-    picoos_uint32 iByteNo;
-    picoos_int8 iBitNo;
     picoos_int8 rv;
     kdtposd_subobj_t *dtposd;
     kdt_subobj_t *dt;
 
     dtposd = (kdtposd_subobj_t *)this;
     dt = &(dtposd->dt);
-    iByteNo = 0;
-    iBitNo = 7;
-    while ((rv = kdtAskTree(dt, dtposd->invec, PICOKDT_NRATT_POSD,
-                            &iByteNo, &iBitNo)) > 0) {
-        PICODBG_TRACE(("asking tree"));
-    }
+    rv = kdtClassify(dt, dtposd->invec, PICOKDT_NRATT_POSD);
     PICODBG_DEBUG(("done: %d", dt->dclass));
     if ((rv == 0) && dt->dset) {
         *treeout = dt->dclass;
@@ -2222,22 +2592,206 @@ picoos_uint8 picokdt_dtG2PconstructInVec(const picokdt_DtG2P this,
 
 
 
+/* map graph 'utf8char' for graph attribute 'iAttr', return the mapped
+   value, the fallback value if mapping failed, or KDT_G2P_UNMAPPED if
+   there is no fallback value either */
+static picoos_uint16 kdtG2PMapGraph(const kdtg2p_subobj_t *dtg2p,
+                                    const picoos_uint8 iAttr,
+                                    const picoos_uint8 *utf8char) {
+    picoos_uint16 outval;
+    picoos_uint16 fallback = 0;
+
+    if (!kdtMapInGraph(&(dtg2p->dt), iAttr, utf8char, PICOBASE_UTF8_MAXLEN,
+                       &outval, &fallback)) {
+        if (fallback) {
+            outval = fallback;
+        } else {
+            outval = KDT_G2P_UNMAPPED;
+        }
+    }
+    return outval;
+}
+
+
+picoos_uint8 picokdt_dtG2PsetWord(const picokdt_DtG2P this,
+                                  const picoos_uint8 *graph,
+                                  const picoos_uint16 graphlen,
+                                  const picoos_uint8 pos,
+                                  picoos_uint16 *nrgraphs) {
+    kdtg2p_subobj_t *dtg2p;
+    picoos_uint16 fallback = 0;
+    picoos_uint8 iAttr;
+    picoos_uint8 utf8char[PICOBASE_UTF8_MAXLEN + 1];
+    picoos_uint32 bpos;
+    picoos_uint16 n;
+
+    dtg2p = (kdtg2p_subobj_t *)this;
+    dtg2p->wordlen = 0;
+    *nrgraphs = 0;
+
+    /* the graph attribute values outside of the word only depend on the
+       tree, map them once */
+    if (!dtg2p->bordersmapped) {
+        for (iAttr = 0; iAttr < KDT_G2P_NRGRAPHATT; iAttr++) {
+            dtg2p->outsidemap[iAttr] =
+                kdtG2PMapGraph(dtg2p, iAttr, PICOKDT_OUTSIDEGRAPH_DEFSTR);
+            dtg2p->eowmap[iAttr] =
+                kdtG2PMapGraph(dtg2p, iAttr, PICOKDT_OUTSIDEGRAPH_EOW_DEFSTR);
+        }
+        dtg2p->bordersmapped = TRUE;
+    }
+
+    /* decode each grapheme once and map it for all graph attributes; the
+       graph context of grapheme 'ind' is then found at ind-4..ind+4 */
+    bpos = 0;
+    n = 0;
+    while (bpos < graphlen) {
+        if ((n >= PICOKDT_G2P_MAXWORDLEN) ||
+            !picobase_get_next_utf8char(graph, graphlen, &bpos, utf8char)) {
+            PICODBG_DEBUG(("no word level G2P for word of length %d",
+                           graphlen));
+            return FALSE;
+        }
+        for (iAttr = 0; iAttr < KDT_G2P_NRGRAPHATT; iAttr++) {
+            dtg2p->wordmap[iAttr][n] = kdtG2PMapGraph(dtg2p, iAttr, utf8char);
+        }
+        n++;
+    }
+    if (picobase_utf8_length(graph, graphlen) != n) {
+        return FALSE;
+    }
+
+    /* word POS, Fix1 */
+    if (!kdtMapInFixed(&(dtg2p->dt), 9, pos, &(dtg2p->wordpos), &fallback)) {
+        if (fallback) {
+            dtg2p->wordpos = fallback;
+        } else {
+            dtg2p->wordpos = KDT_G2P_UNMAPPED;
+        }
+    }
+
+    dtg2p->wordlen = n;
+    *nrgraphs = n;
+    return TRUE;
+}
+
+
+picoos_uint8 picokdt_dtG2PconstructWordInVec(const picokdt_DtG2P this,
+                                             const picoos_uint16 ind,
+                                             const picoos_uint8 nrvow,
+                                             const picoos_uint8 ordvow,
+                                             picoos_uint8 *primstressflag,
+                                             const picoos_uint16 phonech1,
+                                             const picoos_uint16 phonech2,
+                                             const picoos_uint16 phonech3) {
+    kdtg2p_subobj_t *dtg2p;
+    picoos_uint16 fallback = 0;
+    picoos_uint8 iAttr;
+    picoos_uint16 inval;
+    picoos_uint16 mapval;
+    picoos_int32 c;
+    picoos_uint8 retval;
+
+    dtg2p = (kdtg2p_subobj_t *)this;
+    retval = TRUE;
+    inval = 0;
+
+    PICODBG_TRACE(("in:  [%d,%d|%d,%d|%d|%d,%d,%d]", dtg2p->wordlen, ind,
+                   nrvow, ordvow, *primstressflag, phonech1, phonech2,
+                   phonech3));
+
+    dtg2p->inveclen = 0;
+
+    if (ind >= dtg2p->wordlen) {
+        PICODBG_ERROR(("grapheme %d outside word", ind));
+        return FALSE;
+    }
+
+    /* graph attributes (context -4..+4), already mapped by setWord; one
+       position past either end of the word is the word boundary */
+    for (iAttr = 0; iAttr < KDT_G2P_NRGRAPHATT; iAttr++) {
+        c = (picoos_int32)ind + iAttr - 4;
+        if ((c >= 0) && (c < dtg2p->wordlen)) {
+            mapval = dtg2p->wordmap[iAttr][c];
+        } else if ((c == -1) || (c == dtg2p->wordlen)) {
+            mapval = dtg2p->eowmap[iAttr];
+        } else {
+            mapval = dtg2p->outsidemap[iAttr];
+        }
+        if (mapval == KDT_G2P_UNMAPPED) {
+            PICODBG_WARN(("setting attribute %d to zero", iAttr));
+            mapval = 0;
+            retval = FALSE;
+        }
+        dtg2p->invec[iAttr] = mapval;
+    }
+
+    /* word POS, already mapped by setWord */
+    if (dtg2p->wordpos == KDT_G2P_UNMAPPED) {
+        PICODBG_WARN(("setting attribute 9 to zero"));
+        dtg2p->invec[9] = 0;
+        retval = FALSE;
+    } else {
+        dtg2p->invec[9] = dtg2p->wordpos;
+    }
+
+    /* other attributes, MapInFixed */
+    for (iAttr = 10; iAttr < PICOKDT_NRATT_G2P; iAttr++) {
+        switch (iAttr) {
+            case 10:    /* nr of vowel-like graphs in word, if vowel, Fix2  */
+                inval = nrvow;
+                break;
+            case 11:    /* order of current vowel-like graph in word, Fix2 */
+                inval = ordvow;
+                break;
+            case 12:    /* primary stress mark, Fix2 */
+                inval = (*primstressflag == 1) ? 1 : 0;
+                break;
+            case 13:    /* phone chunk right context +1, Hist */
+                inval = phonech1;
+                break;
+            case 14:    /* phone chunk right context +2, Hist */
+                inval = phonech2;
+                break;
+            case 15:    /* phone chunk right context +3, Hist */
+                inval = phonech3;
+                break;
+        }
+
+        if (!kdtMapInFixed(&(dtg2p->dt), iAttr, inval,
+                           &(dtg2p->invec[iAttr]), &fallback)) {
+            if (fallback) {
+                dtg2p->invec[iAttr] = fallback;
+            } else {
+                PICODBG_WARN(("setting attribute %d to zero", iAttr));
+                dtg2p->invec[iAttr] = 0;
+                retval = FALSE;
+            }
+        }
+    }
+
+    PICODBG_TRACE(("out: [%d,%d%,%d,%d|%d|%d,%d,%d,%d|%d,%d,%d,%d|"
+                   "%d,%d,%d]", dtg2p->invec[0], dtg2p->invec[1],
+                   dtg2p->invec[2], dtg2p->invec[3], dtg2p->invec[4],
+                   dtg2p->invec[5], dtg2p->invec[6], dtg2p->invec[7],
+                   dtg2p->invec[8], dtg2p->invec[9], dtg2p->invec[10],
+                   dtg2p->invec[11], dtg2p->invec[12], dtg2p->invec[13],
+                   dtg2p->invec[14], dtg2p->invec[15]));
+
+    dtg2p->inveclen = PICOKDT_NRINPMT_G2P;
+    return retval;
+}
+
+
 picoos_uint8 picokdt_dtG2Pclassify(const picokdt_DtG2P this,
                                    picoos_uint16 *treeout) {
-    picoos_uint32 iByteNo;
-    picoos_int8 iBitNo;
     picoos_int8 rv;
     kdtg2p_subobj_t *dtg2p;
     kdt_subobj_t *dt;
 
     dtg2p = (kdtg2p_subobj_t *)this;
     dt = &(dtg2p->dt);
-    iByteNo = 0;
-    iBitNo = 7;
-    while ((rv = kdtAskTree(dt, dtg2p->invec, PICOKDT_NRATT_G2P,
-                            &iByteNo, &iBitNo)) > 0) {
-        PICODBG_TRACE(("asking tree"));
-    }
+    rv = kdtClassify(dt, dtg2p->invec, PICOKDT_NRATT_G2P);
     PICODBG_TRACE(("done: %d", dt->dclass));
     if ((rv == 0) && dt->dset) {
         *treeout = dt->dclass;
@@ -2330,20 +2884,13 @@ picoos_uint8 picokdt_dtPHRconstructInVec(const picokdt_DtPHR this,
 
 
 picoos_uint8 picokdt_dtPHRclassify(const picokdt_DtPHR this) {
-    picoos_uint32 iByteNo;
-    picoos_int8 iBitNo;
     picoos_int8 rv;
     kdtphr_subobj_t *dtphr;
     kdt_subobj_t *dt;
 
     dtphr = (kdtphr_subobj_t *)this;
     dt = &(dtphr->dt);
-    iByteNo = 0;
-    iBitNo = 7;
-    while ((rv = kdtAskTree(dt, dtphr->invec, PICOKDT_NRATT_PHR,
-                            &iByteNo, &iBitNo)) > 0) {
-        PICODBG_TRACE(("asking tree"));
-    }
+    rv = kdtClassify(dt, dtphr->invec, PICOKDT_NRATT_PHR);
     PICODBG_DEBUG(("done: %d", dt->dclass));
     return ((rv == 0) && dt->dset);
 }
@@ -2460,20 +3007,13 @@ picoos_uint8 picokdt_dtPAMconstructInVec(const picokdt_DtPAM this,
 
 
 picoos_uint8 picokdt_dtPAMclassify(const picokdt_DtPAM this) {
-    picoos_uint32 iByteNo;
-    picoos_int8 iBitNo;
     picoos_int8 rv;
     kdtpam_subobj_t *dtpam;
     kdt_subobj_t *dt;
 
     dtpam = (kdtpam_subobj_t *)this;
     dt = &(dtpam->dt);
-    iByteNo = 0;
-    iBitNo = 7;
-    while ((rv = kdtAskTree(dt, dtpam->invec, PICOKDT_NRATT_PAM,
-                            &iByteNo, &iBitNo)) > 0) {
-        PICODBG_TRACE(("asking tree"));
-    }
+    rv = kdtClassify(dt, dtpam->invec, PICOKDT_NRATT_PAM);
     PICODBG_DEBUG(("done: %d", dt->dclass));
     return ((rv == 0) && dt->dset);
 }
@@ -2592,20 +3132,13 @@ picoos_uint8 picokdt_dtACCconstructInVec(const picokdt_DtACC this,
 
 picoos_uint8 picokdt_dtACCclassify(const picokdt_DtACC this,
                                    picoos_uint16 *treeout) {
-    picoos_uint32 iByteNo;
-    picoos_int8 iBitNo;
     picoos_int8 rv;
     kdtacc_subobj_t *dtacc;
     kdt_subobj_t *dt;
 
     dtacc = (kdtacc_subobj_t *)this;
     dt = &(dtacc->dt);
-    iByteNo = 0;
-    iBitNo = 7;
-    while ((rv = kdtAskTree(dt, dtacc->invec, PICOKDT_NRATT_ACC,
-                            &iByteNo, &iBitNo)) > 0) {
-        PICODBG_TRACE(("asking tree"));
-    }
+    rv = kdtClassify(dt, dtacc->invec, PICOKDT_NRATT_ACC);
     PICODBG_TRACE(("done: %d", dt->dclass));
     if ((rv == 0) && dt->dset) {
         *treeout = dt->dclass;
@@ -77,6 +77,18 @@ pico_status_t picokdt_specializeDtKnowledgeBase(picoknow_KnowledgeBase this,
                                                 picoos_Common common,
                                                 const picokdt_kdttype_t type);
 
+/* Optionally, a decision tree can be expanded into a compiled form
+   that is faster to classify with (see picokdt.c). getCompiledTreeSize
+   returns the number of bytes needed for it, or 0 if 'this' is not a
+   decision tree kb or cannot be compiled. compileTree compiles the tree
+   into 'mem', which must be 4 byte aligned, hold at least 'size' bytes
+   and remain valid for the lifetime of the kb. If compiling fails, the
+   tree continues to be used as it is. */
+picoos_uint32 picokdt_getCompiledTreeSize(const picoknow_KnowledgeBase this);
+
+pico_status_t picokdt_compileTree(picoknow_KnowledgeBase this,
+                                  void *mem, picoos_uint32 size);
+
 
 /* ************************************************************/
 /* decision tree types (opaque) and get Tree functions */
@@ -306,6 +318,48 @@ picoos_uint8 picokdt_dtG2PconstructInVec(const picokdt_DtG2P this,
                                          const picoos_uint16 phonech2,
                                          const picoos_uint16 phonech3);
 
+/* word level construction of G2P input vectors: instead of calling
+   picokdt_dtG2PconstructInVec for each grapheme, which decodes and maps
+   the graph context anew every time, picokdt_dtG2PsetWord decodes the
+   graphemes of a word once and maps them for all graph attributes. The
+   input vector of each grapheme is then built from this context with
+   picokdt_dtG2PconstructWordInVec, and is identical to the one
+   picokdt_dtG2PconstructInVec would produce. Words longer than
+   PICOKDT_G2P_MAXWORDLEN graphemes are not supported. */
+#define PICOKDT_G2P_MAXWORDLEN  64
+
+/* set the word for which input vectors will be constructed
+   graph:         the grapheme string of the word
+   graphlen:      length of graph in number of bytes
+   pos:           the part of speech of the word
+   nrgraphs:      number of graphemes in graph
+   returns:       TRUE if okay, FALSE if graph is too long or not valid
+                  UTF8, in which case picokdt_dtG2PconstructInVec has to
+                  be used
+*/
+picoos_uint8 picokdt_dtG2PsetWord(const picokdt_DtG2P this,
+                                  const picoos_uint8 *graph,
+                                  const picoos_uint16 graphlen,
+                                  const picoos_uint8 pos,
+                                  picoos_uint16 *nrgraphs);
+
+/* construct a G2P input vector for a grapheme of the word set with
+   picokdt_dtG2PsetWord (run in right-to-left mode)
+   ind:           the grapheme index for which invec will be constructed
+                  [0..nrgraphs-1]
+   nrvow, ordvow, primstressflag, phonech1-3: see
+                  picokdt_dtG2PconstructInVec
+   returns:       TRUE if okay, FALSE otherwise
+*/
+picoos_uint8 picokdt_dtG2PconstructWordInVec(const picokdt_DtG2P this,
+                                             const picoos_uint16 ind,
+                                             const picoos_uint8 nrvow,
+                                             const picoos_uint8 ordvow,
+                                             picoos_uint8 *primstressflag,
+                                             const picoos_uint16 phonech1,
+                                             const picoos_uint16 phonech2,
+                                             const picoos_uint16 phonech3);
+
 /* classify a previously constructed input vector using tree 'this'
    treeout:       direct tree output value
    returns:       TRUE if okay, FALSE otherwise
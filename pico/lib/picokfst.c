@@ -67,6 +67,14 @@ typedef struct kfst_subobj{
     picoos_int32 transTabPos;         /* absolute address of the start of the transition table */
     picoos_int32 inEpsStateTabPos;    /* absolute address of the start of the input epsilon transition table */
     picoos_int32 accStateTabPos;      /* absolute address of the table of accepting states */
+
+    /* dense form of the FST (see picokfst_makeDense), all NULL if not made */
+    picoos_uint8 * denseTrans;        /* transition table, one byte per entry */
+    picoos_int16 * denseAlphaHash;    /* first symbol cell per hash value, -1 if none */
+    picoos_int16 * denseSymCells;     /* symbol cells: inSym, next cell of same hash or -1, first pair */
+    picoos_int16 * densePairs;        /* outSym/pairClass lists, each terminated by PICOKFST_SYMID_ILLEG */
+    picoos_int16 * denseInEpsState;   /* first input epsilon transition per state, -1 if none */
+    picoos_int16 * denseInEpsTrans;   /* outSym/endState lists, each terminated by PICOKFST_SYMID_ILLEG */
 } kfst_subobj_t;
 
 
@@ -177,6 +185,13 @@ static pico_status_t kfstInitialize(register picoknow_KnowledgeBase this,
     kfst->accStateTabPos = kfst->hdrLen + offs;
     /* -CT- */
 
+    kfst->denseTrans = NULL;
+    kfst->denseAlphaHash = NULL;
+    kfst->denseSymCells = NULL;
+    kfst->densePairs = NULL;
+    kfst->denseInEpsState = NULL;
+    kfst->denseInEpsTrans = NULL;
+
     return PICO_OK;
 }
 
@@ -220,6 +235,179 @@ pico_status_t picokfst_specializeFSTKnowledgeBase(picoknow_KnowledgeBase this,
 }
 
 
+/* ************************************************************/
+/* dense form of FST */
+/* ************************************************************/
+
+/* Walks the pair alphabet and the input epsilon transitions of 'fst'. If the
+   arrays of the dense form are set, they are filled; in any case the number
+   of 16 bit cells each of them needs is returned. */
+static void kfstWalkLists (kfst_SubObj fst, picoos_int32 * nrSymCells, picoos_int32 * nrPairCells,
+                           picoos_int32 * nrInEpsCells)
+{
+    picoos_int32 h;
+    picoos_int32 state;
+    picoos_int32 offs;
+    picoos_int32 cellPos;
+    picoos_int32 inSym;
+    picoos_int32 nextOffs;
+    picoos_int32 val1;
+    picoos_int32 val2;
+    picoos_int32 prevCell;
+    picoos_uint32 pos;
+
+    (*nrSymCells) = 0;
+    (*nrPairCells) = 0;
+    (*nrInEpsCells) = 0;
+
+    /* pair alphabet; the cells of each hash chain keep their order */
+    for (h = 0; h < fst->alphaHashTabSize; h++) {
+        pos = fst->alphaHashTabPos + (h * 4);
+        FixedBytesToSignedNum(fst->fstStream,4,& pos,& offs);
+        if (NULL != fst->denseAlphaHash) {
+            fst->denseAlphaHash[h] = -1;
+        }
+        prevCell = -1;
+        cellPos = fst->alphaHashTabPos + offs;
+        while (offs > 0) {
+            pos = cellPos;
+            BytesToNum(fst->fstStream,& pos,& inSym);
+            BytesToNum(fst->fstStream,& pos,& nextOffs);
+            if (NULL != fst->denseSymCells) {
+                if (prevCell < 0) {
+                    fst->denseAlphaHash[h] = (picoos_int16)(*nrSymCells);
+                } else {
+                    fst->denseSymCells[prevCell + 1] = (picoos_int16)(*nrSymCells);
+                }
+                fst->denseSymCells[(*nrSymCells)] = (picoos_int16)inSym;
+                fst->denseSymCells[(*nrSymCells) + 1] = -1;
+                fst->denseSymCells[(*nrSymCells) + 2] = (picoos_int16)(*nrPairCells);
+            }
+            prevCell = (*nrSymCells);
+            (*nrSymCells) += 3;
+            do {
+                BytesToNum(fst->fstStream,& pos,& val1);
+                val2 = -1;
+                if (val1 != PICOKFST_SYMID_ILLEG) {
+                    BytesToNum(fst->fstStream,& pos,& val2);
+                }
+                if (NULL != fst->densePairs) {
+                    fst->densePairs[(*nrPairCells)] = (picoos_int16)val1;
+                    fst->densePairs[(*nrPairCells) + 1] = (picoos_int16)val2;
+                }
+                (*nrPairCells) += 2;
+            } while (val1 != PICOKFST_SYMID_ILLEG);
+            offs = nextOffs;
+            cellPos = cellPos + nextOffs;
+        }
+    }
+
+    /* input epsilon transitions */
+    for (state = 1; state <= fst->nrStates; state++) {
+        pos = fst->inEpsStateTabPos + (state - 1) * 4;
+        FixedBytesToSignedNum(fst->fstStream,4,& pos,& offs);
+        if (NULL != fst->denseInEpsState) {
+            fst->denseInEpsState[state - 1] = (offs > 0) ? (picoos_int16)(*nrInEpsCells) : -1;
+        }
+        if (offs > 0) {
+            pos = fst->inEpsStateTabPos + offs;
+            do {
+                BytesToNum(fst->fstStream,& pos,& val1);
+                val2 = 0;
+                if (val1 != PICOKFST_SYMID_ILLEG) {
+                    BytesToNum(fst->fstStream,& pos,& val2);
+                }
+                if (NULL != fst->denseInEpsTrans) {
+                    fst->denseInEpsTrans[(*nrInEpsCells)] = (picoos_int16)val1;
+                    fst->denseInEpsTrans[(*nrInEpsCells) + 1] = (picoos_int16)val2;
+                }
+                (*nrInEpsCells) += 2;
+            } while (val1 != PICOKFST_SYMID_ILLEG);
+        }
+    }
+}
+
+
+/* returns the FST subobject of kb 'this', or NULL if 'this' is no FST kb */
+static kfst_SubObj kfstGetSubObj (picoknow_KnowledgeBase this)
+{
+    if ((NULL == this) || (NULL == this->subObj) || (this->subDeallocate != kfstSubObjDeallocate)) {
+        return NULL;
+    }
+    return (kfst_SubObj) this->subObj;
+}
+
+
+/* see description in header file */
+picoos_uint32 picokfst_getDenseSize (picoknow_KnowledgeBase this)
+{
+    kfst_SubObj fst;
+    picoos_int32 nrSymCells;
+    picoos_int32 nrPairCells;
+    picoos_int32 nrInEpsCells;
+    picoos_int32 nrCells;
+
+    fst = kfstGetSubObj(this);
+    /* only FSTs with single byte transition table entries are supported;
+       the dense lists are indexed with 16 bit numbers */
+    if ((NULL == fst) || (fst->transTabEntrySize != 1) || (fst->alphaHashTabSize <= 0)) {
+        return 0;
+    }
+    kfstWalkLists(fst,& nrSymCells,& nrPairCells,& nrInEpsCells);
+    if ((nrSymCells > 32767) || (nrPairCells > 32767) || (nrInEpsCells > 32767)) {
+        return 0;
+    }
+    nrCells = fst->alphaHashTabSize + nrSymCells + nrPairCells + fst->nrStates + nrInEpsCells;
+    return nrCells * sizeof(picoos_int16) + fst->nrStates * fst->nrClasses;
+}
+
+
+/* see description in header file */
+pico_status_t picokfst_makeDense (picoknow_KnowledgeBase this, void * mem, picoos_uint32 size)
+{
+    kfst_SubObj fst;
+    picoos_int32 nrSymCells;
+    picoos_int32 nrPairCells;
+    picoos_int32 nrInEpsCells;
+    picoos_int16 * cells;
+    picoos_uint32 pos;
+    picoos_int32 i;
+
+    fst = kfstGetSubObj(this);
+    if ((NULL == fst) || (NULL == mem) || (size == 0) || (size < picokfst_getDenseSize(this))) {
+        return PICO_ERR_OTHER;
+    }
+    fst->denseTrans = NULL;
+    fst->denseAlphaHash = NULL;
+    fst->denseSymCells = NULL;
+    fst->densePairs = NULL;
+    fst->denseInEpsState = NULL;
+    fst->denseInEpsTrans = NULL;
+    kfstWalkLists(fst,& nrSymCells,& nrPairCells,& nrInEpsCells);
+
+    cells = (picoos_int16 *) mem;
+    fst->denseAlphaHash = cells;
+    cells += fst->alphaHashTabSize;
+    fst->denseSymCells = cells;
+    cells += nrSymCells;
+    fst->densePairs = cells;
+    cells += nrPairCells;
+    fst->denseInEpsState = cells;
+    cells += fst->nrStates;
+    fst->denseInEpsTrans = cells;
+    cells += nrInEpsCells;
+    kfstWalkLists(fst,& nrSymCells,& nrPairCells,& nrInEpsCells);
+
+    /* the transition table is used as is, only moved into RAM */
+    fst->denseTrans = (picoos_uint8 *) cells;
+    pos = fst->transTabPos;
+    for (i = 0; i < fst->nrStates * fst->nrClasses; i++) {
+        fst->denseTrans[i] = fst->fstStream[pos++];
+    }
+    return PICO_OK;
+}
+
+
 /* ************************************************************/
 /* FST type and getFST function */
 /* ************************************************************/
@@ -282,6 +470,19 @@ extern void picokfst_kfstStartPairSearch (picokfst_FST this, picokfst_symid_t in
     kfst_SubObj fst = (kfst_SubObj) this;
     (*searchState) =  -1;
     (*inSymFound) = 0;
+    if (NULL != fst->denseSymCells) {
+        if (inSym >= 0) {
+            offs = fst->denseAlphaHash[inSym % fst->alphaHashTabSize];
+            while ((offs >= 0) && (fst->denseSymCells[offs] != inSym)) {
+                offs = fst->denseSymCells[offs + 1];
+            }
+            if (offs >= 0) {
+                (*searchState) = fst->denseSymCells[offs + 2];
+                (*inSymFound) = 1;
+            }
+        }
+        return;
+    }
     h = inSym % fst->alphaHashTabSize;
     pos = fst->alphaHashTabPos + (h * 4);
     FixedBytesToSignedNum(fst->fstStream,4,& pos,& offs);
@@ -318,6 +519,12 @@ extern void picokfst_kfstGetNextPair (picokfst_FST this, picoos_int32 * searchSt
         (*pairFound) = 0;
         (*outSym) = PICOKFST_SYMID_ILLEG;
         (*pairClass) =  -1;
+    } else if (NULL != fst->densePairs) {
+        pos = (*searchState);
+        *outSym = fst->densePairs[pos];
+        *pairClass = fst->densePairs[pos + 1];
+        (*pairFound) = ((*outSym) != PICOKFST_SYMID_ILLEG);
+        (*searchState) = (*pairFound) ? (picoos_int32)(pos + 2) : -1;
     } else {
         pos = (*searchState);
         BytesToNum(fst->fstStream,& pos,& val);
@@ -352,6 +559,10 @@ extern void picokfst_kfstGetTrans (picokfst_FST this, picokfst_state_t startStat
         (*endState) = 0;
     } else {
         index = (startState - 1) * fst->nrClasses + transClass - 1;
+        if (NULL != fst->denseTrans) {
+            (*endState) = fst->denseTrans[index];
+            return;
+        }
         pos = fst->transTabPos + (index * fst->transTabEntrySize);
         FixedBytesToUnsignedNum(fst->fstStream,fst->transTabEntrySize,& pos,& endStateX);
         (*endState) = endStateX;
@@ -370,7 +581,10 @@ extern void picokfst_kfstStartInEpsTransSearch (picokfst_FST this, picokfst_stat
     kfst_SubObj fst = (kfst_SubObj) this;
     (*searchState) =  -1;
     (*inEpsTransFound) = 0;
-    if ((startState > 0) && (startState <= fst->nrStates)) {
+    if ((startState > 0) && (startState <= fst->nrStates) && (NULL != fst->denseInEpsState)) {
+        (*searchState) = fst->denseInEpsState[startState - 1];
+        (*inEpsTransFound) = ((*searchState) >= 0);
+    } else if ((startState > 0) && (startState <= fst->nrStates)) {
         pos = fst->inEpsStateTabPos + (startState - 1) * 4;
         FixedBytesToSignedNum(fst->fstStream,4,& pos,& offs);
         if (offs > 0) {
@@ -395,6 +609,12 @@ extern void picokfst_kfstGetNextInEpsTrans (picokfst_FST this, picoos_int32 * se
         (*inEpsTransFound) = 0;
         (*outSym) = PICOKFST_SYMID_ILLEG;
         (*endState) = 0;
+    } else if (NULL != fst->denseInEpsTrans) {
+        pos = (*searchState);
+        *outSym = fst->denseInEpsTrans[pos];
+        *endState = fst->denseInEpsTrans[pos + 1];
+        (*inEpsTransFound) = ((*outSym) != PICOKFST_SYMID_ILLEG);
+        (*searchState) = (*inEpsTransFound) ? (picoos_int32)(pos + 2) : -1;
     } else {
         pos = (*searchState);
         BytesToNum(fst->fstStream,& pos,& val);
@@ -91,6 +91,20 @@ pico_status_t picokfst_specializeFSTKnowledgeBase(picoknow_KnowledgeBase this,
                                                   picoos_Common common);
 
 
+/* Optionally, an FST can be expanded into a dense form in RAM: the transition
+   table, the pair alphabet and the input epsilon transitions are decoded into
+   directly indexable arrays, which the FST access methods then use instead of
+   decoding the byte stream. The dense form gives the same results. */
+
+/* returns the size in bytes of the dense form of FST kb 'this', or 0 if
+   'this' is no FST kb or it cannot be made dense */
+picoos_uint32 picokfst_getDenseSize(picoknow_KnowledgeBase this);
+
+/* builds the dense form of FST kb 'this' in 'mem' of 'size' bytes, which
+   must be at least the size returned by picokfst_getDenseSize and 2 byte
+   aligned; 'mem' must remain valid for as long as kb 'this' is used */
+pico_status_t picokfst_makeDense(picoknow_KnowledgeBase this, void * mem, picoos_uint32 size);
+
 /* ************************************************************/
 /* FST type and getFST function */
 /* ************************************************************/
@@ -100,6 +100,22 @@ extern "C" {
       - PHON can be :G2P -> use G2P later to add pronunciation:
         lexentry = LENGRAPH1 {GRAPH1}=LENGRAPH1-1  3 POS1 <reserved-phon-val=5>
     - multi-byte values always little endian
+
+  index-kb: optional minimal perfect hash index over the distinct graphs
+  of a lex-kb, mapping each graph to the lexpos of its first lexentry
+  (built by tools/picorsrc.py)
+
+    index-kb = NRKEYS4 NRBUCKETS4 SEED4 NRBLOCKS2 RESERVED2
+               {DISPL2}=NRBUCKETS {LEXPOS3 CHECK1}=NRKEYS
+
+    - h = 32 bit FNV-1a hash of the graph, with SEED xor'ed into the
+      offset basis
+    - slot = fmix32(h + DISPL[h mod NRBUCKETS] * 0x9E3779B9) mod NRKEYS,
+      fmix32 being the MurmurHash3 finalizer
+    - CHECK is the top byte of h
+    - NRBLOCKS must match the lex-kb; a graph not in the lexicon maps
+      to some slot, so if CHECK matches the lexentry at LEXPOS must be
+      compared
 */
 
 
@@ -125,6 +141,41 @@ extern "C" {
 /* reserved values in klex to indicate :G2P needed for a lexentry */
 #define PICOKLEX_NEEDS_G2P   5
 
+/* no lexblock fetched via block reader yet */
+#define PICOKLEX_NO_BLOCK    0xFFFFFFFF
+
+
+/* ************************************************************/
+/* lookup cache defines */
+/* ************************************************************/
+
+/* nr of lookup results cached per lexicon, 0 disables the cache */
+#ifndef PICOKLEX_CACHE_SIZE
+#define PICOKLEX_CACHE_SIZE 0
+#endif
+
+/* longest graph (in bytes) for which lookup results are cached */
+#define PICOKLEX_CACHE_MAXGRAPHLEN 23
+
+/* nr of hash buckets, power of 2 */
+#define PICOKLEX_CACHE_NRBUCKETS 256
+
+/* end of hash chain or lru list */
+#define PICOKLEX_CACHE_NIL 0xFFFF
+
+
+/* ************************************************************/
+/* lexicon index defines */
+/* ************************************************************/
+
+/* nr bytes of index header, DISPL and LEXPOS entries */
+#define PICOKLEX_INDEX_HEADER_SIZE 16
+#define PICOKLEX_INDEX_DISPL_SIZE  2
+#define PICOKLEX_INDEX_SLOT_SIZE   4
+
+/* lexpos returned for graphs rejected by the index check byte */
+#define PICOKLEX_INDEX_NO_LEXPOS   0xFFFFFFFF
+
 
 /* ************************************************************/
 /* lexicon type and loading */
@@ -142,9 +193,190 @@ typedef struct klex_subobj
     picoos_uint16 nrblocks; /* nr lexblocks = nr eles in searchind */
     picoos_uint8 *searchind;
     picoos_uint8 *lexblocks;
+
+    /* block compressed lexblocks, lexblocks is not valid if reader set */
+    picoknow_BlockReader reader;
+    picoos_uint32 curBlockNr;
+    picoos_uint8 *curBlock;
+
+    /* lookup cache, NULL if disabled */
+    struct klex_cache *cache;
+
+    /* perfect hash index, displ is NULL if there is no index */
+    picoos_uint8 *displ;
+    picoos_uint8 *slots;
+    picoos_uint32 indexNrKeys;
+    picoos_uint32 indexNrBuckets;
+    picoos_uint32 indexSeed;
 } klex_subobj_t;
 
 
+/* ************************************************************/
+/* lookup cache */
+/* ************************************************************/
+
+/* The results of recent lookups (including unsuccessful ones) are kept
+   in a small cache, keyed by graph. The entries are hashed into buckets
+   and kept in least recently used order; when the cache is full the
+   least recently used entry is replaced. Results only contain
+   positions within the lexicon, so they stay valid as long as the
+   lexicon kb itself, and the cache is disposed of together with it. */
+
+typedef struct {
+    picoos_uint16 hnext;    /* next entry in hash chain */
+    picoos_uint16 prev;     /* lru list, towards most recently used */
+    picoos_uint16 next;     /* lru list, towards least recently used */
+    picoos_uint8 graphlen;
+    picoos_uint8 graph[PICOKLEX_CACHE_MAXGRAPHLEN];
+    picoklex_lexl_result_t lexres;
+} klex_cache_entry_t;
+
+typedef struct klex_cache {
+    picoos_uint16 bucket[PICOKLEX_CACHE_NRBUCKETS];
+    picoos_uint16 first;    /* most recently used */
+    picoos_uint16 last;     /* least recently used */
+    picoos_uint16 nrused;
+    picoos_uint32 hits;
+    picoos_uint32 misses;
+    klex_cache_entry_t entry[PICOKLEX_CACHE_SIZE > 0 ? PICOKLEX_CACHE_SIZE : 1];
+} klex_cache_t;
+
+
+static picoos_uint16 klex_cacheHash(const picoos_uint8 *graph,
+                                    const picoos_uint16 graphlen)
+{
+    picoos_uint32 h = 2166136261u;
+    picoos_uint16 i;
+
+    for (i = 0; i < graphlen; i++) {
+        h = (h ^ graph[i]) * 16777619u;
+    }
+    return (picoos_uint16) ((h ^ (h >> 16)) & (PICOKLEX_CACHE_NRBUCKETS - 1));
+}
+
+
+static picoos_uint8 klex_cacheGraphEqual(const picoos_uint8 *a,
+                                         const picoos_uint8 *b,
+                                         const picoos_uint16 len)
+{
+    picoos_uint16 i;
+
+    for (i = 0; i < len; i++) {
+        if (a[i] != b[i]) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+
+static void klex_cacheUnlinkLru(klex_cache_t *cache, picoos_uint16 e)
+{
+    klex_cache_entry_t *entry = &(cache->entry[e]);
+
+    if (entry->prev != PICOKLEX_CACHE_NIL) {
+        cache->entry[entry->prev].next = entry->next;
+    } else {
+        cache->first = entry->next;
+    }
+    if (entry->next != PICOKLEX_CACHE_NIL) {
+        cache->entry[entry->next].prev = entry->prev;
+    } else {
+        cache->last = entry->prev;
+    }
+}
+
+
+static void klex_cachePushLru(klex_cache_t *cache, picoos_uint16 e)
+{
+    klex_cache_entry_t *entry = &(cache->entry[e]);
+
+    entry->prev = PICOKLEX_CACHE_NIL;
+    entry->next = cache->first;
+    if (cache->first != PICOKLEX_CACHE_NIL) {
+        cache->entry[cache->first].prev = e;
+    } else {
+        cache->last = e;
+    }
+    cache->first = e;
+}
+
+
+static void klex_cacheInit(klex_cache_t *cache)
+{
+    picoos_uint16 i;
+
+    for (i = 0; i < PICOKLEX_CACHE_NRBUCKETS; i++) {
+        cache->bucket[i] = PICOKLEX_CACHE_NIL;
+    }
+    cache->first = PICOKLEX_CACHE_NIL;
+    cache->last = PICOKLEX_CACHE_NIL;
+    cache->nrused = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+
+/* Returns the cached result for graph, or NULL if there is none. */
+
+static const picoklex_lexl_result_t *klex_cacheGet(klex_cache_t *cache,
+                                                   const picoos_uint8 *graph,
+                                                   const picoos_uint16 graphlen)
+{
+    picoos_uint16 e;
+    klex_cache_entry_t *entry;
+
+    e = cache->bucket[klex_cacheHash(graph, graphlen)];
+    while (e != PICOKLEX_CACHE_NIL) {
+        entry = &(cache->entry[e]);
+        if ((entry->graphlen == graphlen) &&
+            klex_cacheGraphEqual(entry->graph, graph, graphlen)) {
+            if (cache->first != e) {
+                klex_cacheUnlinkLru(cache, e);
+                klex_cachePushLru(cache, e);
+            }
+            cache->hits++;
+            return &(entry->lexres);
+        }
+        e = entry->hnext;
+    }
+    cache->misses++;
+    return NULL;
+}
+
+
+static void klex_cachePut(klex_cache_t *cache,
+                          const picoos_uint8 *graph,
+                          const picoos_uint16 graphlen,
+                          const picoklex_lexl_result_t *lexres)
+{
+    picoos_uint16 e, *pe, h;
+    klex_cache_entry_t *entry;
+
+    if (cache->nrused < PICOKLEX_CACHE_SIZE) {
+        e = cache->nrused++;
+    } else {
+        /* replace least recently used entry */
+        e = cache->last;
+        entry = &(cache->entry[e]);
+        klex_cacheUnlinkLru(cache, e);
+        pe = &(cache->bucket[klex_cacheHash(entry->graph, entry->graphlen)]);
+        while (*pe != e) {
+            pe = &(cache->entry[*pe].hnext);
+        }
+        *pe = entry->hnext;
+    }
+    entry = &(cache->entry[e]);
+    entry->graphlen = (picoos_uint8) graphlen;
+    picoos_mem_copy(graph, entry->graph, graphlen);
+    picoos_mem_copy(lexres, &(entry->lexres), sizeof(picoklex_lexl_result_t));
+    h = klex_cacheHash(graph, graphlen);
+    entry->hnext = cache->bucket[h];
+    cache->bucket[h] = e;
+    klex_cachePushLru(cache, e);
+}
+
+
 static pico_status_t klexInitialize(register picoknow_KnowledgeBase this,
                                     picoos_Common common)
 {
@@ -171,6 +403,24 @@ static pico_status_t klexInitialize(register picoknow_KnowledgeBase this,
         }
         klex->lexblocks = this->base + PICOKLEX_LEX_NRBLOCKS_SIZE +
                              (klex->nrblocks * (PICOKLEX_LEX_SIE_SIZE));
+        klex->reader = this->blockReader;
+        klex->curBlockNr = PICOKLEX_NO_BLOCK;
+        klex->curBlock = NULL;
+        if (NULL != klex->cache) {
+            klex_cacheInit(klex->cache);
+        }
+        klex->displ = NULL;
+        klex->slots = NULL;
+        if (NULL != klex->reader) {
+            /* the searchindex must be plain, and lexblocks must not be
+               split across compressed blocks */
+            if ((klex->reader->rawSize != (picoos_uint32)(klex->lexblocks - this->base))
+                || (klex->reader->blockSize == 0)
+                || ((klex->reader->blockSize % PICOKLEX_LEXBLOCK_SIZE) != 0)) {
+                return picoos_emRaiseException(common->em, PICO_EXC_FILE_CORRUPT,
+                                               NULL, NULL);
+            }
+        }
         return PICO_OK;
     } else {
         return picoos_emRaiseException(common->em, PICO_EXC_FILE_CORRUPT,
@@ -183,6 +433,10 @@ static pico_status_t klexSubObjDeallocate(register picoknow_KnowledgeBase this,
                                           picoos_MemoryManager mm)
 {
     if (NULL != this) {
+        if ((NULL != this->subObj) &&
+            (NULL != ((klex_SubObj) this->subObj)->cache)) {
+            picoos_deallocate(mm, (void *) &((klex_SubObj) this->subObj)->cache);
+        }
         picoos_deallocate(mm, (void *) &this->subObj);
     }
     return PICO_OK;
@@ -207,6 +461,15 @@ pico_status_t picoklex_specializeLexKnowledgeBase(picoknow_KnowledgeBase this,
             return picoos_emRaiseException(common->em, PICO_EXC_OUT_OF_MEM,
                                            NULL, NULL);
         }
+        ((klex_SubObj) this->subObj)->cache = NULL;
+        if ((PICOKLEX_CACHE_SIZE > 0) &&
+            (PICOKNOW_KBID_LEX_MAIN == this->id)) {
+            /* lookups work without the cache, so not having memory for
+               it is not an error; user lexica are small and usually
+               indexed, they go without */
+            ((klex_SubObj) this->subObj)->cache =
+                picoos_allocate(common->mm, sizeof(klex_cache_t));
+        }
         return klexInitialize(this, common);
     } else {
         /* some dummy klex */
@@ -239,6 +502,81 @@ picoklex_Lex picoklex_getLex(picoknow_KnowledgeBase this)
 }
 
 
+void picoklex_setIndex(picoklex_Lex this, picoknow_KnowledgeBase indexkb)
+{
+    klex_SubObj klex = (klex_SubObj) this;
+    picoos_uint32 pos = 0;
+    picoos_uint32 nrkeys, nrbuckets, seed;
+    picoos_uint16 nrblocks;
+
+    if (NULL == klex) {
+        return;
+    }
+    klex->displ = NULL;
+    klex->slots = NULL;
+    if ((NULL == indexkb) || (NULL == indexkb->base) ||
+        (NULL != indexkb->blockReader) ||
+        (indexkb->size < PICOKLEX_INDEX_HEADER_SIZE)) {
+        return;
+    }
+    picoos_read_mem_pi_uint32(indexkb->base, &pos, &nrkeys);
+    picoos_read_mem_pi_uint32(indexkb->base, &pos, &nrbuckets);
+    picoos_read_mem_pi_uint32(indexkb->base, &pos, &seed);
+    picoos_read_mem_pi_uint16(indexkb->base, &pos, &nrblocks);
+    if ((nrkeys == 0) || (nrbuckets == 0) || (nrblocks != klex->nrblocks) ||
+        (indexkb->size != PICOKLEX_INDEX_HEADER_SIZE +
+                          nrbuckets * PICOKLEX_INDEX_DISPL_SIZE +
+                          nrkeys * PICOKLEX_INDEX_SLOT_SIZE)) {
+        PICODBG_WARN(("lexicon index does not match lexicon, ignored"));
+        return;
+    }
+    klex->indexNrKeys = nrkeys;
+    klex->indexNrBuckets = nrbuckets;
+    klex->indexSeed = seed;
+    klex->displ = indexkb->base + PICOKLEX_INDEX_HEADER_SIZE;
+    klex->slots = klex->displ + nrbuckets * PICOKLEX_INDEX_DISPL_SIZE;
+}
+
+
+/* ************************************************************/
+/* functions on index */
+/* ************************************************************/
+
+/* Get the lexpos the index holds for 'graph'. If graph is in the
+   lexicon this is the lexpos of its first lexentry, otherwise it is
+   PICOKLEX_INDEX_NO_LEXPOS or the lexpos of some other lexentry. */
+
+static picoos_uint32 klex_getIndexLexpos(const klex_SubObj this,
+                                         const picoos_uint8 *graph,
+                                         const picoos_uint16 graphlen)
+{
+    picoos_uint32 hg, h, d, slot;
+    picoos_uint8 *p;
+    picoos_uint16 i;
+
+    hg = 2166136261u ^ this->indexSeed;
+    for (i = 0; i < graphlen; i++) {
+        hg = (hg ^ graph[i]) * 16777619u;
+    }
+    p = this->displ + (hg % this->indexNrBuckets) * PICOKLEX_INDEX_DISPL_SIZE;
+    d = p[0] | ((picoos_uint32) p[1] << 8);
+
+    h = hg + d * 0x9E3779B9u;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    slot = h % this->indexNrKeys;
+
+    p = this->slots + slot * PICOKLEX_INDEX_SLOT_SIZE;
+    if (p[3] != (picoos_uint8) (hg >> 24)) {
+        return PICOKLEX_INDEX_NO_LEXPOS;
+    }
+    return p[0] | ((picoos_uint32) p[1] << 8) | ((picoos_uint32) p[2] << 16);
+}
+
+
 /* ************************************************************/
 /* functions on searchindex */
 /* ************************************************************/
@@ -355,6 +693,59 @@ static picoos_uint16 klex_getLexblockRange(const klex_SubObj this,
 /* functions on single lexblock */
 /* ************************************************************/
 
+/* Get a pointer to position 'lexpos' in the lexblocks byte stream. If
+   the lexblocks are block compressed the containing block is fetched
+   via the block reader. Lexentries never cross lexblock boundaries, so
+   the whole lexentry starting at 'lexpos' is accessible. Returns NULL
+   if the block cannot be fetched. */
+
+static picoos_uint8 *klex_getLexpos(const klex_SubObj this,
+                                    const picoos_uint32 lexpos) {
+    picoos_uint32 nr;
+
+    if (NULL == this->reader) {
+        return &(this->lexblocks[lexpos]);
+    }
+    nr = lexpos / this->reader->blockSize;
+    if (nr != this->curBlockNr) {
+        this->curBlock = this->reader->getBlock(this->reader, nr);
+        if (NULL == this->curBlock) {
+            this->curBlockNr = PICOKLEX_NO_BLOCK;
+            return NULL;
+        }
+        this->curBlockNr = nr;
+    }
+    return &(this->curBlock[lexpos % this->reader->blockSize]);
+}
+
+
+/* Advance from the lexentry at 'lexpos' to the next lexentry. If there
+   are no more entries in a block, advance to next block by skipping
+   all zeros. Returns lexposEnd if there are no more entries. */
+
+static picoos_uint32 klex_nextLexpos(const klex_SubObj this,
+                                     picoos_uint32 lexpos,
+                                     const picoos_uint32 lexposEnd) {
+    picoos_uint8 *lexentry;
+
+    lexentry = klex_getLexpos(this, lexpos);
+    if (NULL == lexentry) {
+        return lexposEnd;
+    }
+    lexpos += lexentry[0];
+    lexpos += lexentry[lexentry[0]];
+    while (lexpos < lexposEnd) {
+        lexentry = klex_getLexpos(this, lexpos);
+        if (NULL == lexentry) {
+            return lexposEnd;
+        } else if (lexentry[0] != 0) {
+            break;
+        }
+        lexpos++;
+    }
+    return lexpos;
+}
+
 static picoos_int8 klex_lexMatch(picoos_uint8 *lexentry,
                                  const picoos_uint8 *graph,
                                  const picoos_uint16 graphlen) {
@@ -420,6 +811,7 @@ static void klex_lexblockLookup(klex_SubObj this,
                                 const picoos_uint16 graphlen,
                                 picoklex_lexl_result_t *lexres) {
     picoos_uint32 lexpos;
+    picoos_uint8 *lexentry;
     picoos_int8 rv;
 
     lexres->nrres = 0;
@@ -428,28 +820,25 @@ static void klex_lexblockLookup(klex_SubObj this,
     rv = -1;
     while ((rv < 0) && (lexpos < lexposEnd)) {
 
-        rv = klex_lexMatch(&(this->lexblocks[lexpos]), graph, graphlen);
+        lexentry = klex_getLexpos(this, lexpos);
+        if (NULL == lexentry) {
+            break;
+        }
+        rv = klex_lexMatch(lexentry, graph, graphlen);
 
         if (rv == 0) { /* found */
-            klex_setLexResult(&(this->lexblocks[lexpos]), lexpos, lexres);
+            klex_setLexResult(lexentry, lexpos, lexres);
             if (lexres->phonfound) {
                 /* look for more results, up to MAX_NRRES, don't even
                    check if more results would be available */
                 while ((lexres->nrres < PICOKLEX_MAX_NRRES) &&
                        (lexpos < lexposEnd)) {
-                    lexpos += this->lexblocks[lexpos];
-                    lexpos += this->lexblocks[lexpos];
-                    /* if there are no more entries in this block, advance
-                       to next block by skipping all zeros */
-                    while ((this->lexblocks[lexpos] == 0) &&
-                           (lexpos < lexposEnd)) {
-                        lexpos++;
-                    }
+                    lexpos = klex_nextLexpos(this, lexpos, lexposEnd);
                     if (lexpos < lexposEnd) {
-                        if (klex_lexMatch(&(this->lexblocks[lexpos]), graph,
-                                          graphlen) == 0) {
-                            klex_setLexResult(&(this->lexblocks[lexpos]),
-                                              lexpos, lexres);
+                        lexentry = klex_getLexpos(this, lexpos);
+                        if ((NULL != lexentry) &&
+                            (klex_lexMatch(lexentry, graph, graphlen) == 0)) {
+                            klex_setLexResult(lexentry, lexpos, lexres);
                         } else {
                             /* no more results, quit loop */
                             lexpos = lexposEnd;
@@ -461,13 +850,7 @@ static void klex_lexblockLookup(klex_SubObj this,
             }
         } else if (rv < 0) {
             /* not found, goto next entry */
-            lexpos += this->lexblocks[lexpos];
-            lexpos += this->lexblocks[lexpos];
-            /* if there are no more entries in this block, advance
-               to next block by skipping all zeros */
-            while ((this->lexblocks[lexpos] == 0) && (lexpos < lexposEnd)) {
-                lexpos++;
-            }
+            lexpos = klex_nextLexpos(this, lexpos, lexposEnd);
         } else {
             /* rv > 0, not found, won't show up later in block */
         }
@@ -487,6 +870,8 @@ picoos_uint8 picoklex_lexLookup(const picoklex_Lex this,
     picoos_uint32 lexposStart, lexposEnd;
     picoos_uint8 i;
     picoos_uint8 tgraph[PICOKLEX_LEX_SIE_NRGRAPHS];
+    picoos_uint8 *lexentry;
+    const picoklex_lexl_result_t *cached;
     klex_SubObj klex = (klex_SubObj) this;
 
     if (NULL == klex) {
@@ -495,10 +880,39 @@ picoos_uint8 picoklex_lexLookup(const picoklex_Lex this,
         return FALSE;
     }
 
+    if ((NULL != klex->cache) && (graphlen <= PICOKLEX_CACHE_MAXGRAPHLEN)) {
+        cached = klex_cacheGet(klex->cache, graph, graphlen);
+        if (NULL != cached) {
+            picoos_mem_copy(cached, lexres, sizeof(picoklex_lexl_result_t));
+            return (lexres->nrres > 0);
+        }
+    }
+
     lexres->nrres = 0;
     lexres->posindlen = 0;
     lexres->phonfound = FALSE;
 
+    if (NULL != klex->displ) {
+        /* single probe, the lexentry found via index either matches or
+           graph is not in the lexicon */
+        lexposStart = klex_getIndexLexpos(klex, graph, graphlen);
+        lexposEnd = (picoos_uint32) klex->nrblocks * PICOKLEX_LEXBLOCK_SIZE;
+        if (lexposStart < lexposEnd) {
+            lexentry = klex_getLexpos(klex, lexposStart);
+            if ((NULL != lexentry) &&
+                (klex_lexMatch(lexentry, graph, graphlen) == 0)) {
+                klex_lexblockLookup(klex, lexposStart, lexposEnd,
+                                    graph, graphlen, lexres);
+            }
+        }
+        PICODBG_DEBUG(("index lookup done, %d found", lexres->nrres));
+        if ((NULL != klex->cache) &&
+            (graphlen <= PICOKLEX_CACHE_MAXGRAPHLEN)) {
+            klex_cachePut(klex->cache, graph, graphlen, lexres);
+        }
+        return (lexres->nrres > 0);
+    }
+
     for (i = 0; i<PICOKLEX_LEX_SIE_NRGRAPHS; i++) {
         if (i < graphlen) {
             tgraph[i] = graph[i];
@@ -527,10 +941,28 @@ picoos_uint8 picoklex_lexLookup(const picoklex_Lex this,
     klex_lexblockLookup(klex, lexposStart, lexposEnd, graph, graphlen, lexres);
     PICODBG_DEBUG(("lookup done, %d found", lexres->nrres));
 
+    if ((NULL != klex->cache) && (graphlen <= PICOKLEX_CACHE_MAXGRAPHLEN)) {
+        klex_cachePut(klex->cache, graph, graphlen, lexres);
+    }
+
     return (lexres->nrres > 0);
 }
 
 
+void picoklex_getCacheStats(const picoklex_Lex this,
+                            picoos_uint32 *hits,
+                            picoos_uint32 *misses) {
+    klex_SubObj klex = (klex_SubObj) this;
+
+    *hits = 0;
+    *misses = 0;
+    if ((NULL != klex) && (NULL != klex->cache)) {
+        *hits = klex->cache->hits;
+        *misses = klex->cache->misses;
+    }
+}
+
+
 picoos_uint8 picoklex_lexIndLookup(const picoklex_Lex this,
                                    const picoos_uint8 *ind,
                                    const picoos_uint8 indlen,
@@ -538,6 +970,7 @@ picoos_uint8 picoklex_lexIndLookup(const picoklex_Lex this,
                                    picoos_uint8 **phon,
                                    picoos_uint8 *phonlen) {
     picoos_uint32 pentry;
+    picoos_uint8 *lexentry;
     klex_SubObj klex = (klex_SubObj) this;
 
     /* check indlen */
@@ -555,10 +988,14 @@ picoos_uint8 picoklex_lexIndLookup(const picoklex_Lex this,
         return FALSE;
     }
 
-    pentry += (klex->lexblocks[pentry]);
-    *phonlen = (klex->lexblocks[pentry++]) - 2;
-    *pos = klex->lexblocks[pentry++];
-    *phon = &(klex->lexblocks[pentry]);
+    lexentry = klex_getLexpos(klex, pentry);
+    if (NULL == lexentry) {
+        return FALSE;
+    }
+    lexentry += lexentry[0];
+    *phonlen = lexentry[0] - 2;
+    *pos = lexentry[1];
+    *phon = &(lexentry[2]);
 
     PICODBG_DEBUG(("pentry: %d, phonlen: %d", pentry, *phonlen));
     return TRUE;
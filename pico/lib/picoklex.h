@@ -121,6 +121,16 @@ picoos_uint8 picoklex_lexIndLookup(const picoklex_Lex this,
                                    picoos_uint8 **phon,
                                    picoos_uint8 *phonlen);
 
+/** use the perfect hash index in 'indexkb' (see picoklex.c) for lookups
+   in lex; an index not matching lex is ignored, NULL removes the index */
+void picoklex_setIndex(picoklex_Lex this, picoknow_KnowledgeBase indexkb);
+
+/** get the statistics of the lookup cache of lex (see
+   PICOKLEX_CACHE_SIZE in picoklex.c); both are 0 if there is no cache */
+void picoklex_getCacheStats(const picoklex_Lex this,
+                            picoos_uint32 *hits,
+                            picoos_uint32 *misses);
+
 #ifdef __cplusplus
 }
 #endif
@@ -54,6 +54,7 @@ extern picoknow_KnowledgeBase picoknow_newKnowledgeBase(picoos_MemoryManager mm)
         this->id = PICOKNOW_KBID_NULL;
         this->base = NULL;
         this->size = 0;
+        this->blockReader = NULL;
         this->subObj = NULL;
         this->subDeallocate = NULL;
     }
@@ -83,6 +83,8 @@ typedef enum picoknow_kb_id {
     PICOKNOW_KBID_FST_SPHO_9   = 31,
     PICOKNOW_KBID_FST_SPHO_10   = 32,
 
+    /* optional index over LEX_MAIN */
+    PICOKNOW_KBID_LEX_MAIN_INDEX = 33,
 
     /* siggen 33 - 48 */
     PICOKNOW_KBID_DT_DUR       = 34,
@@ -109,6 +111,10 @@ typedef enum picoknow_kb_id {
     PICOKNOW_KBID_LEX_USER_1    = 57,
     PICOKNOW_KBID_LEX_USER_2    = 58,
 
+    /* optional indices over LEX_USER_1 and LEX_USER_2 */
+    PICOKNOW_KBID_LEX_USER_1_INDEX = 59,
+    PICOKNOW_KBID_LEX_USER_2_INDEX = 60,
+
     PICOKNOW_KBID_DUMMY        = 127
 
 } picoknow_kb_id_t;
@@ -146,6 +152,11 @@ typedef enum picoknow_kb_id {
     PICOKNOW_KBID_LEX_USER_2, \
 }
 
+#define PICOKNOW_KBID_ULEX_INDEX_ARRAY { \
+    PICOKNOW_KBID_LEX_USER_1_INDEX, \
+    PICOKNOW_KBID_LEX_USER_2_INDEX, \
+}
+
 #define PICOKNOW_KBID_UTPP_ARRAY { \
     PICOKNOW_KBID_TPP_USER_1, \
     PICOKNOW_KBID_TPP_USER_2, \
@@ -158,6 +169,26 @@ typedef enum picoknow_kb_id {
 #define PICOKNOW_MAX_NUM_RESOURCE_KBS 64
 
 
+/**  class   : BlockReader
+ *   shortcut : br
+ *
+ *   optional random access to kb content which is stored block compressed.
+ *   the first 'rawSize' bytes of such a kb are accessible via 'base' as usual,
+ *   the remaining bytes are split into blocks of 'blockSize' bytes that can
+ *   only be accessed via 'getBlock'. a returned block stays valid at least
+ *   until the next call of 'getBlock'; NULL is returned on failure.
+ */
+typedef struct picoknow_block_reader * picoknow_BlockReader;
+
+typedef picoos_uint8 * (* picoknow_brGetBlock) (picoknow_BlockReader this, picoos_uint32 blockNr);
+
+typedef struct picoknow_block_reader {
+    picoknow_brGetBlock getBlock;
+    picoos_uint32 rawSize;
+    picoos_uint32 blockSize;
+} picoknow_block_reader_t;
+
+
 /**  class   : KnowledgeBase
  *   shortcut : kb
  *
@@ -172,6 +203,7 @@ typedef struct picoknow_knowledge_base {
     picoknow_kb_id_t id;
     picoos_uint8 * base; /* start address */
     picoos_uint32 size; /* size */
+    picoknow_BlockReader blockReader; /* NULL unless content is block compressed */
 
     /* protected */
     picoknow_kbSubDeallocate subDeallocate;
@@ -220,6 +220,7 @@ picoos_Common picoos_newCommon(picoos_MemoryManager mm)
         this->em = NULL;
         this->mm = NULL;
         this->fileList = NULL;
+        this->clipList = NULL;
     }
     return this;
 }
@@ -1355,6 +1356,21 @@ picoos_bool picoos_FileExists(picoos_Common g, picoos_char name[])
     }
 }
 
+/* Returns the clip registered for 'name', or NULL if there is none. */
+picoos_Clip picoos_findClip(picoos_Common g, picoos_char name[])
+{
+    picoos_Clip clip;
+
+    if (NULL == g->clipList) {
+        return NULL;
+    }
+    clip = *(g->clipList);
+    while ((NULL != clip) && (picoos_strcmp(clip->name, name) != 0)) {
+        clip = clip->next;
+    }
+    return clip;
+}
+
 
 /* ******************************************************************/
 /* Array conversion operations: all procedures convert 'nrElems' values from
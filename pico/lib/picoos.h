@@ -112,6 +112,7 @@ pico_status_t picoos_string_to_int32 (picoos_char str[], picoos_int32 * res);
 typedef struct memory_manager * picoos_MemoryManager;
 typedef struct picoos_exception_manager * picoos_ExceptionManager;
 typedef struct picoos_file * picoos_File;
+typedef struct picoos_clip * picoos_Clip;
 
 
 /**  object   : Common
@@ -125,6 +126,7 @@ typedef struct picoos_common {
     picoos_ExceptionManager em;
     picoos_MemoryManager mm;
     picoos_File fileList;
+    picoos_Clip * clipList; /* clips of the system, shared with its engine; NULL if none */
 } picoos_common_t;
 
 picoos_Common picoos_newCommon(picoos_MemoryManager mm);
@@ -439,6 +441,24 @@ extern picoos_bool picoos_FlushOutput (picoos_SDFile sdFile);
 extern picoos_bool picoos_sdfCloseOut (picoos_Common g, picoos_SDFile * sdFile);
 
 
+/* *****************************************************************/
+/* Clips                                                           */
+/* *****************************************************************/
+
+/* A clip is sampled data held in memory, e.g. mapped from flash, and
+   played by name like a sampled data file. Its samples are 16 bit linear
+   at 16kHz in host byte order and are read in place. */
+typedef struct picoos_clip {
+    picoos_Clip next;
+    const picoos_int16 * samples;
+    picoos_uint32 nrSamples;
+    picoos_char name[PICO_MAX_FILE_NAME_SIZE];
+} picoos_clip_t;
+
+/* Returns the clip 'name' is registered for, or NULL if there is none. */
+extern picoos_Clip picoos_findClip(picoos_Common g, picoos_char name[]);
+
+
 /* *****************************************************************/
 /* File Headers                                                    */
 /* *****************************************************************/
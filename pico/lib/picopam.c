@@ -2731,6 +2731,12 @@ static picodata_step_result_t pam_step(register picodata_ProcessingUnit this,
                             pam->nLastAttachedItemId = pam->nCurrAttachedItem
                                     = 0;
                             pam->nAttachedItemsSize = 0;
+                            /*syllable 0 keeps its attached items when opened
+                             (see pam_create_syllable) : drop the ones of this
+                             sentence, they would be output again with the next
+                             sentence if it does not start with an SBEG item*/
+                            pam->sSyllFeats[0].phoneV[ITM] = 0;
+                            pam->sSyllFeats[0].phoneV[itm] = 0;
 
                             pam->nSyllPhoneme = 0;
                             pam->procState = PICOPAM_SCHEDULE;
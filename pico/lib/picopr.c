@@ -47,17 +47,40 @@ extern "C" {
 /* constants */
 /* *****************************************************************************/
 
-#define PR_TRACE_MEM      FALSE
-#define PR_TRACE_MAX_MEM  FALSE
 #define PR_TRACE_PATHCOST TRUE
 
 #define PR_WORK_MEM_SIZE  10000
 #define PR_DYN_MEM_SIZE   7000
 
+/* number of entries of the token match memo (power of 2), see pr_matchTokensMemo */
+#define PR_MATCH_MEMO_SIZE  256
+
 #define PR_ENABLED TRUE
 
 #define PR_MAX_NR_ITERATIONS 1000;
 
+/* max. nr of iterations of one path search, 0 for no limit; when reached, the
+   search ends as if exhausted: the best path found so far is used, or the first
+   item is passed on unchanged if there is none */
+#ifndef PICOPR_MAX_SEARCH_STEPS
+#define PICOPR_MAX_SEARCH_STEPS 0
+#endif
+
+/* beam width of the path search, 0 disables the beam; a path is not continued
+   after matching an item if its cost (see pr_getPathCost) is higher by this much
+   or more than the lowest cost of the paths matched up to that item so far */
+#ifndef PICOPR_BEAM_WIDTH
+#define PICOPR_BEAM_WIDTH 0
+#endif
+#define PR_BEAM_UNSET 0x7fffffff
+
+/* limits of the first token analysis of a production (pr_addFirstTokens): nesting
+   of productions, tokens visited and pending per production; productions exceeding
+   them are always expanded */
+#define PR_FIRST_MAX_DEPTH    16
+#define PR_FIRST_MAX_VISITS   2000
+#define PR_FIRST_MAX_PENDING  64
+
 #define SPEC_CHAR           "\\/"
 
 #define PICO_ERR_CONTEXT_NOT_FOUND            PICO_ERR_OTHER
@@ -117,6 +140,9 @@ extern "C" {
 #define PR_TSE_MASK_ALTL       (1<<PR_TSEAltL)
 #define PR_TSE_MASK_ALTR       (1<<PR_TSEAltR)
 
+#define PR_TSE_MASK_TYPES      (PR_TSE_MASK_BEGIN | PR_TSE_MASK_END | PR_TSE_MASK_SPACE | PR_TSE_MASK_DIGIT \
+                                | PR_TSE_MASK_LETTER | PR_TSE_MASK_CHAR | PR_TSE_MASK_SEQ)
+
 #define PR_FIRST_TSE_WP PR_TSEOut
 
 #define PR_SMALLER 1
@@ -179,6 +205,25 @@ typedef enum {PR_LSError, PR_LSInit, PR_LSGetToken, PR_LSGetToken2, PR_LSMatch,
 
 typedef enum {PR_MSNotMatched, PR_MSMatched, PR_MSMatchedContinue, PR_MSMatchedMulti}  pr_MatchState;
 
+/* result of matching item 'ritemid' with token 'rtok' of network 'rnetwork' during
+   the path search with generation 'rgen' */
+typedef struct pr_MatchMemo {
+    picoos_uint16 rgen;
+    picokpr_TokArrOffset rtok;
+    picoos_uint8 ritemid;
+    picoos_uint8 rnetwork;
+    picoos_int8 rstate;
+    picoos_int8 rcompare;
+} pr_MatchMemo;
+
+/* header of a block in pr_DynMem; 'size' includes the header */
+typedef struct pr_DynMemBlock {
+    picoos_uint16 size;
+    picoos_uint16 used;
+} pr_DynMemBlock;
+
+#define PR_DYN_MEM_HDR_SIZE  (((sizeof(pr_DynMemBlock) + PICOOS_ALIGN_SIZE - 1) / PICOOS_ALIGN_SIZE) * PICOOS_ALIGN_SIZE)
+
 typedef struct pr_Prod * pr_ProdList;
 typedef struct pr_Prod {
     picokpr_Preproc rNetwork;
@@ -186,6 +231,21 @@ typedef struct pr_Prod {
     pr_ProdList rNext;
 } pr_Prod;
 
+/* first tokens of a production, see pr_initFirstTokens */
+#define PR_FT_INIT      0x00    /* not analysed yet */
+#define PR_FT_BUSY      0x01    /* being analysed */
+#define PR_FT_ALL       0x02    /* may start with any token */
+#define PR_FT_EMPTY     0x04    /* may match without a token */
+#define PR_FT_NONASCII  0x08    /* may start with a string token whose first byte is not ASCII */
+
+typedef struct pr_FirstTokens {
+    picoos_uint8 rFlags;
+    picoos_uint8 rAnyTypes;    /* token types the first token may have */
+    picoos_uint8 rStrTypes;    /* token types the first token may have if the first byte
+                                  of its lowercase string is in rBytes */
+    picoos_uint8 rBytes[16];   /* first bytes below 128 */
+} pr_FirstTokens;
+
 typedef struct pr_Context * pr_ContextList;
 typedef struct pr_Context {
     picoos_uchar * rContextName;
@@ -275,6 +335,8 @@ typedef struct pr_subobj
     pr_ioItemPtr rlastInItem;
     pr_ioItemPtr routItemList;
     pr_ioItemPtr rlastOutItem;
+    pr_ioItemPtr rwordItemList; /* word commands of the path being output */
+    pr_ioItemPtr rlastWordItem;
     pr_GlobalState rgState;
     pr_Path ractpath;
     pr_Path rbestpath;
@@ -293,6 +355,7 @@ typedef struct pr_subobj
     picoos_uint16 outWritePos; /* next pos to write to outBuf */
 
     picokpr_Preproc preproc[PR_MAX_NR_PREPROC];
+    pr_FirstTokens * firstTokens[PR_MAX_NR_PREPROC];
     pr_ContextList ctxList;
     pr_ProdList prodList;
 
@@ -305,15 +368,26 @@ typedef struct pr_subobj
     picoos_uint8 pr_WorkMem[PR_WORK_MEM_SIZE];
     picoos_uint32 workMemTop;
     picoos_uint32 maxWorkMemTop;
+    pr_MatchMemo * matchMemo; /* in pr_WorkMem, below the working memory of an item */
+    picoos_uint16 matchMemoGen;
     picoos_uint8 pr_DynMem[PR_DYN_MEM_SIZE];
-    picoos_MemoryManager dynMemMM;
+    picoos_uint32 dynMemBase; /* first aligned position in pr_DynMem */
+    picoos_uint32 dynMemHead; /* next block is allocated here */
+    picoos_uint32 dynMemTail; /* oldest block not yet reclaimed */
+    picoos_uint32 dynMemWrap; /* end of the blocks above dynMemHead, 0 if not wrapped */
+    picoos_int32 dynMemLive; /* number of allocated blocks */
     picoos_int32 dynMemSize;
     picoos_int32 maxDynMemSize;
+    picoos_bool steadyState; /* set when the unit is created; no more allocations from common->mm */
 
     picoos_bool outOfMemory;
 
     picoos_bool forceOutput;
     picoos_int16 nrIterations;
+    picoos_int32 searchSteps; /* iterations of the current path search */
+#if PICOPR_BEAM_WIDTH > 0
+    picoos_int32 beamCost[PR_MAX_PATH_LEN+1]; /* lowest cost of a path up to item i */
+#endif
 
     picoos_uchar lspaces[128];
     picoos_uchar saveFile[IN_BUF_SIZE];
@@ -339,6 +413,8 @@ static void pr_getOutputItemList (picodata_ProcessingUnit this, pr_subobj_t * pr
                                   picokpr_OutItemArrOffset outitem,
                                   pr_OutItemVarPtr vars,
                                   pr_ioItemPtr * first, pr_ioItemPtr * last);
+static picoos_int32 pr_attrVal (picokpr_Preproc network, picokpr_TokArrOffset tok, pr_TokSetEleWP type);
+static picoos_bool pr_hasToken (picokpr_TokSetWP * tswp, picokpr_TokSetNP * tsnp);
 
 /* *****************************************************************************/
 
@@ -348,32 +424,114 @@ static void pr_getOutputItemList (picodata_ProcessingUnit this, pr_subobj_t * pr
 /* module internal memory managment for dynamic and working memory using memory
    partitions allocated with pr_subobj_t.
    Dynamic memory is allocated in pr_subobj_t->pr_DynMem. Dynamic memory has
-   to be deallocated again with pr_DEALLOCATE.
+   to be deallocated again with pr_DEALLOCATE. Items are released roughly in
+   the order they are allocated, so pr_DynMem is used as a ring of blocks:
+   blocks are allocated at dynMemHead, and freed blocks are reclaimed when
+   they reach dynMemTail. When the last block is freed, the whole partition
+   is reset at once.
    Working memory is allocated in pr_subobj_t->pr_WorkMem. Working memory is stack
    based and may not to be deallocated with pr_DEALLOCATE, but with pr_resetMemState
    to a state previously saved with pr_getMemState.
+   After the unit is created, no memory is allocated outside of these partitions.
 */
 
+static void pr_resetDynMem (pr_subobj_t * pr)
+{
+    pr->dynMemHead = pr->dynMemBase;
+    pr->dynMemTail = pr->dynMemBase;
+    pr->dynMemWrap = 0;
+    pr->dynMemLive = 0;
+    pr->dynMemSize = 0;
+}
+
+
+static void pr_updateDynMemSize (pr_subobj_t * pr)
+{
+    if (pr->dynMemWrap == 0) {
+        pr->dynMemSize = pr->dynMemHead - pr->dynMemTail;
+    }
+    else {
+        pr->dynMemSize = (pr->dynMemWrap - pr->dynMemTail) + (pr->dynMemHead - pr->dynMemBase);
+    }
+    if (pr->dynMemSize > pr->maxDynMemSize) {
+        pr->maxDynMemSize = pr->dynMemSize;
+    }
+}
+
+
+static void * pr_allocDynMem (pr_subobj_t * pr, unsigned int byteSize)
+{
+    pr_DynMemBlock * block;
+    picoos_uint32 pos;
+
+    byteSize = PR_DYN_MEM_HDR_SIZE + ((byteSize + PICOOS_ALIGN_SIZE - 1) / PICOOS_ALIGN_SIZE) * PICOOS_ALIGN_SIZE;
+    if (pr->dynMemWrap == 0) {
+        if ((pr->dynMemHead + byteSize) <= PR_DYN_MEM_SIZE) {
+            pos = pr->dynMemHead;
+        }
+        else if ((pr->dynMemBase + byteSize) < pr->dynMemTail) {
+            /* wrap around; the blocks between dynMemTail and dynMemWrap are still in use */
+            pr->dynMemWrap = pr->dynMemHead;
+            pos = pr->dynMemBase;
+        }
+        else {
+            return NULL;
+        }
+    }
+    else if ((pr->dynMemHead + byteSize) < pr->dynMemTail) {
+        pos = pr->dynMemHead;
+    }
+    else {
+        return NULL;
+    }
+    block = (pr_DynMemBlock *)(&(pr->pr_DynMem[pos]));
+    block->size = (picoos_uint16) byteSize;
+    block->used = TRUE;
+    pr->dynMemHead = pos + byteSize;
+    pr->dynMemLive++;
+    pr_updateDynMemSize(pr);
+    return (void *)(&(pr->pr_DynMem[pos + PR_DYN_MEM_HDR_SIZE]));
+}
+
+
+static void pr_freeDynMem (pr_subobj_t * pr, void * adr)
+{
+    pr_DynMemBlock * block;
+
+    block = (pr_DynMemBlock *)((picoos_uint8 *)adr - PR_DYN_MEM_HDR_SIZE);
+    PICODBG_ASSERT(block->used);
+    block->used = FALSE;
+    pr->dynMemLive--;
+    if (pr->dynMemLive <= 0) {
+        pr_resetDynMem(pr);
+        return;
+    }
+    /* reclaim the freed blocks at the tail; there is at least one block in use */
+    block = (pr_DynMemBlock *)(&(pr->pr_DynMem[pr->dynMemTail]));
+    while (!block->used) {
+        pr->dynMemTail += block->size;
+        if (pr->dynMemTail == pr->dynMemWrap) {
+            pr->dynMemTail = pr->dynMemBase;
+            pr->dynMemWrap = 0;
+        }
+        block = (pr_DynMemBlock *)(&(pr->pr_DynMem[pr->dynMemTail]));
+    }
+    pr_updateDynMemSize(pr);
+}
+
+
 static void pr_ALLOCATE (picodata_ProcessingUnit this, pr_MemTypes mType, void * * adr, unsigned int byteSize)
   /* allocates 'byteSize' bytes in the memery partition given by 'mType' */
 {
     pr_subobj_t * pr = (pr_subobj_t *) this->subObj;
-    picoos_int32 incrUsedBytes, prevmaxDynMemSize;
 
     if (mType == pr_WorkMem) {
         if ((pr->workMemTop + byteSize) < PR_WORK_MEM_SIZE) {
             (*adr) = (void *)(&(pr->pr_WorkMem[pr->workMemTop]));
             byteSize = ((byteSize + PICOOS_ALIGN_SIZE - 1) / PICOOS_ALIGN_SIZE) * PICOOS_ALIGN_SIZE;
             pr->workMemTop += byteSize;
-#if PR_TRACE_MEM
-            PICODBG_INFO(("pr_WorkMem: +%u, tot:%i of %i", byteSize, pr->workMemTop, PR_WORK_MEM_SIZE));
-#endif
-
             if (pr->workMemTop > pr->maxWorkMemTop) {
                 pr->maxWorkMemTop = pr->workMemTop;
-#if PR_TRACE_MAX_MEM
-                PICODBG_INFO(("new max pr_WorkMem: %i of %i", pr->workMemTop, PR_WORK_MEM_SIZE));
-#endif
             }
         }
         else {
@@ -384,21 +542,8 @@ static void pr_ALLOCATE (picodata_ProcessingUnit this, pr_MemTypes mType, void *
         }
     }
     else if (mType == pr_DynMem) {
-        (*adr) = picoos_allocate(pr->dynMemMM, byteSize);
-        if ((*adr) != NULL) {
-            prevmaxDynMemSize = pr->maxDynMemSize;
-            picoos_getMemUsage(pr->dynMemMM, 1, &pr->dynMemSize, &incrUsedBytes, &pr->maxDynMemSize);
-#if PR_TRACE_MEM
-            PICODBG_INFO(("pr_DynMem : +%i, tot:%i of %i", incrUsedBytes, pr->dynMemSize, PR_DYN_MEM_SIZE));
-#endif
-
-#if PR_TRACE_MAX_MEM
-            if (pr->maxDynMemSize > prevmaxDynMemSize) {
-                PICODBG_INFO(("new max pr_DynMem : %i of %i", pr->maxDynMemSize, PR_DYN_MEM_SIZE));
-            }
-#endif
-        }
-        else {
+        (*adr) = pr_allocDynMem(pr, byteSize);
+        if ((*adr) == NULL) {
             PICODBG_ERROR(("pr out of dynamic memory"));
             picoos_emRaiseException(this->common->em, PICO_EXC_OUT_OF_MEM, (picoos_char *)"pr out of dynamic memory", (picoos_char *)"");
             pr->outOfMemory = TRUE;
@@ -413,16 +558,14 @@ static void pr_ALLOCATE (picodata_ProcessingUnit this, pr_MemTypes mType, void *
 static void pr_DEALLOCATE (picodata_ProcessingUnit this, pr_MemTypes mType, void * * adr)
 {
     pr_subobj_t * pr = (pr_subobj_t *) this->subObj;
-    picoos_int32 incrUsedBytes;
     if (mType == pr_WorkMem) {
         PICODBG_INFO(("not possible; use pr_resetMemState instead"));
     }
     else if (mType == pr_DynMem) {
-        picoos_deallocate(pr->dynMemMM, &(*adr));
-        picoos_getMemUsage(pr->dynMemMM, 1, &pr->dynMemSize, &incrUsedBytes, &pr->maxDynMemSize);
-#if PR_TRACE_MEM
-        PICODBG_INFO(("pr_DynMem : %i, tot:%i of %i: adr: %u", incrUsedBytes, pr->dynMemSize, PR_DYN_MEM_SIZE, *adr));
-#endif
+        if ((*adr) != NULL) {
+            pr_freeDynMem(pr, (*adr));
+            (*adr) = NULL;
+        }
     }
     else {
         (*adr) = NULL;
@@ -430,6 +573,14 @@ static void pr_DEALLOCATE (picodata_ProcessingUnit this, pr_MemTypes mType, void
 }
 
 
+static void * pr_allocCommonMem (picodata_ProcessingUnit this, picoos_objsize_t byteSize)
+  /* allocates from the common memory manager; only while the unit is created */
+{
+    PICODBG_ASSERT(!((pr_subobj_t *) this->subObj)->steadyState);
+    return picoos_allocate(this->common->mm, byteSize);
+}
+
+
 static void pr_getMemState(picodata_ProcessingUnit this, pr_MemTypes mType, picoos_uint32 *lmemState)
 {
     pr_subobj_t * pr = (pr_subobj_t *) this->subObj;
@@ -442,9 +593,6 @@ static void pr_resetMemState(picodata_ProcessingUnit this, pr_MemTypes mType, pi
 {
     pr_subobj_t * pr = (pr_subobj_t *) this->subObj;
 
-#if PR_TRACE_MEM
-    PICODBG_INFO(("pr_WorkMem: -%i, tot:%i of %i", pr->workMemTop-lmemState, lmemState, PR_WORK_MEM_SIZE));
-#endif
     mType = mType;        /* avoid warning "var not used in this function"*/
     pr->workMemTop = lmemState;
 }
@@ -856,6 +1004,251 @@ static void pr_disposeProdList (register picodata_ProcessingUnit this,  pr_ProdL
 }
 
 
+/* first token index
+
+   For each production of a network, pr_initFirstTokens determines which tokens
+   a match of the production can start with: the token types, and for tokens
+   that have to equal a string, the first byte of the lowercase string. The path
+   search does not expand productions that cannot start with the next token to
+   be matched (pr_mayMatchFirstToken), as all their paths would be rejected at
+   that token. This applies to the top level productions of the context
+   (pr_getTopLevelToken) as well as to productions referenced from a path
+   (pr_getProdToken). Productions that can match without any token, and those
+   whose analysis exceeds the PR_FIRST_MAX_... limits, are always expanded. */
+
+static void pr_addFirstToken (pr_FirstTokens * ft, picokpr_Preproc network, picokpr_TokArrOffset tok,
+                              picokpr_TokSetNP npset, picokpr_TokSetWP wpset)
+{
+    picoos_uint8 types;
+    picokpr_VarStrPtr lstrp;
+    picobase_utf8char utf8char;
+    picoos_uint32 pos;
+    picoos_bool done;
+    picoos_uint8 b;
+
+    if (((PR_TSE_MASK_LEX & wpset) == PR_TSE_MASK_LEX) && ((PR_TSE_MASK_LETTER & npset) == 0)) {
+        /* multi token, never matched (pr_matchMultiToken) */
+        return;
+    }
+    types = (picoos_uint8)(npset & PR_TSE_MASK_TYPES);
+    if ((PR_TSE_MASK_STR & wpset) != 0) {
+        /* the lowercase item string starts like the lowercase token string, cf. pr_compare */
+        lstrp = picokpr_getVarStrPtr(network, pr_attrVal(network, tok, PR_TSEStr));
+        pos = 0;
+        utf8char[0] = 0;
+        picobase_get_next_utf8char(lstrp, PR_MAX_DATA_LEN, & pos, utf8char);
+        picobase_lowercase_utf8_str(utf8char, (picoos_char*)utf8char, PICOBASE_UTF8_MAXLEN+1, &done);
+        b = utf8char[0];
+        if (b < 128) {
+            ft->rBytes[b >> 3] |= (picoos_uint8)(1 << (b & 7));
+        } else {
+            ft->rFlags |= PR_FT_NONASCII;
+        }
+        ft->rStrTypes |= types & ~(PR_TSE_MASK_BEGIN | PR_TSE_MASK_END);
+        ft->rAnyTypes |= types & (PR_TSE_MASK_BEGIN | PR_TSE_MASK_END);
+    } else {
+        ft->rAnyTypes |= types;
+    }
+}
+
+
+static void pr_initProdFirstTokens (picodata_ProcessingUnit this, pr_subobj_t * pr, picoos_int32 p,
+                                    picokpr_ProdArrOffset prod, picoos_int32 depth);
+
+/* adds the tokens that paths from 'tok' on can start with to 'ft', following the
+   path search in pr_processToken; returns TRUE if such a path can reach an accepting
+   token without matching a token. Only productions add to 'depth', the tokens of
+   a production are visited with a stack of pending alternatives and next tokens. */
+static picoos_bool pr_addFirstTokens (picodata_ProcessingUnit this, pr_subobj_t * pr, pr_FirstTokens * ft,
+                                      picoos_int32 p, picokpr_TokArrOffset tok, picoos_int32 depth)
+{
+    picokpr_Preproc network;
+    picokpr_TokSetNP npset;
+    picokpr_TokSetWP wpset;
+    picokpr_TokArrOffset pending[PR_FIRST_MAX_PENDING];
+    picoos_int32 npending;
+    picoos_int32 visits;
+    pr_FirstTokens * lft;
+    picokpr_ProdArrOffset lprod;
+    picoos_int32 i;
+    picoos_bool empty;
+    picoos_bool next;
+
+    if (depth > PR_FIRST_MAX_DEPTH) {
+        ft->rFlags |= PR_FT_ALL;
+        return TRUE;
+    }
+    network = pr->preproc[p];
+    empty = FALSE;
+    visits = 0;
+    pending[0] = tok;
+    npending = 1;
+    while (npending > 0) {
+        visits++;
+        if ((visits > PR_FIRST_MAX_VISITS) || (npending > PR_FIRST_MAX_PENDING - 3)) {
+            ft->rFlags |= PR_FT_ALL;
+            return TRUE;
+        }
+        npending--;
+        tok = pending[npending];
+        npset = picokpr_getTokSetNP(network, tok);
+        wpset = picokpr_getTokSetWP(network, tok);
+        next = FALSE;
+        if ((PR_TSE_MASK_ACCEPT & npset) != 0) {
+            empty = TRUE;
+            next = TRUE;
+        } else if ((PR_TSE_MASK_PROD & wpset) != 0) {
+            if ((PR_TSE_MASK_PRODEXT & wpset) != 0) {
+                /* production of another network, not analysed */
+                ft->rFlags |= PR_FT_ALL;
+                return TRUE;
+            }
+            lprod = (picokpr_ProdArrOffset)pr_attrVal(network, tok, PR_TSEProd);
+            pr_initProdFirstTokens(this, pr, p, lprod, depth + 1);
+            lft = & pr->firstTokens[p][lprod];
+            if ((lft->rFlags & (PR_FT_ALL | PR_FT_BUSY)) != 0) {
+                ft->rFlags |= PR_FT_ALL;
+                return TRUE;
+            }
+            ft->rFlags |= lft->rFlags & PR_FT_NONASCII;
+            ft->rAnyTypes |= lft->rAnyTypes;
+            ft->rStrTypes |= lft->rStrTypes;
+            for (i = 0; i < 16; i++) {
+                ft->rBytes[i] |= lft->rBytes[i];
+            }
+            /* an empty production continues after it (pr_getProdContToken) */
+            next = ((lft->rFlags & PR_FT_EMPTY) != 0);
+        } else if (((PR_TSE_MASK_OUT & wpset) == 0) && pr_hasToken(& wpset, & npset)) {
+            pr_addFirstToken(ft, network, tok, npset, wpset);
+        } else {
+            next = TRUE;
+        }
+        if (next && ((PR_TSE_MASK_NEXT & npset) != 0)) {
+            pending[npending++] = picokpr_getTokNextOfs(network, tok);
+        }
+        /* alternatives; which one is taken depends on the comparison with the token */
+        if ((PR_TSE_MASK_ALTL & npset) != 0) {
+            pending[npending++] = picokpr_getTokAltLOfs(network, tok);
+        }
+        if ((PR_TSE_MASK_ALTR & npset) != 0) {
+            pending[npending++] = picokpr_getTokAltROfs(network, tok);
+        }
+    }
+    return empty;
+}
+
+
+static void pr_initProdFirstTokens (picodata_ProcessingUnit this, pr_subobj_t * pr, picoos_int32 p,
+                                    picokpr_ProdArrOffset prod, picoos_int32 depth)
+{
+    pr_FirstTokens * ft;
+    picokpr_TokArrOffset ltok;
+
+    ft = & pr->firstTokens[p][prod];
+    if (ft->rFlags != PR_FT_INIT) {
+        return;
+    }
+    ft->rFlags = PR_FT_BUSY;
+    ltok = picokpr_getProdATokOfs(pr->preproc[p], prod);
+    if (ltok == 0) {
+        ft->rFlags |= PR_FT_ALL;
+    } else if (pr_addFirstTokens(this, pr, ft, p, ltok, depth)) {
+        ft->rFlags |= PR_FT_EMPTY;
+    }
+    ft->rFlags &= ~PR_FT_BUSY;
+}
+
+
+static pico_Status pr_initFirstTokens (picodata_ProcessingUnit this, pr_subobj_t * pr)
+{
+    picoos_int32 p;
+    picoos_int32 i;
+    picoos_int32 n;
+
+    for (p = 0; p < PR_MAX_NR_PREPROC; p++) {
+        pr->firstTokens[p] = NULL;
+    }
+    for (p = 0; p < PR_MAX_NR_PREPROC; p++) {
+        if (pr->preproc[p] != NULL) {
+            n = picokpr_getProdArrLen(pr->preproc[p]);
+            if (n > 0) {
+                pr->firstTokens[p] = pr_allocCommonMem(this, n * sizeof(pr_FirstTokens));
+                if (pr->firstTokens[p] == NULL) {
+                    return PICO_EXC_OUT_OF_MEM;
+                }
+                picoos_mem_set(pr->firstTokens[p], 0, n * sizeof(pr_FirstTokens));
+                for (i = 0; i < n; i++) {
+                    pr_initProdFirstTokens(this, pr, p, (picokpr_ProdArrOffset)i, 1);
+                }
+            }
+        }
+    }
+    return PICO_OK;
+}
+
+
+static void pr_disposeFirstTokens (register picodata_ProcessingUnit this)
+{
+    pr_subobj_t * pr = (pr_subobj_t *) this->subObj;
+    picoos_int32 p;
+
+    for (p = 0; p < PR_MAX_NR_PREPROC; p++) {
+        if (pr->firstTokens[p] != NULL) {
+            picoos_deallocate(this->common->mm, (void *) &pr->firstTokens[p]);
+        }
+    }
+}
+
+
+/* whether production 'prod' of 'network' may match the tokens starting at pr->ritems[itemid+1] */
+static picoos_bool pr_mayMatchFirstToken (pr_subobj_t * pr, picokpr_Preproc network, picokpr_ProdArrOffset prod,
+                                          picoos_int32 itemid)
+{
+    pr_FirstTokens * ft;
+    picoos_int32 p;
+    picoos_uint8 type;
+    picoos_uint8 b;
+
+    if (itemid >= pr->rnritems) {
+        /* the token is not available yet */
+        return TRUE;
+    }
+    p = 0;
+    while ((p < PR_MAX_NR_PREPROC) && (pr->preproc[p] != network)) {
+        p++;
+    }
+    if ((p >= PR_MAX_NR_PREPROC) || (pr->firstTokens[p] == NULL)) {
+        return TRUE;
+    }
+    ft = & pr->firstTokens[p][prod];
+    if ((ft->rFlags & (PR_FT_ALL | PR_FT_EMPTY)) != 0) {
+        return TRUE;
+    }
+    switch (pr->ritems[itemid+1]->head.info1) {
+        case PICODATA_ITEMINFO1_TOKTYPE_BEGIN:  type = PR_TSE_MASK_BEGIN;  break;
+        case PICODATA_ITEMINFO1_TOKTYPE_END:    type = PR_TSE_MASK_END;    break;
+        case PICODATA_ITEMINFO1_TOKTYPE_SPACE:  type = PR_TSE_MASK_SPACE;  break;
+        case PICODATA_ITEMINFO1_TOKTYPE_DIGIT:  type = PR_TSE_MASK_DIGIT;  break;
+        case PICODATA_ITEMINFO1_TOKTYPE_LETTER: type = PR_TSE_MASK_LETTER; break;
+        case PICODATA_ITEMINFO1_TOKTYPE_SEQ:    type = PR_TSE_MASK_SEQ;    break;
+        case PICODATA_ITEMINFO1_TOKTYPE_CHAR:   type = PR_TSE_MASK_CHAR;   break;
+        default:                                type = 0;                  break;
+    }
+    if ((ft->rAnyTypes & type) != 0) {
+        return TRUE;
+    }
+    if (((ft->rStrTypes & type) == 0) || (pr->ritems[itemid+1]->strci == NULL)) {
+        return (ft->rStrTypes & type) != 0;
+    }
+    b = pr->ritems[itemid+1]->strci[0];
+    if (b < 128) {
+        return (ft->rBytes[b >> 3] & (1 << (b & 7))) != 0;
+    } else {
+        return (ft->rFlags & PR_FT_NONASCII) != 0;
+    }
+}
+
+
 static pico_Status pr_addContext (register picodata_ProcessingUnit this,  pr_subobj_t * pr, pr_ContextList * ctxList, picokpr_VarStrPtr contextNamePtr, picokpr_VarStrPtr netNamePtr, picokpr_VarStrPtr prodNamePtr)
 {
     picokpr_Preproc net;
@@ -870,7 +1263,7 @@ static pico_Status pr_addContext (register picodata_ProcessingUnit this,  pr_sub
         ctx = ctx->rNext;
     }
     if (ctx == NULL) {
-        ctx = picoos_allocate(this->common->mm, sizeof(pr_Context));
+        ctx = pr_allocCommonMem(this, sizeof(pr_Context));
         if (ctx == NULL) {
             return PICO_EXC_OUT_OF_MEM;
         }
@@ -896,7 +1289,7 @@ static pico_Status pr_addContext (register picodata_ProcessingUnit this,  pr_sub
             }
         }
         if (i < lprodarrlen) {
-            prod = picoos_allocate(this->common->mm, sizeof(pr_Prod));
+            prod = pr_allocCommonMem(this, sizeof(pr_Prod));
             if (prod == NULL) {
               return PICO_EXC_OUT_OF_MEM;
             }
@@ -1217,7 +1610,8 @@ static void pr_appendItemToOutItemList (picodata_ProcessingUnit this, pr_subobj_
                 ltype = PICODATA_ITEMINFO1_TOKTYPE_UNDEFINED;
                 lsubtype =  -(1);
             }
-            pr_newItem(this, pr_DynMem,& litem, PICODATA_ITEM_TOKEN, ln2, /*inItem*/FALSE);
+            /* allocated like an input token, for the lower case copies set below */
+            pr_newItem(this, pr_DynMem,& litem, PICODATA_ITEM_TOKEN, ln2, /*inItem*/TRUE);
             if (pr->outOfMemory) return;
             litem->head.type = PICODATA_ITEM_TOKEN;
             litem->head.info1 = item->head.info1;
@@ -1238,7 +1632,7 @@ static void pr_appendItemToOutItemList (picodata_ProcessingUnit this, pr_subobj_
 
             pr_appendItem(this, firstItem, lastItem, litem);
             if (pr->spellMode == PR_SPELL_WITH_SENTENCE_BREAK) {
-                pr_newItem(this, pr_DynMem,& litem, PICODATA_ITEM_TOKEN, 2, /*inItem*/FALSE);
+                pr_newItem(this, pr_DynMem,& litem, PICODATA_ITEM_TOKEN, 2, /*inItem*/TRUE);
                 if (pr->outOfMemory) return;
                 litem->head.type = PICODATA_ITEM_TOKEN;
                 litem->head.info1 = PICODATA_ITEMINFO1_TOKTYPE_CHAR;
@@ -1603,7 +1997,7 @@ static void pr_genCommands (picodata_ProcessingUnit this, pr_subobj_t * pr,
                             litem = litem->next;
                         }
                         pr_putItem(this, pr,& (*first),& (*last),PICODATA_ITEM_CMD, PICODATA_ITEMINFO1_CMD_PLAY,
-                            picodata_getPuTypeFromExtension(pr->tmpStr1, /*input*/TRUE),0, pr->tmpStr1);
+                            picodata_getPuTypeForPlay(this->common, pr->tmpStr1),0, pr->tmpStr1);
                         lout = TRUE;
                         break;
                     case PR_OStr:
@@ -1655,7 +2049,7 @@ static void pr_genCommands (picodata_ProcessingUnit this, pr_subobj_t * pr,
             }
             if (lout) {
                 pr_putItem(this, pr,& (*first),& (*last),PICODATA_ITEM_CMD,PICODATA_ITEMINFO1_CMD_PLAY,
-                    picodata_getPuTypeFromExtension(pr->tmpStr1, /*input*/TRUE),0,pr->tmpStr1);
+                    picodata_getPuTypeForPlay(this->common, pr->tmpStr1),0,pr->tmpStr1);
             }
             pr_putItem(this, pr,& (*first),& (*last),PICODATA_ITEM_CMD,lcmd,linfo2,0,(picoos_uchar*)"");
             break;
@@ -2030,7 +2424,12 @@ static void pr_getOutput (picodata_ProcessingUnit this, pr_subobj_t * pr,
                 pr_copyItem(this, pr_WorkMem,& (*lit),& lcopy);
                 if (pr->outOfMemory) return;
                 pr_disposeItem(this, & lit);
-                pr_appendItem(this, & (*o),& (*ol),lcopy);
+                if (pr_isCmdType(lcopy,PICODATA_ITEMINFO1_CMD_WORD)) {
+                    /* kept out of variables, output ahead of the match */
+                    pr_appendItem(this, & pr->rwordItemList,& pr->rlastWordItem,lcopy);
+                } else {
+                    pr_appendItem(this, & (*o),& (*ol),lcopy);
+                }
             }
             if (pr->rinItemList != NULL) {
                 lit = pr->rinItemList;
@@ -2143,15 +2542,26 @@ static void pr_outputPath (picodata_ProcessingUnit this, pr_subobj_t * pr)
     lf = NULL;
     ll = NULL;
     li =  -(1);
+    pr->rwordItemList = NULL;
+    pr->rlastWordItem = NULL;
     pr_getOutput(this, pr, & li,1,& lf,& ll);
     if (pr->outOfMemory) return;
+    if (pr->rwordItemList != NULL) {
+        /* tokens read as a whole are reported once, as a word starting at
+           the first of them; the others are left to the work memory */
+        pr->rwordItemList->next = lf;
+        lf = pr->rwordItemList;
+        pr->rwordItemList = NULL;
+        pr->rlastWordItem = NULL;
+    }
     lastPlayFileFound = TRUE;
     while (lf != NULL) {
         lit = lf;
         lf = lf->next;
         lit->next = NULL;
         if (pr_isCmdType(lit,PICODATA_ITEMINFO1_CMD_PLAY)) {
-            lastPlayFileFound = picoos_FileExists(this->common, (picoos_char*)lit->data);
+            lastPlayFileFound = (NULL != picoos_findClip(this->common, (picoos_char*)lit->data)) ||
+                                picoos_FileExists(this->common, (picoos_char*)lit->data);
             if (!lastPlayFileFound) {
                 PICODBG_WARN(("file '%s' not found; synthesizing enclosed text instead", lit->data));
                 picoos_emRaiseWarning(this->common->em, PICO_EXC_CANT_OPEN_FILE, (picoos_char*)"", (picoos_char*)"file '%s' not found; synthesizing enclosed text instead",lit->data);
@@ -2360,6 +2770,20 @@ static picoos_bool pr_findProduction (picodata_ProcessingUnit this, pr_subobj_t
 }
 
 
+/* index of the item following the last one matched by the path elements up to 'ln' */
+static picoos_int32 pr_getItemId (pr_subobj_t * pr, picoos_int32 ln)
+{
+    while ((ln >= 0) && (pr->ractpath.rele[ln].ritemid ==  -1)) {
+        ln = ln - 1;
+    }
+    if (ln >= 0) {
+        return pr->ractpath.rele[ln].ritemid + 1;
+    } else {
+        return 0;
+    }
+}
+
+
 static picoos_bool pr_getProdToken (picodata_ProcessingUnit this, pr_subobj_t * pr)
 {
     register struct pr_PathEle * with__0;
@@ -2382,7 +2806,8 @@ static picoos_bool pr_getProdToken (picodata_ProcessingUnit this, pr_subobj_t *
                 } else {
                     return FALSE;
                 }
-            } else {
+            } else if (pr_mayMatchFirstToken(pr, with__0->rnetwork, (picokpr_ProdArrOffset)pr_attrVal(with__0->rnetwork, with__0->rtok, PR_TSEProd),
+                                             pr_getItemId(pr, pr->ractpath.rlen - 1))) {
                 pr_initPathEle(& pr->ractpath.rele[pr->ractpath.rlen]);
                 pr->ractpath.rele[pr->ractpath.rlen].rnetwork = with__0->rnetwork;
                 pr->ractpath.rele[pr->ractpath.rlen].rtok = picokpr_getProdATokOfs(with__0->rnetwork, pr_attrVal(with__0->rnetwork, with__0->rtok,PR_TSEProd));
@@ -2391,6 +2816,9 @@ static picoos_bool pr_getProdToken (picodata_ProcessingUnit this, pr_subobj_t *
                 pr->ractpath.rele[pr->ractpath.rlen].rdepth = with__0->rdepth + 1;
                 pr->ractpath.rlen++;
                 return TRUE;
+            } else {
+                /* the production cannot start with the next token */
+                return FALSE;
             }
         }
     }
@@ -2437,6 +2865,9 @@ static picoos_bool pr_getTopLevelToken (picodata_ProcessingUnit this, pr_subobj_
     } else if (pr->prodList != NULL) {
         pr->prodList = pr->prodList->rNext;
     }
+    while ((pr->prodList != NULL) && !pr_mayMatchFirstToken(pr, pr->prodList->rNetwork, pr->prodList->rProdOfs, 0)) {
+        pr->prodList = pr->prodList->rNext;
+    }
     if ((pr->prodList != NULL) && (pr->prodList->rProdOfs != 0) && (picokpr_getProdATokOfs(pr->prodList->rNetwork, pr->prodList->rProdOfs) != 0)) {
         pr_initPathEle(& pr->ractpath.rele[pr->ractpath.rlen]);
         pr->ractpath.rele[pr->ractpath.rlen].rdepth = 1;
@@ -2456,18 +2887,9 @@ static picoos_bool pr_getTopLevelToken (picodata_ProcessingUnit this, pr_subobj_
 
 static picoos_bool pr_getToken (picodata_ProcessingUnit this, pr_subobj_t * pr)
 {
-    picoos_int32 ln;
     picoos_int32 lid;
 
-    ln = (pr->ractpath.rlen - 2);
-    while ((ln >= 0) && (pr->ractpath.rele[ln].ritemid ==  -1)) {
-        ln = ln - 1;
-    }
-    if (ln >= 0) {
-        lid = pr->ractpath.rele[ln].ritemid + 1;
-    } else {
-        lid = 0;
-    }
+    lid = pr_getItemId(pr, pr->ractpath.rlen - 2);
     if (lid < pr->rnritems) {
         pr->ractpath.rele[pr->ractpath.rlen - 1].ritemid = lid;
     } else {
@@ -2839,58 +3261,146 @@ static pr_MatchState pr_matchTokens (picodata_ProcessingUnit this, pr_subobj_t *
 }
 
 
-static void pr_calcPathCost (struct pr_Path * path)
+/* token match memo
+
+   The path search matches the same item with the same network token on many
+   paths. The results of pr_matchTokens are kept in a direct mapped table in
+   pr_WorkMem, which is invalidated by pr_resetMatchMemo at the start of each
+   search, when the items may change. */
+
+static void pr_resetMatchMemo (pr_subobj_t * pr)
+{
+    pr->matchMemoGen++;
+    if ((pr->matchMemoGen == 0) && (pr->matchMemo != NULL)) {
+        /* generation counter wrapped around */
+        picoos_mem_set(pr->matchMemo, 0, PR_MATCH_MEMO_SIZE * sizeof(pr_MatchMemo));
+        pr->matchMemoGen = 1;
+    }
+}
+
+
+static pr_MatchState pr_matchTokensMemo (picodata_ProcessingUnit this, pr_subobj_t * pr, picoos_int16 * cmpres)
+{
+    register struct pr_PathEle * with__0;
+    pr_MatchMemo * memo;
+    pr_MatchState state;
+    picoos_uint8 p;
+
+    with__0 = & pr->ractpath.rele[pr->ractpath.rlen - 1];
+    p = 0;
+    while ((p < PR_MAX_NR_PREPROC) && (pr->preproc[p] != with__0->rnetwork)) {
+        p++;
+    }
+    if ((pr->matchMemo == NULL) || (p >= PR_MAX_NR_PREPROC)) {
+        return pr_matchTokens(this, pr, cmpres);
+    }
+    memo = & pr->matchMemo[(((picoos_uint32)with__0->ritemid * 97) + with__0->rtok + ((picoos_uint32)p << 5)) & (PR_MATCH_MEMO_SIZE - 1)];
+    if ((memo->rgen == pr->matchMemoGen) && (memo->rtok == with__0->rtok)
+        && (memo->ritemid == with__0->ritemid) && (memo->rnetwork == p)) {
+        *cmpres = memo->rcompare;
+        return (pr_MatchState)memo->rstate;
+    }
+    state = pr_matchTokens(this, pr, cmpres);
+    memo->rgen = pr->matchMemoGen;
+    memo->rtok = with__0->rtok;
+    memo->ritemid = (picoos_uint8)with__0->ritemid;
+    memo->rnetwork = p;
+    memo->rstate = (picoos_int8)state;
+    memo->rcompare = (picoos_int8)(*cmpres);
+    return state;
+}
+
+
+static picoos_int32 pr_getPathCost (struct pr_Path * path)
 {
     picoos_int32 li;
+    picoos_int32 cost;
     picoos_bool lfirst;
     picokpr_TokSetWP wpset;
     picokpr_TokSetNP npset;
-#if PR_TRACE_PATHCOST
-    picoos_uchar str[1000];
-    picoos_uchar * strp;
-#endif
-
-#if PR_TRACE_PATHCOST
-    str[0] = 0;
-#endif
 
     lfirst = TRUE;
-    path->rcost = PR_COST_INIT;
+    cost = PR_COST_INIT;
     for (li = 0; li < path->rlen; li++) {
         if (li == 0) {
-            path->rcost = path->rcost + path->rele[li].rprodprefcost;
+            cost = cost + path->rele[li].rprodprefcost;
         }
         wpset = picokpr_getTokSetWP(path->rele[li].rnetwork, path->rele[li].rtok);
         npset = picokpr_getTokSetNP(path->rele[li].rnetwork, path->rele[li].rtok);
         if ((PR_TSE_MASK_COST & wpset) != 0) {
             if (((PR_TSE_MASK_LEX & wpset) == PR_TSE_MASK_LEX) && ((PR_TSE_MASK_LETTER & npset) == 0)) {
                 if (lfirst) {
-                    path->rcost = path->rcost - PR_COST + pr_attrVal(path->rele[li].rnetwork, path->rele[li].rtok, PR_TSECost);
+                    cost = cost - PR_COST + pr_attrVal(path->rele[li].rnetwork, path->rele[li].rtok, PR_TSECost);
                 } else {
-                    path->rcost = path->rcost - PR_COST;
+                    cost = cost - PR_COST;
                 }
                 lfirst = FALSE;
             } else {
-                path->rcost = path->rcost - PR_COST + pr_attrVal(path->rele[li].rnetwork, path->rele[li].rtok, PR_TSECost);
+                cost = cost - PR_COST + pr_attrVal(path->rele[li].rnetwork, path->rele[li].rtok, PR_TSECost);
                 lfirst = TRUE;
             }
         } else if (pr_hasToken(& wpset,& npset)) {
-            path->rcost = path->rcost - PR_COST;
+            cost = cost - PR_COST;
         }
+    }
+    return cost;
+}
+
+
+static void pr_calcPathCost (struct pr_Path * path)
+{
 #if PR_TRACE_PATHCOST
+    picoos_int32 li;
+    picoos_uchar str[1000];
+    picoos_uchar * strp;
+#endif
+
+    path->rcost = pr_getPathCost(path);
+#if PR_TRACE_PATHCOST
+    str[0] = 0;
+    for (li = 0; li < path->rlen; li++) {
         if ((path->rele[li].rprodname != 0)) {
             strp = picokpr_getVarStrPtr(path->rele[li].rnetwork, path->rele[li].rprodname);
             picoos_strcat(str, (picoos_char *)" ");
             picoos_strcat(str, strp);
         }
-#endif
     }
-#if PR_TRACE_PATHCOST
     PICODBG_INFO(("pp cost: %i %s", path->rcost, str));
 #endif
 }
 
 
+#if PICOPR_BEAM_WIDTH > 0
+static void pr_resetBeam (pr_subobj_t * pr)
+{
+    picoos_int32 li;
+
+    for (li = 0; li <= PR_MAX_PATH_LEN; li++) {
+        pr->beamCost[li] = PR_BEAM_UNSET;
+    }
+}
+
+
+/* whether the actual path, which has just matched an item, stays within the beam */
+static picoos_bool pr_inBeam (pr_subobj_t * pr)
+{
+    picoos_int32 id;
+    picoos_int32 cost;
+
+    id = pr->ractpath.rele[pr->ractpath.rlen - 1].ritemid;
+    if ((id < 0) || (id > PR_MAX_PATH_LEN)) {
+        return TRUE;
+    }
+    cost = pr_getPathCost(& pr->ractpath);
+    if ((pr->beamCost[id] == PR_BEAM_UNSET) || (cost < pr->beamCost[id])) {
+        pr->beamCost[id] = cost;
+        return TRUE;
+    }
+    return (cost - pr->beamCost[id]) < PICOPR_BEAM_WIDTH;
+}
+#endif
+
+
 void pr_processToken (picodata_ProcessingUnit this, pr_subobj_t * pr)
 {
     register struct pr_PathEle * with__0;
@@ -2901,6 +3411,18 @@ void pr_processToken (picodata_ProcessingUnit this, pr_subobj_t * pr)
 
     do {
         pr->rgState = PR_GSContinue;
+#if PICOPR_MAX_SEARCH_STEPS > 0
+        if (pr->searchSteps >= PICOPR_MAX_SEARCH_STEPS) {
+            /* search step budget used up: end the search as if exhausted */
+            if (pr->rbestpath.rlen == 0) {
+                pr->rgState = PR_GSNotFound;
+            } else {
+                pr->rgState = PR_GSFound;
+            }
+            break;
+        }
+        pr->searchSteps++;
+#endif
         if (pr->ractpath.rlen == 0) {
             if (pr_getTopLevelToken(this, pr, FALSE)) {
                 pr->rgState = PR_GSContinue;
@@ -2971,9 +3493,14 @@ void pr_processToken (picodata_ProcessingUnit this, pr_subobj_t * pr)
                     }
                     break;
                 case PR_LSMatch:
-                    switch (pr_matchTokens(this, pr, & with__0->rcompare)) {
+                    switch (pr_matchTokensMemo(this, pr, & with__0->rcompare)) {
                         case PR_MSMatched:
                             with__0->rlState = PR_LSGetNextToken;
+#if PICOPR_BEAM_WIDTH > 0
+                            if (!pr_inBeam(pr)) {
+                                with__0->rlState = PR_LSGetAltToken;
+                            }
+#endif
                             break;
                         case PR_MSMatchedContinue:
                             with__0->rlState = PR_LSGetAltToken;
@@ -3016,6 +3543,11 @@ void pr_process (picodata_ProcessingUnit this, pr_subobj_t * pr)
             pr->ractpath.rcost = PR_COST_INIT;
             pr->rbestpath.rlen = 0;
             pr->rbestpath.rcost = PR_COST_INIT;
+            pr_resetMatchMemo(pr);
+            pr->searchSteps = 0;
+#if PICOPR_BEAM_WIDTH > 0
+            pr_resetBeam(pr);
+#endif
             if (pr_getTopLevelToken(this, pr, TRUE)) {
                 pr->rgState = PR_GSContinue;
             } else {
@@ -3183,6 +3715,8 @@ pico_status_t prReset(register picodata_ProcessingUnit this, picoos_int32 resetM
     pr->rlastInItem = NULL;
     pr->routItemList = NULL;
     pr->rlastOutItem = NULL;
+    pr->rwordItemList = NULL;
+    pr->rlastWordItem = NULL;
     pr->ractpath.rcost = PR_COST_INIT;
     pr->ractpath.rlen = 0;
     pr->rbestpath.rcost = PR_COST_INIT;
@@ -3216,13 +3750,21 @@ pico_status_t prReset(register picodata_ProcessingUnit this, picoos_int32 resetM
         pr->workMemTop = PICOOS_ALIGN_SIZE - ((uintptr_t)pr->pr_WorkMem % PICOOS_ALIGN_SIZE);
     }
     pr->maxWorkMemTop=0;
-    pr->dynMemSize=0;
+    pr_ALLOCATE(this, pr_WorkMem, (void * *) & pr->matchMemo, PR_MATCH_MEMO_SIZE * sizeof(pr_MatchMemo));
+    if (pr->matchMemo != NULL) {
+        picoos_mem_set(pr->matchMemo, 0, PR_MATCH_MEMO_SIZE * sizeof(pr_MatchMemo));
+    }
+    pr->matchMemoGen = 0;
+    if (((uintptr_t)pr->pr_DynMem % PICOOS_ALIGN_SIZE) == 0) {
+        pr->dynMemBase = 0;
+    }
+    else {
+        pr->dynMemBase = PICOOS_ALIGN_SIZE - ((uintptr_t)pr->pr_DynMem % PICOOS_ALIGN_SIZE);
+    }
+    /* this is ok to be in 'initialize' because it is a private memory within pr;
+     * items still allocated are dropped with the rest of the state */
+    pr_resetDynMem(pr);
     pr->maxDynMemSize=0;
-    /* this is ok to be in 'initialize' because it is a private memory within pr. Creating a new mm
-     * here amounts to resetting this internal memory
-     */
-    pr->dynMemMM = picoos_newMemoryManager((void *)pr->pr_DynMem, PR_DYN_MEM_SIZE,
-            /*enableMemProt*/ FALSE);
     pr->outOfMemory = FALSE;
 
     pr->forceOutput = FALSE;
@@ -3270,10 +3812,9 @@ pico_status_t prSubObjDeallocate(register picodata_ProcessingUnit this,
     if (NULL != this) {
         pr = (pr_subobj_t *) this->subObj;
         mm = mm;        /* avoid warning "var not used in this function"*/
-        PICODBG_INFO(("max pr_WorkMem: %i of %i", pr->maxWorkMemTop, PR_WORK_MEM_SIZE));
-        PICODBG_INFO(("max pr_DynMem: %i of %i", pr->maxDynMemSize, PR_DYN_MEM_SIZE));
 
         pr_disposeContextList(this);
+        pr_disposeFirstTokens(this);
         picoos_deallocate(this->common->mm, (void *) &this->subObj);
     }
     return PICO_OK;
@@ -3298,15 +3839,12 @@ picodata_ProcessingUnit picopr_newPreprocUnit(picoos_MemoryManager mm, picoos_Co
     this->terminate = prTerminate;
     this->subDeallocate = prSubObjDeallocate;
     this->subObj = picoos_allocate(mm, sizeof(pr_subobj_t));
-#if PR_TRACE_MEM || PR_TRACE_MAX_MEM
-    PICODBG_INFO(("preproc alloc: %i", sizeof(pr_subobj_t)));
-    PICODBG_INFO(("max dyn size: %i", PR_MAX_PATH_LEN*((((PR_IOITEM_MIN_SIZE+2) + PICOOS_ALIGN_SIZE - 1) / PICOOS_ALIGN_SIZE) * PICOOS_ALIGN_SIZE + 16)));
-#endif
     if (this->subObj == NULL) {
         picoos_deallocate(mm, (void *)&this);
         return NULL;
     }
     pr = (pr_subobj_t *) this->subObj;
+    pr->steadyState = FALSE;
 
     pr->graphs = picoktab_getGraphs(this->voice->kbArray[PICOKNOW_KBID_TAB_GRAPHS]);
     pr->preproc[0] = picokpr_getPreproc(this->voice->kbArray[PICOKNOW_KBID_TPP_MAIN]);
@@ -3314,15 +3852,32 @@ picodata_ProcessingUnit picopr_newPreprocUnit(picoos_MemoryManager mm, picoos_Co
       pr->preproc[1+i] = picokpr_getPreproc(this->voice->kbArray[PICOKNOW_KBID_TPP_USER_1+i]);
     }
 
-   if (pr_createContextList(this) != PICO_OK) {
+   if ((pr_initFirstTokens(this, pr) != PICO_OK) || (pr_createContextList(this) != PICO_OK)) {
         pr_disposeContextList(this);
+        pr_disposeFirstTokens(this);
         picoos_deallocate(mm, (void *)&this);
         return NULL;
     }
     prInitialize(this, PICO_RESET_FULL);
+    pr->steadyState = TRUE;
     return this;
 }
 
+
+void picopr_getMemUsage(const picodata_ProcessingUnit this,
+                        picoos_int32 *maxDynMem, picoos_int32 *maxWorkMem)
+{
+    pr_subobj_t * pr;
+
+    *maxDynMem = 0;
+    *maxWorkMem = 0;
+    if ((NULL != this) && (NULL != this->subObj)) {
+        pr = (pr_subobj_t *) this->subObj;
+        *maxDynMem = pr->maxDynMemSize;
+        *maxWorkMem = pr->maxWorkMemTop;
+    }
+}
+
 /**
  * fill up internal buffer
  */
@@ -3509,7 +4064,10 @@ picodata_step_result_t prStep(register picodata_ProcessingUnit this,
 
                 pr_treatItem(this, pr, it);
                 if (pr->outOfMemory) return PICODATA_PU_ERROR;
-                pr_processItems(this, pr);
+                /* a word command must not end a match waiting for its next token */
+                if (!pr_isCmdType(it, PICODATA_ITEMINFO1_CMD_WORD)) {
+                    pr_processItems(this, pr);
+                }
                 pr->inBufLen = 0;
             }
             else {
@@ -3536,9 +4094,6 @@ picodata_step_result_t prStep(register picodata_ProcessingUnit this,
                 return PICODATA_PU_ERROR;
             }
         }
-#if PR_TRACE_MEM
-        PICODBG_INFO(("memory: dyn=%u, work=%u", pr->dynMemSize, pr->workMemTop));
-#endif
         if (pr->nrIterations <= 0) {
             return PICODATA_PU_BUSY;
         }
@@ -53,6 +53,13 @@ picodata_ProcessingUnit picopr_newPreprocUnit(
         picodata_CharBuffer cbOut,
         picorsrc_Voice voice);
 
+/** get the peak use in bytes of the dynamic memory (items) and of the
+   working memory (path search) partitions of the preprocessing PU
+   'this' since its last reset */
+void picopr_getMemUsage(const picodata_ProcessingUnit this,
+                        picoos_int32 *maxDynMem,
+                        picoos_int32 *maxWorkMem);
+
 #define PICOPR_OUTBUF_SIZE 256
 
 #ifdef __cplusplus
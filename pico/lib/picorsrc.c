@@ -339,6 +339,7 @@ static pico_status_t picorsrc_createKnowledgeBase(
         picoos_uint8 * data,
         picoos_uint32 size,
         picoknow_kb_id_t kbid,
+        picoknow_BlockReader blockReader,
         picoknow_KnowledgeBase * kb)
 {
     (*kb) = picoknow_newKnowledgeBase(this->common->mm);
@@ -348,6 +349,7 @@ static pico_status_t picorsrc_createKnowledgeBase(
     (*kb)->base = data;
     (*kb)->size = size;
     (*kb)->id = kbid;
+    (*kb)->blockReader = blockReader;
     switch (kbid) {
         case PICOKNOW_KBID_TPP_MAIN:
         case PICOKNOW_KBID_TPP_USER_1:
@@ -508,9 +510,9 @@ static pico_status_t picorsrc_getKbList(picorsrc_ResourceManager this,
                 /* currently we consider a kb mentioned in resource but with offset 0 (no knowledge) as
                  * different form a kb not mentioned at all. We might reconsider that later. */
                 PICODBG_DEBUG((" kb (id %i) is mentioned but empty (base:%i, size:%i)",kb->id, kb->base, kb->size));
-                status = picorsrc_createKnowledgeBase(this, NULL, size, (picoknow_kb_id_t)kbid, &kb);
+                status = picorsrc_createKnowledgeBase(this, NULL, size, (picoknow_kb_id_t)kbid, NULL, &kb);
             } else {
-                status = picorsrc_createKnowledgeBase(this, data+offset, size, (picoknow_kb_id_t)kbid, &kb);
+                status = picorsrc_createKnowledgeBase(this, data+offset, size, (picoknow_kb_id_t)kbid, NULL, &kb);
             }
             PICODBG_DEBUG(("found kb (id %i) starting at %i with size %i",kb->id, kb->base, kb->size));
             if (PICO_OK == status) {
@@ -760,7 +762,7 @@ pico_status_t picorsrc_createDefaultResource(picorsrc_ResourceManager this
         PICODBG_ERROR(("failed assigning name %s to default resource",res->name));
         status = PICO_ERR_INDEX_OUT_OF_RANGE;
     }
-    status = picorsrc_createKnowledgeBase(this, NULL, 0, (picoknow_kb_id_t)PICOKNOW_KBID_FIXED_IDS, &res->kbList);
+    status = picorsrc_createKnowledgeBase(this, NULL, 0, (picoknow_kb_id_t)PICOKNOW_KBID_FIXED_IDS, NULL, &res->kbList);
 
     if (PICO_OK == status) {
         res->next = this->resources;
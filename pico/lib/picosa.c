@@ -57,6 +57,22 @@ extern "C" {
 
 #define SA_MSGSTR_SIZE 32
 
+/* nr of G2P results cached, 0 disables the cache */
+#ifndef PICOSA_G2P_CACHE_SIZE
+#define PICOSA_G2P_CACHE_SIZE 0
+#endif
+
+/* longest graph and phone sequence (in bytes) for which G2P results
+   are cached */
+#define SA_G2P_CACHE_MAXGRAPHLEN 23
+#define SA_G2P_CACHE_MAXPHONLEN  34
+
+/* nr of hash buckets, power of 2 */
+#define SA_G2P_CACHE_NRBUCKETS 128
+
+/* end of hash chain or lru list */
+#define SA_G2P_CACHE_NIL 0xFFFF
+
 /*  subobject    : SentAnaUnit
  *  shortcut     : sa
  *  context size : one phrase, max. 30 non-PUNC items, for non-processed items
@@ -180,6 +196,35 @@ typedef struct {
 } picosa_headx_t;
 
 
+/* The phones predicted by G2P for recent words are kept in a small
+   cache, keyed by graph and POS, as saDoG2P() runs the G2P tree for
+   every grapheme of a word each time it occurs. Entries are hashed into
+   buckets and kept in least recently used order; when the cache is full
+   the least recently used entry is replaced. The cache lives as long
+   as the PU and is emptied on a full reset. */
+
+typedef struct {
+    picoos_uint16 hnext;    /* next entry in hash chain */
+    picoos_uint16 prev;     /* lru list, towards most recently used */
+    picoos_uint16 next;     /* lru list, towards least recently used */
+    picoos_uint8 graphlen;
+    picoos_uint8 pos;
+    picoos_uint8 graph[SA_G2P_CACHE_MAXGRAPHLEN];
+    picoos_uint8 plen;
+    picoos_uint8 phones[SA_G2P_CACHE_MAXPHONLEN];
+} sa_g2p_cache_entry_t;
+
+typedef struct sa_g2p_cache {
+    picoos_uint16 bucket[SA_G2P_CACHE_NRBUCKETS];
+    picoos_uint16 first;    /* most recently used */
+    picoos_uint16 last;     /* least recently used */
+    picoos_uint16 nrused;
+    picoos_uint32 hits;
+    picoos_uint32 misses;
+    sa_g2p_cache_entry_t entry[PICOSA_G2P_CACHE_SIZE > 0 ? PICOSA_G2P_CACHE_SIZE : 1];
+} sa_g2p_cache_t;
+
+
 typedef struct sa_subobj {
     picoos_uint8 procState; /* for next processing step decision */
 
@@ -189,9 +234,10 @@ typedef struct sa_subobj {
 
     picoos_uint8 tmpbuf[PICODATA_MAX_ITEMSIZE];  /* tmp. location for an item */
 
-    picosa_headx_t headx[PICOSA_MAXNR_HEADX];
+    picosa_headx_t headx[PICOSA_MAXNR_HEADX + PICODATA_MAXNR_WORDCMDS];
     picoos_uint16 headxBottom; /* bottom */
     picoos_uint16 headxLen;    /* length, 0 if empty */
+    picoos_uint16 headxWords;  /* word commands collected, not counted in the limit */
 
     picoos_uint8 cbuf1[PICOSA_MAXSIZE_CBUF];
     picoos_uint16 cbuf1BufSize; /* actually allocated size */
@@ -225,6 +271,12 @@ typedef struct sa_subobj {
 
     /* dtg2p knowledge base */
     picokdt_DtG2P dtg2p;
+    /* order of each vowel-like grapheme of the word in G2P, 0 if not a
+       vowel, see saGetWordVowels */
+    picoos_uint8 g2pVowOrd[PICOKDT_G2P_MAXWORDLEN];
+
+    /* G2P result cache, NULL if disabled */
+    sa_g2p_cache_t *g2pCache;
 
     /* lex knowledge base */
     picoklex_Lex lex;
@@ -242,6 +294,8 @@ typedef struct sa_subobj {
 } sa_subobj_t;
 
 
+static void saG2PCacheInit(sa_g2p_cache_t *cache);
+
 static pico_status_t saInitialize(register picodata_ProcessingUnit this, picoos_int32 resetMode) {
     sa_subobj_t * sa;
     picoos_uint16 i;
@@ -267,13 +321,14 @@ static pico_status_t saInitialize(register picodata_ProcessingUnit this, picoos_
 
     sa->headxBottom = 0;
     sa->headxLen = 0;
+    sa->headxWords = 0;
     sa->cbuf1BufSize = PICOSA_MAXSIZE_CBUF;
     sa->cbuf2BufSize = PICOSA_MAXSIZE_CBUF;
     sa->cbuf1Len = 0;
     sa->cbuf2Len = 0;
 
     /* init headx, cbuf1, cbuf2 */
-    for (i = 0; i < PICOSA_MAXNR_HEADX; i++){
+    for (i = 0; i < (PICOSA_MAXNR_HEADX + PICODATA_MAXNR_WORDCMDS); i++){
         sa->headx[i].head.type = 0;
         sa->headx[i].head.info1 = PICODATA_ITEMINFO1_NA;
         sa->headx[i].head.info2 = PICODATA_ITEMINFO2_NA;
@@ -399,6 +454,11 @@ static pico_status_t saInitialize(register picodata_ProcessingUnit this, picoos_
     }
     PICODBG_DEBUG(("got dtg2p"));
 
+    /* cached G2P results depend on dtg2p */
+    if (NULL != sa->g2pCache) {
+        saG2PCacheInit(sa->g2pCache);
+    }
+
     /* kb lex */
     sa->lex = picoklex_getLex(this->voice->kbArray[PICOKNOW_KBID_LEX_MAIN]);
     if (sa->lex == NULL) {
@@ -434,12 +494,31 @@ static pico_status_t saSubObjDeallocate(register picodata_ProcessingUnit this,
     if (NULL != this) {
         sa = (sa_subobj_t *) this->subObj;
         picotrns_deallocate_alt_desc_buf(mm,&sa->altDescBuf);
+        if (NULL != sa->g2pCache) {
+            picoos_deallocate(mm, (void *) &sa->g2pCache);
+        }
         picoos_deallocate(mm, (void *) &this->subObj);
     }
     return PICO_OK;
 }
 
 
+void picosa_getG2PCacheStats(const picodata_ProcessingUnit this,
+                             picoos_uint32 *hits, picoos_uint32 *misses) {
+    sa_subobj_t * sa;
+
+    *hits = 0;
+    *misses = 0;
+    if ((NULL != this) && (NULL != this->subObj)) {
+        sa = (sa_subobj_t *) this->subObj;
+        if (NULL != sa->g2pCache) {
+            *hits = sa->g2pCache->hits;
+            *misses = sa->g2pCache->misses;
+        }
+    }
+}
+
+
 picodata_ProcessingUnit picosa_newSentAnaUnit(picoos_MemoryManager mm,
                                               picoos_Common common,
                                               picodata_CharBuffer cbIn,
@@ -475,6 +554,12 @@ picodata_ProcessingUnit picosa_newSentAnaUnit(picoos_MemoryManager mm,
         picoos_emRaiseException(common->em,PICO_EXC_OUT_OF_MEM, NULL, NULL);
     }
 
+    sa->g2pCache = NULL;
+    if (PICOSA_G2P_CACHE_SIZE > 0) {
+        /* G2P works without the cache, so not having memory for it is
+           not an error */
+        sa->g2pCache = picoos_allocate(mm, sizeof(sa_g2p_cache_t));
+    }
 
     saInitialize(this, PICO_RESET_FULL);
     return this;
@@ -825,6 +910,167 @@ static picoos_uint8 saGetNrVowel(register picodata_ProcessingUnit this,
 }
 
 
+/* same as saGetNrVowel for all graphemes of a word at once: sets
+   sa->g2pVowOrd[i] to the order of grapheme i if vowel-like and to 0
+   otherwise, and nVow to the number of vowel-like graphemes in the word */
+static picoos_uint8 saGetWordVowels(register picodata_ProcessingUnit this,
+                                    register sa_subobj_t *sa,
+                                    const picoos_uint8 *sInChar,
+                                    const picoos_uint16 inLen,
+                                    picoos_uint8 *nVow) {
+    picoos_uint32 nCount;
+    picoos_uint16 ind;
+    picoos_uint8 cstr[PICOBASE_UTF8_MAXLEN + 1];
+
+    *nVow = 0;
+    for (nCount = 0, ind = 0; nCount < inLen; ind++) {
+        if ((ind >= PICOKDT_G2P_MAXWORDLEN) ||
+            !picobase_get_next_utf8char(sInChar, inLen, &nCount, cstr)) {
+            return FALSE;
+        }
+        if (picoktab_hasVowellikeProp(sa->tabgraphs, cstr,
+                                      PICOBASE_UTF8_MAXLEN)) {
+            (*nVow)++;
+            sa->g2pVowOrd[ind] = (*nVow);
+        } else {
+            sa->g2pVowOrd[ind] = 0;
+        }
+    }
+    return TRUE;
+}
+
+
+/* ***********************************************************************/
+/* G2P result cache */
+/* ***********************************************************************/
+
+static picoos_uint16 saG2PCacheHash(const picoos_uint8 *graph,
+                                    const picoos_uint8 graphlen,
+                                    const picoos_uint8 pos) {
+    picoos_uint32 h = 2166136261u;
+    picoos_uint8 i;
+
+    for (i = 0; i < graphlen; i++) {
+        h = (h ^ graph[i]) * 16777619u;
+    }
+    h = (h ^ pos) * 16777619u;
+    return (picoos_uint16) ((h ^ (h >> 16)) & (SA_G2P_CACHE_NRBUCKETS - 1));
+}
+
+
+static void saG2PCacheUnlinkLru(sa_g2p_cache_t *cache, picoos_uint16 e) {
+    sa_g2p_cache_entry_t *entry = &(cache->entry[e]);
+
+    if (entry->prev != SA_G2P_CACHE_NIL) {
+        cache->entry[entry->prev].next = entry->next;
+    } else {
+        cache->first = entry->next;
+    }
+    if (entry->next != SA_G2P_CACHE_NIL) {
+        cache->entry[entry->next].prev = entry->prev;
+    } else {
+        cache->last = entry->prev;
+    }
+}
+
+
+static void saG2PCachePushLru(sa_g2p_cache_t *cache, picoos_uint16 e) {
+    sa_g2p_cache_entry_t *entry = &(cache->entry[e]);
+
+    entry->prev = SA_G2P_CACHE_NIL;
+    entry->next = cache->first;
+    if (cache->first != SA_G2P_CACHE_NIL) {
+        cache->entry[cache->first].prev = e;
+    } else {
+        cache->last = e;
+    }
+    cache->first = e;
+}
+
+
+static void saG2PCacheInit(sa_g2p_cache_t *cache) {
+    picoos_uint16 i;
+
+    for (i = 0; i < SA_G2P_CACHE_NRBUCKETS; i++) {
+        cache->bucket[i] = SA_G2P_CACHE_NIL;
+    }
+    cache->first = SA_G2P_CACHE_NIL;
+    cache->last = SA_G2P_CACHE_NIL;
+    cache->nrused = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+
+/* Returns the cached entry for graph and pos, or NULL if there is none. */
+
+static const sa_g2p_cache_entry_t *saG2PCacheGet(sa_g2p_cache_t *cache,
+                                                 const picoos_uint8 *graph,
+                                                 const picoos_uint8 graphlen,
+                                                 const picoos_uint8 pos) {
+    picoos_uint16 e;
+    picoos_uint8 i;
+    sa_g2p_cache_entry_t *entry;
+
+    e = cache->bucket[saG2PCacheHash(graph, graphlen, pos)];
+    while (e != SA_G2P_CACHE_NIL) {
+        entry = &(cache->entry[e]);
+        if ((entry->graphlen == graphlen) && (entry->pos == pos)) {
+            for (i = 0; (i < graphlen) && (entry->graph[i] == graph[i]); i++) {
+                ;
+            }
+            if (i == graphlen) {
+                if (cache->first != e) {
+                    saG2PCacheUnlinkLru(cache, e);
+                    saG2PCachePushLru(cache, e);
+                }
+                cache->hits++;
+                return entry;
+            }
+        }
+        e = entry->hnext;
+    }
+    cache->misses++;
+    return NULL;
+}
+
+
+static void saG2PCachePut(sa_g2p_cache_t *cache,
+                          const picoos_uint8 *graph,
+                          const picoos_uint8 graphlen,
+                          const picoos_uint8 pos,
+                          const picoos_uint8 *phones,
+                          const picoos_uint8 plen) {
+    picoos_uint16 e, *pe, h;
+    sa_g2p_cache_entry_t *entry;
+
+    if (cache->nrused < PICOSA_G2P_CACHE_SIZE) {
+        e = cache->nrused++;
+    } else {
+        /* replace least recently used entry */
+        e = cache->last;
+        entry = &(cache->entry[e]);
+        saG2PCacheUnlinkLru(cache, e);
+        pe = &(cache->bucket[saG2PCacheHash(entry->graph, entry->graphlen,
+                                            entry->pos)]);
+        while (*pe != e) {
+            pe = &(cache->entry[*pe].hnext);
+        }
+        *pe = entry->hnext;
+    }
+    entry = &(cache->entry[e]);
+    entry->graphlen = graphlen;
+    entry->pos = pos;
+    picoos_mem_copy(graph, entry->graph, graphlen);
+    entry->plen = plen;
+    picoos_mem_copy(phones, entry->phones, plen);
+    h = saG2PCacheHash(graph, graphlen, pos);
+    entry->hnext = cache->bucket[h];
+    cache->bucket[h] = e;
+    saG2PCachePushLru(cache, e);
+}
+
+
 /* do g2p for a full word, right-to-left */
 static picoos_uint8 saDoG2P(register picodata_ProcessingUnit this,
                             register sa_subobj_t *sa,
@@ -847,6 +1093,10 @@ static picoos_uint8 saDoG2P(register picodata_ProcessingUnit this,
     picoos_uint8 ordvow;
     picokdt_classify_vecresult_t dtresv;
     picoos_uint16 i;
+    picoos_uint8 wordlevel;
+    picoos_uint16 nrgraphs;
+    picoos_uint8 nrwordvow;
+    picoos_uint8 constructed;
 
     *plen = 0;
     okay = TRUE;
@@ -883,29 +1133,49 @@ static picoos_uint8 saDoG2P(register picodata_ProcessingUnit this,
         return FALSE;
     }
 
+    /* decode the word and map its graph context once, if possible; the
+       grapheme by grapheme construction below is only needed for words
+       too long for that */
+    wordlevel = picokdt_dtG2PsetWord(sa->dtg2p, graph, graphlen, pos,
+                                     &nrgraphs) &&
+        saGetWordVowels(this, sa, graph, graphlen, &nrwordvow);
+
     while (nCount > 0) {
         PICODBG_TRACE(("right-to-left g2p, count: %d", nCount));
         okay = TRUE;
 
-        if (!saGetNrVowel(this, sa, graph, graphlen, nCount-1, &nrvow,
-                          &ordvow)) {
-            nrvow = 0;
-            ordvow = 0;
-        }
-
         /* prepare input vector, set inside tree object invec,
          * g2pBuildVector will call the constructInVec tree method */
-        if (!picokdt_dtG2PconstructInVec(sa->dtg2p,
-                                         graph, /*grapheme start*/
-                                         graphlen, /*grapheme length*/
-                                         nCount-1, /*grapheme current position*/
-                                         pos, /*Word POS*/
-                                         nrvow, /*nr vowels if vowel, 0 else */
-                                         ordvow, /*ord of vowel if vowel, 0 el*/
-                                         &nPrimary,  /*primary stress flag*/
-                                         outNp1Ch, /*Right phoneme context +1*/
-                                         outNp2Ch, /*Right phoneme context +2*/
-                                         outNp3Ch)) { /*Right phon context +3*/
+        if (wordlevel) {
+            /* graphemes are visited in the same order, nrgraphs-1 to 0 */
+            nrgraphs--;
+            ordvow = sa->g2pVowOrd[nrgraphs];
+            nrvow = (ordvow > 0) ? nrwordvow : 0;
+            constructed =
+                picokdt_dtG2PconstructWordInVec(sa->dtg2p, nrgraphs,
+                                                nrvow, ordvow, &nPrimary,
+                                                outNp1Ch, outNp2Ch, outNp3Ch);
+        } else {
+            if (!saGetNrVowel(this, sa, graph, graphlen, nCount-1, &nrvow,
+                              &ordvow)) {
+                nrvow = 0;
+                ordvow = 0;
+            }
+            constructed =
+                picokdt_dtG2PconstructInVec(sa->dtg2p,
+                                            graph, /*grapheme start*/
+                                            graphlen, /*grapheme length*/
+                                            nCount-1, /*grapheme current position*/
+                                            pos, /*Word POS*/
+                                            nrvow, /*nr vowels if vowel, 0 else */
+                                            ordvow, /*ord of vowel if vowel, 0 el*/
+                                            &nPrimary,  /*primary stress flag*/
+                                            outNp1Ch, /*Right phoneme context +1*/
+                                            outNp2Ch, /*Right phoneme context +2*/
+                                            outNp3Ch); /*Right phon context +3*/
+        }
+
+        if (!constructed) {
             /*Errors in preparing the input vector : skip processing*/
             PICODBG_WARN(("problem with invec"));
             picoos_emRaiseWarning(this->common->em, PICO_WARN_INVECTOR,
@@ -1006,13 +1276,38 @@ static pico_status_t saGraphemeToPhoneme(register picodata_ProcessingUnit this,
                                          register sa_subobj_t *sa,
                                          picoos_uint16 ind) {
     picoos_uint16 plen;
+    picoos_uint8 *graph = &(sa->cbuf1[sa->headx[ind].cind]);
+    picoos_uint8 graphlen = sa->headx[ind].head.len;
+    picoos_uint8 pos = sa->headx[ind].head.info1;
+    picoos_uint8 *phones = &(sa->cbuf2[sa->cbuf2Len]);
+    picoos_uint16 phonesmaxlen = sa->cbuf2BufSize - sa->cbuf2Len;
+    picoos_uint8 cacheable;
+    picoos_uint8 found;
+    const sa_g2p_cache_entry_t *cached = NULL;
 
     PICODBG_TRACE(("starting g2p"));
 
-    if (saDoG2P(this, sa, &(sa->cbuf1[sa->headx[ind].cind]),
-                sa->headx[ind].head.len, sa->headx[ind].head.info1,
-                &(sa->cbuf2[sa->cbuf2Len]), (sa->cbuf2BufSize - sa->cbuf2Len),
-                &plen)) {
+    cacheable = (NULL != sa->g2pCache) &&
+        (graphlen <= SA_G2P_CACHE_MAXGRAPHLEN);
+    if (cacheable) {
+        cached = saG2PCacheGet(sa->g2pCache, graph, graphlen, pos);
+    }
+    if ((NULL != cached) && (cached->plen <= phonesmaxlen)) {
+        picoos_mem_copy(cached->phones, phones, cached->plen);
+        plen = cached->plen;
+        found = TRUE;
+    } else {
+        found = saDoG2P(this, sa, graph, graphlen, pos, phones,
+                        phonesmaxlen, &plen);
+        /* results truncated for lack of space are not cached */
+        if (found && cacheable && (NULL == cached) &&
+            (plen <= SA_G2P_CACHE_MAXPHONLEN) && (plen < phonesmaxlen)) {
+            saG2PCachePut(sa->g2pCache, graph, graphlen, pos, phones,
+                          (picoos_uint8) plen);
+        }
+    }
+
+    if (found) {
 
         /* check of cbuf2Len done in saDoG2P, phones skipped if needed */
         if (plen > 255) {
@@ -1283,8 +1578,19 @@ static picodata_step_result_t saStep(register picodata_ProcessingUnit this,
                         sa->needsmoreitems = FALSE;
                     }
 
+                    /* word commands do not count against the item limit */
+                    if ((sa->headx[sa->headxLen].head.type ==
+                         PICODATA_ITEM_CMD) &&
+                        (sa->headx[sa->headxLen].head.info1 ==
+                         PICODATA_ITEMINFO1_CMD_WORD)) {
+                        sa->headxWords++;
+                    }
+
                     /* check/set inspaceok, keep spare slot for forcing */
-                    if ((sa->headxLen >= (PICOSA_MAXNR_HEADX - 2)) ||
+                    if (((sa->headxLen - sa->headxWords) >=
+                         (PICOSA_MAXNR_HEADX - 2)) ||
+                        (sa->headxLen >=
+                         (PICOSA_MAXNR_HEADX + PICODATA_MAXNR_WORDCMDS - 2)) ||
                         ((sa->cbuf1BufSize - sa->cbuf1Len) <
                          PICOSA_MAXITEMSIZE)) {
                         sa->inspaceok = FALSE;
@@ -1526,6 +1832,7 @@ static picodata_step_result_t saStep(register picodata_ProcessingUnit this,
                 if (0 == sa->headxLen) {
                     /* reset headx, cbuf2 */
                     sa->headxBottom = 0;
+                    sa->headxWords = 0;
                     sa->cbuf2Len = 0;
                     /* reset collect state support variables */
                     sa->inspaceok = TRUE;
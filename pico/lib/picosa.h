@@ -208,6 +208,13 @@ picodata_ProcessingUnit picosa_newSentAnaUnit(
         picodata_CharBuffer cbOut,
         picorsrc_Voice voice);
 
+/** get the statistics of the G2P result cache of the sentence analysis
+   PU 'this' (see PICOSA_G2P_CACHE_SIZE in picosa.c); both are 0 if
+   there is no cache */
+void picosa_getG2PCacheStats(const picodata_ProcessingUnit this,
+                             picoos_uint32 *hits,
+                             picoos_uint32 *misses);
+
 #ifdef __cplusplus
 }
 #endif
@@ -50,6 +50,15 @@ extern "C" {
 #define PICOSIG_PROCESS     3
 #define PICOSIG_FEED        4
 
+/* marks, word and phone commands are held back until the samples they precede
+ * are output; the samples synthesised for a FRAME_PAR item are heard this many
+ * frames later (buffering of the oldest frames plus the centre of the
+ * synthesis window, measured from voice onsets after pauses) */
+#define PICOSIG_EVENT_LAG       5
+#define PICOSIG_EVENT_BUFF_SIZE PICODATA_MAX_ITEMSIZE /* held back items */
+#define PICOSIG_MAXEVENTS       8                     /* held back items */
+#define PICOSIG_ALLEVENTS       0xFFFFFFFF /* release all items held back */
+
 /*----------------------------------------------------------
  // Internal function declarations
  //---------------------------------------------------------*/
@@ -77,7 +86,8 @@ typedef struct sig_subobj
     /*Input audio file management*/
     picoos_char sInSDFileName[255];
     picoos_SDFile sInSDFile;
-    picoos_uint32 sInSDFilePos;
+    picoos_Clip sInClip;            /* clip played instead of a file */
+    picoos_uint32 sInSDFilePos;     /* next sample of the file or clip */
     /*----------------------PU output management-----------------------------*/
     picoos_uint8 outBuf[PICOSIG_OUT_BUFF_SIZE]; /* internal output buffer */
     picoos_uint16 outBufSize;                /* actually allocated size */
@@ -87,6 +97,12 @@ typedef struct sig_subobj
     picoos_SDFile sOutSDFile;               /* output file handle */
     picoos_single fSampNorm;                /* running normalization factor */
     picoos_uint32 nNumFrame;                /* running count for frame number in output items */
+    /*----------------------mark, word and phone command management----------*/
+    picoos_uint32 nFramesIn;                /* FRAME_PAR items of current sentence */
+    picoos_uint8 eventBuf[PICOSIG_EVENT_BUFF_SIZE]; /* held back items */
+    picoos_uint16 eventLen;                 /* bytes used in eventBuf */
+    picoos_uint32 eventDue[PICOSIG_MAXEVENTS]; /* output frame each item is due at */
+    picoos_uint8 numEvents;                 /* number of held back items */
     /*---------------------- other working variables ---------------------------*/
     picoos_uint8 innerProcState; /*where to take up work at next processing step*/
     /*-----------------------Definition of the local storage for this PU--------*/
@@ -132,11 +148,15 @@ static pico_status_t sigInitialize(register picodata_ProcessingUnit this, picoos
     sig_subObj->retState = PICOSIG_COLLECT;
     sig_subObj->innerProcState = 0;
     sig_subObj->nNumFrame = 0;
+    sig_subObj->nFramesIn = 0;
+    sig_subObj->eventLen = 0;
+    sig_subObj->numEvents = 0;
 
     /*-----------------------------------------------------------------
      * MANAGE Item I/O control management
      ------------------------------------------------------------------*/
     sig_subObj->sInSDFile = NULL;
+    sig_subObj->sInClip = NULL;
     sig_subObj->sInSDFilePos = 0;
     sig_subObj->sInSDFileName[0] = '\0';
     sig_subObj->outSwitch = 0; /*PU sends output to buffer (nextPU)*/
@@ -711,6 +731,103 @@ static pico_status_t sig_is_command(const picoos_uint8 *item)
     return FALSE;
 } /*sig_is_command*/
 
+/**
+ * moves held back marks, word and phone commands that are due to the PU
+ * output buffer
+ * @param    sig_subObj : sig sub-object
+ * @param    nFrames : number of output frames; items due at or before are moved
+ * @remarks the output buffer must have room for PICOSIG_EVENT_BUFF_SIZE bytes
+ * @callgraph
+ * @callergraph
+ */
+static void sig_release_events(sig_subobj_t *sig_subObj, picoos_uint32 nFrames)
+{
+    picoos_uint16 pos, len, i;
+    picoos_uint8 n;
+
+    pos = 0;
+    n = 0;
+    while ((n < sig_subObj->numEvents) && (sig_subObj->eventDue[n] <= nFrames)) {
+        len = PICODATA_ITEM_HEADSIZE
+                + sig_subObj->eventBuf[pos + PICODATA_ITEMIND_LEN];
+        picoos_mem_copy((void *) &(sig_subObj->eventBuf[pos]),
+                (void *) &(sig_subObj->outBuf[sig_subObj->outWritePos]), len);
+        sig_subObj->outWritePos += len;
+        pos += len;
+        n++;
+    }
+    if (n > 0) {
+        /* shift the items still held back to the front */
+        for (i = pos; i < sig_subObj->eventLen; i++) {
+            sig_subObj->eventBuf[i - pos] = sig_subObj->eventBuf[i];
+        }
+        for (i = n; i < sig_subObj->numEvents; i++) {
+            sig_subObj->eventDue[i - n] = sig_subObj->eventDue[i];
+        }
+        sig_subObj->eventLen -= pos;
+        sig_subObj->numEvents -= n;
+    }
+} /*sig_release_events*/
+
+/**
+ * tells whether an item is a mark, word or phone command, to be held back
+ * until the samples before it are output
+ * @param    item : pointer to current item head
+ * @return  TRUE : item is a mark, word or phone command
+ * @return  FALSE : item is none of these
+ * @remarks item pointed to by *item should be already valid
+ * @callgraph
+ * @callergraph
+ */
+static picoos_bool sig_is_event(const picoos_uint8 *item)
+{
+    return (item[0] == PICODATA_ITEM_CMD)
+            && ((item[1] == PICODATA_ITEMINFO1_CMD_MARKER)
+                    || (item[1] == PICODATA_ITEMINFO1_CMD_WORD)
+                    || (item[1] == PICODATA_ITEMINFO1_CMD_PHONE));
+} /*sig_is_event*/
+
+/**
+ * holds back a mark, word or phone command until the samples before it are
+ * output
+ * @param    sig_subObj : sig sub-object
+ * @param    item : pointer to the item
+ * @param    len : item length, including its head
+ * @remarks if there is no room left, the items held back so far are moved to
+ *          the PU output buffer early
+ * @callgraph
+ * @callergraph
+ */
+static void sig_hold_event(sig_subobj_t *sig_subObj, const picoos_uint8 *item,
+        picoos_uint16 len)
+{
+    picoos_uint8 *held;
+    picoos_uint32 n;
+    picoos_uint8 i;
+
+    if ((sig_subObj->numEvents >= PICOSIG_MAXEVENTS)
+            || (sig_subObj->eventLen + len > PICOSIG_EVENT_BUFF_SIZE)) {
+        sig_release_events(sig_subObj, PICOSIG_ALLEVENTS);
+    }
+    held = &(sig_subObj->eventBuf[sig_subObj->eventLen]);
+    picoos_mem_copy((void *) item, (void *) held, len);
+    if ((held[PICODATA_ITEMIND_INFO1] == PICODATA_ITEMINFO1_CMD_PHONE)
+            && (held[PICODATA_ITEMIND_LEN] == 4)) {
+        /* phone duration from frames to samples */
+        n = 0;
+        for (i = 0; i < 4; i++) {
+            n |= (picoos_uint32) held[PICODATA_ITEM_HEADSIZE + i] << (8 * i);
+        }
+        n *= sig_subObj->sig_inner.hop_p;
+        for (i = 0; i < 4; i++) {
+            held[PICODATA_ITEM_HEADSIZE + i] = (picoos_uint8) (n >> (8 * i));
+        }
+    }
+    sig_subObj->eventLen += len;
+    sig_subObj->eventDue[sig_subObj->numEvents++]
+            = sig_subObj->nFramesIn + PICOSIG_EVENT_LAG;
+} /*sig_hold_event*/
+
 /**
  * performs a step of the sig processing
  * @param    this : pointer to current PU (Control Unit)
@@ -740,6 +857,7 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
     picoos_uint16 n_value;
     picoos_uint32 n_pos;
     /*wav file play volume control*/
+    const picoos_int16 *s_src;
     picoos_int16 *s_t1;
     picoos_int32 sf_data, sf_mlt;
     picoos_uint32 sf;
@@ -817,6 +935,7 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
                                 &(sig_subObj->inBuf[sig_subObj->inReadPos])))
                         {
                             /*no commands, item to deal with : switch to process state*/
+                            sig_subObj->nFramesIn++;
                             sig_subObj->procState = PICOSIG_PROCESS;
                             sig_subObj->retState = PICOSIG_COLLECT;
                             return PICODATA_PU_BUSY; /*data still to process or to feed*/
@@ -825,9 +944,27 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
 
                             /*we need to manage this item as a SIG command-item*/
 
+                            if ((sig_subObj->numEvents > 0)
+                                    && (sig_subObj->inBuf[sig_subObj->inReadPos + 1]
+                                            == PICODATA_ITEMINFO1_CMD_PLAY)) {
+                                /*marks before a played file precede its samples:
+                                 * output them and come back to the command*/
+                                sig_release_events(sig_subObj, PICOSIG_ALLEVENTS);
+                                sig_subObj->procState = PICOSIG_FEED;
+                                sig_subObj->retState = PICOSIG_SCHEDULE;
+                                return PICODATA_PU_BUSY;
+                            }
+
                             switch (sig_subObj->inBuf[sig_subObj->inReadPos + 1]) {
 
                                 case PICODATA_ITEMINFO1_CMD_PLAY:
+                                    /*get temp file name*/
+                                    picoos_strlcpy(
+                                            (picoos_char*) s_temp_file_name,
+                                            (picoos_char*) &(sig_subObj->inBuf[sig_subObj->inReadPos
+                                                    + 4]),
+                                            sig_subObj->inBuf[sig_subObj->inReadPos
+                                                    + 3] + 1);
                                     /*CMD recognized : consume the command */
                                     sig_subObj->inReadPos += numinb;
                                     if (sig_subObj->inReadPos
@@ -840,17 +977,20 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
                                        sig_subObj->retState = PICOSIG_COLLECT;
 
                                     /*--------- wav file play management --------------*/
-                                    if (sig_subObj->sInSDFile != NULL) {
+                                    if ((sig_subObj->sInSDFile != NULL)
+                                            || (sig_subObj->sInClip != NULL)) {
                                         /*input wav file is already open : return*/
                                         return PICODATA_PU_BUSY;
                                     }
-                                    /*get temp file name*/
-                                    picoos_strlcpy(
-                                            (picoos_char*) s_temp_file_name,
-                                            (picoos_char*) &(sig_subObj->inBuf[sig_subObj->inReadPos
-                                                    + 4]),
-                                            sig_subObj->inBuf[sig_subObj->inReadPos
-                                                    + 3] + 1);
+                                    /*a clip is played from memory*/
+                                    sig_subObj->sInClip = picoos_findClip(
+                                            this->common, s_temp_file_name);
+                                    if (sig_subObj->sInClip != NULL) {
+                                        sig_subObj->sInSDFilePos = 0;
+                                        sig_subObj->procState =
+                                            sig_subObj->retState = PICOSIG_PLAY;
+                                        return PICODATA_PU_BUSY;
+                                    }
                                     /*avoid input/output file name clashes*/
                                     if (sig_subObj->sOutSDFile != NULL) {
                                         if (picoos_strncmp(
@@ -878,8 +1018,7 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
                                     picoos_strlcpy(
                                             (picoos_char*) sig_subObj->sInSDFileName,
                                             (picoos_char*) s_temp_file_name,
-                                            sig_subObj->inBuf[sig_subObj->inReadPos
-                                                    + 3] + 1);
+                                            sizeof(sig_subObj->sInSDFileName));
                                     sig_subObj->sInSDFilePos = 0;
                                     /*switch to state PLAY and return*/
                                     sig_subObj->procState =
@@ -888,6 +1027,13 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
                                     break;
 
                                 case PICODATA_ITEMINFO1_CMD_SAVE:
+                                    /*get temp file name*/
+                                    picoos_strlcpy(
+                                            (picoos_char*) s_temp_file_name,
+                                            (picoos_char*) &(sig_subObj->inBuf[sig_subObj->inReadPos
+                                                    + 4]),
+                                            sig_subObj->inBuf[sig_subObj->inReadPos
+                                                    + 3] + 1);
                                     /*CMD recognized : consume the command */
                                     sig_subObj->inReadPos += numinb;
                                     if (sig_subObj->inReadPos
@@ -904,13 +1050,6 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
                                         /*output sig file is already active : return*/
                                         return PICODATA_PU_BUSY;
                                     }
-                                    /*get temp file name*/
-                                    picoos_strlcpy(
-                                            (picoos_char*) s_temp_file_name,
-                                            (picoos_char*) &(sig_subObj->inBuf[sig_subObj->inReadPos
-                                                    + 4]),
-                                            sig_subObj->inBuf[sig_subObj->inReadPos
-                                                    + 3] + 1);
                                     /*check extension*/
                                     if (picoos_has_extension(s_temp_file_name,
                                             PICODATA_PUTYPE_WAV_OUTPUT_EXTENSION)
@@ -947,7 +1086,7 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
                                         picoos_strlcpy(
                                                 (picoos_char*) sig_subObj->sOutSDFileName,
                                                 (picoos_char*) s_temp_file_name,
-                                                sig_subObj->inBuf[sig_subObj->inReadPos + 3] + 1);
+                                                sizeof(sig_subObj->sOutSDFileName));
                                     }
                                     return PICODATA_PU_BUSY;
                                     break;
@@ -1046,6 +1185,25 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
 
                         /*we DO NOT have to deal with this item on this PU.
                          * Normally these are still alive boundary or flush items*/
+                        if (sig_is_event(&(sig_subObj->inBuf[sig_subObj->inReadPos]))) {
+                            /*hold the mark, word or phone command back until the
+                             * samples synthesised so far are output*/
+                            sig_hold_event(sig_subObj,
+                                    &(sig_subObj->inBuf[sig_subObj->inReadPos]),
+                                    numinb);
+                            sig_subObj->inReadPos += numinb;
+                            if (sig_subObj->inReadPos >= sig_subObj->inWritePos) {
+                                sig_subObj->inReadPos = 0;
+                                sig_subObj->inWritePos = 0;
+                            }
+                            sig_subObj->procState = (sig_subObj->outWritePos > 0)
+                                    ? PICOSIG_FEED : PICOSIG_COLLECT;
+                            sig_subObj->retState = PICOSIG_COLLECT;
+                            return PICODATA_PU_BUSY;
+                        }
+                        /*items held back go before any other item, e.g. the
+                         * sentence end, following the last frames*/
+                        sig_release_events(sig_subObj, PICOSIG_ALLEVENTS);
                         /*copy item from PU input to PU output buffer,
                          * i.e. make it ready to FEED*/
                         s_result = picodata_copy_item(
@@ -1073,6 +1231,7 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
                             PICODBG_INFO(("End of sentence - Processed frames : %d",
                                             sig_subObj->nNumFrame));
                             sig_subObj->nNumFrame = 0;
+                            sig_subObj->nFramesIn = 0;
                         }
 
                         /*item processed and put in oputput buffer : consume the item*/
@@ -1112,6 +1271,8 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
                         sig_subObj->needMoreInput = FALSE;
                     }
                     sig_subObj->outWritePos += numoutb;
+                    /*items due once these samples are output follow them*/
+                    sig_release_events(sig_subObj, sig_subObj->nFramesIn);
                     sig_subObj->procState = PICOSIG_FEED;
                     sig_subObj->retState = PICOSIG_COLLECT;
                     PICODBG_DEBUG(("picosig.sigStep -- leaving PICO_PROC, inReadPos = %i, outWritePos = %i",sig_subObj->inReadPos, sig_subObj->outWritePos));
@@ -1125,17 +1286,31 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
                 /*management of wav file play*/
                 s_data = (picoos_int16 *) &(sig_subObj->outBuf[sig_subObj->outWritePos + 4]);
                 hop_p_half = sig_subObj->sig_inner.hop_p / 2;
-                /*read directly into PU output buffer*/
                 n_samp = hop_p_half;
-                b_res = picoos_sdfGetSamples(sig_subObj->sInSDFile,
-                        sig_subObj->sInSDFilePos, &n_samp, s_data);
+                if (sig_subObj->sInClip != NULL) {
+                    /*clip samples are read in place*/
+                    s_src = &(sig_subObj->sInClip->samples[sig_subObj->sInSDFilePos]);
+                    if (n_samp > sig_subObj->sInClip->nrSamples - sig_subObj->sInSDFilePos) {
+                        n_samp = sig_subObj->sInClip->nrSamples - sig_subObj->sInSDFilePos;
+                    }
+                    b_res = TRUE;
+                } else {
+                    /*read directly into PU output buffer*/
+                    s_src = s_data;
+                    b_res = picoos_sdfGetSamples(sig_subObj->sInSDFile,
+                            sig_subObj->sInSDFilePos, &n_samp, s_data);
+                }
                 sig_subObj->sInSDFilePos += n_samp;
 
                 if ((FALSE == b_res) || (0 == n_samp)) {
                     /*file play is complete or file read error*/
-                    picoos_sdfCloseIn(this->common, &(sig_subObj->sInSDFile));
-                    sig_subObj->sInSDFile = NULL;
-                    sig_subObj->sInSDFileName[0] = '\0';
+                    if (sig_subObj->sInClip != NULL) {
+                        sig_subObj->sInClip = NULL;
+                    } else {
+                        picoos_sdfCloseIn(this->common, &(sig_subObj->sInSDFile));
+                        sig_subObj->sInSDFile = NULL;
+                        sig_subObj->sInSDFileName[0] = '\0';
+                    }
                     sig_subObj->procState = PICOSIG_COLLECT;
                     sig_subObj->retState = PICOSIG_COLLECT;
                     return PICODATA_PU_BUSY; /*check if data in input buffer*/
@@ -1150,8 +1325,8 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
                 s_t1 = &(s_data[0]);
 
                 for (n_i = 0; n_i < n_samp; n_i++) {
-                    if (*s_t1 != 0) {
-                        sf_data = (picoos_int32) (*s_t1) * sf_mlt;
+                    if (*s_src != 0) {
+                        sf_data = (picoos_int32) (*s_src) * sf_mlt;
                         sf_data >>= 4;
                         if (sf_data > PICOSIG_MAXAMP) {
                             sf_data = PICOSIG_MAXAMP;
@@ -1159,7 +1334,10 @@ static picodata_step_result_t sigStep(register picodata_ProcessingUnit this,
                             sf_data = PICOSIG_MINAMP;
                         }
                         *s_t1 = (picoos_int16) (sf_data);
+                    } else {
+                        *s_t1 = 0;
                     }
+                    s_src++;
                     s_t1++;
                 }
                 /*Add header info*/
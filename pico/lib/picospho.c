@@ -175,7 +175,7 @@ typedef struct spho_subobj {
     /* buffer for item headers */
     picoos_uint8 tmpbuf[PICODATA_MAX_ITEMSIZE]; /* tmp. location for an item */
 
-    picospho_headx_t headx[SPHO_MAXNR_HEADX]; /* "expanded head" buffer */
+    picospho_headx_t headx[SPHO_MAXNR_HEADX + PICODATA_MAXNR_WORDCMDS]; /* "expanded head" buffer */
     picoos_uint16 headxBufSize; /* actually allocated size (if one day headxBuf is allocated dynamically) */
     picoos_uint16 headxReadPos, headxWritePos;
 
@@ -265,7 +265,7 @@ static pico_status_t sphoReset(register picodata_ProcessingUnit this)
 
 
     /* item buffer headx/cbuf */
-    spho->headxBufSize = SPHO_MAXNR_HEADX;
+    spho->headxBufSize = SPHO_MAXNR_HEADX + PICODATA_MAXNR_WORDCMDS;
     spho->headxReadPos = 0;
     spho->headxWritePos = 0;
 
@@ -402,6 +402,22 @@ picodata_ProcessingUnit picospho_newSentPhoUnit(picoos_MemoryManager mm,
 /* ***********************************************************************/
 
 
+/* number of items in headx that count against SPHO_MAXNR_HEADX, i.e. all
+ * but word commands */
+static picoos_uint16 sphoNrCountedItems(spho_subobj_t *spho)
+{
+    picoos_uint16 i, nr;
+
+    nr = spho->headxWritePos;
+    for (i = 0; i < spho->headxWritePos; i++) {
+        if ((PICODATA_ITEM_CMD == spho->headx[i].head.type)
+                && (PICODATA_ITEMINFO1_CMD_WORD == spho->headx[i].head.info1)) {
+            nr--;
+        }
+    }
+    return nr;
+}
+
 /* shift relevant data in headx/'cbuf' (between 'readPos' incl and writePos non-incl) to 'start'.
  * modify read/writePos accordingly */
 static picoos_int16 shift_range_left_1(spho_subobj_t *spho, picoos_int16 * from, picoos_int16 to)
@@ -988,10 +1004,11 @@ static picodata_step_result_t sphoStep(register picodata_ProcessingUnit this,
                  */
                 PICODBG_TRACE(("COLLECT"));
                 rv = PICO_OK;
-                remHeadxSize = spho->headxBufSize - spho->headxWritePos;
+                remHeadxSize = SPHO_MAXNR_HEADX - sphoNrCountedItems(spho);
                 remCbufSize = spho->cbufBufSize - spho->cbufWritePos;
                 curPos = spho->headxWritePos;
-                while ((PICO_OK == rv) && (remHeadxSize > 0) && (remCbufSize > 0)) {
+                while ((PICO_OK == rv) && (remHeadxSize > 0) && (remCbufSize > 0)
+                        && (spho->headxWritePos < spho->headxBufSize)) {
                     PICODBG_DEBUG(("COLLECT getting item at headxWritePos %i (remaining %i)",spho->headxWritePos, remHeadxSize));
                     rv = picodata_cbGetItem(this->cbIn, spho->tmpbuf, PICODATA_MAX_ITEMSIZE, &blen);
                     if (PICO_OK == rv) {
@@ -1001,14 +1018,18 @@ static picodata_step_result_t sphoStep(register picodata_ProcessingUnit this,
                         if (PICO_OK == rv) {
                             spho->headx[spho->headxWritePos].cind = spho->cbufWritePos;
                             spho->headx[spho->headxWritePos].boundstrength = 0;
+                            if ((PICODATA_ITEM_CMD != spho->headx[spho->headxWritePos].head.type)
+                                    || (PICODATA_ITEMINFO1_CMD_WORD != spho->headx[spho->headxWritePos].head.info1)) {
+                                remHeadxSize--;
+                            }
                             spho->headxWritePos++;
-                            remHeadxSize--;
                             spho->cbufWritePos += blen;
                             remCbufSize -= blen;
                         }
                     }
                 }
-                if ((PICO_OK == rv) && ((remHeadxSize <= 0) || (remCbufSize <= 0))) {
+                if ((PICO_OK == rv) && ((remHeadxSize <= 0) || (remCbufSize <= 0)
+                        || (spho->headxWritePos >= spho->headxBufSize))) {
                     rv = PICO_EXC_BUF_OVERFLOW;
                 }
 
@@ -78,7 +78,11 @@ extern "C" {
 /* *****************************************************************************/
 
 #define IN_BUF_SIZE   255
+#if PICODATA_WORD_EVENTS
+#define OUT_BUF_SIZE  IN_BUF_SIZE + 4 * PICODATA_ITEM_HEADSIZE + 7
+#else
 #define OUT_BUF_SIZE  IN_BUF_SIZE + 3 * PICODATA_ITEM_HEADSIZE + 3
+#endif
 
 #define MARKUP_STRING_BUF_SIZE (IN_BUF_SIZE*5)
 #define MAX_NR_MARKUP_PARAMS 6
@@ -238,6 +242,12 @@ typedef struct tok_subobj
     picoos_int32 tokenPos;
     picoos_uchar tokenStr[IN_BUF_SIZE];
 
+#if PICODATA_WORD_EVENTS
+    picoos_uint32 nrBytesIn;  /* input bytes read since reset */
+    picoos_uint32 charOfs;    /* offset of the current input character */
+    picoos_uint32 tokenOfs;   /* offset of the current token's first character */
+#endif
+
     picoos_int32 nrEOL;
 
     picoos_bool markupHandlingMode;       /* to be moved ??? */
@@ -261,7 +271,10 @@ typedef struct tok_subobj
     picokfst_FST svoxpa_parser;
     picokfst_FST xsampa2svoxpa_mapper;
 
-
+    /* token type and subtype of each ASCII character as looked up in
+       graphTab by tok_treatChar, set up on reset */
+    pico_tokenType asciiTokenType[128];
+    pico_tokenSubType asciiTokenSubType[128];
 
 } tok_subobj_t;
 
@@ -574,6 +587,24 @@ static void tok_putItem (picodata_ProcessingUnit this,  tok_subobj_t * tok,
 }
 
 
+#if PICODATA_WORD_EVENTS
+static void tok_putWordItem (tok_subobj_t * tok, picoos_uint32 ofs)
+{
+    picoos_int32 i;
+
+    if ((tok->ignLevel <= 0) && (tok->outWritePos + 4 + 4 < OUT_BUF_SIZE)) {
+        tok->outBuf[tok->outWritePos++] = PICODATA_ITEM_CMD;
+        tok->outBuf[tok->outWritePos++] = PICODATA_ITEMINFO1_CMD_WORD;
+        tok->outBuf[tok->outWritePos++] = PICODATA_ITEMINFO2_NA;
+        tok->outBuf[tok->outWritePos++] = 4;
+        for (i = 0; i < 4; i++) {
+            tok->outBuf[tok->outWritePos++] = (picoos_uint8) (ofs >> (8 * i));
+        }
+    }
+}
+#endif
+
+
 static void tok_putItem2 (picodata_ProcessingUnit this,  tok_subobj_t * tok,
                           picoos_uint8 type,
                           picoos_uint8 info1, picoos_uint8 info2,
@@ -877,14 +908,15 @@ static void tok_interpretMarkup (picodata_ProcessingUnit this, tok_subobj_t * to
             break;
         case MIPlay:
             if (isStartTag && tok_strEqual(tok->markupParams[0].paramId, KWFile)) {
-                if (picoos_FileExists(this->common, (picoos_char*)tok->markupParams[0].paramVal)) {
+                if ((NULL != picoos_findClip(this->common, (picoos_char*)tok->markupParams[0].paramVal)) ||
+                    picoos_FileExists(this->common, (picoos_char*)tok->markupParams[0].paramVal)) {
                     tok_getParamIntVal(tok->markupParams,KWF0Beg,& ival,& paramFound);
                     tok_getParamIntVal(tok->markupParams,KWF0End,& ival2,& paramFound);
                     tok_getParamStrVal(tok->markupParams,KWAlphabet,valStr3,& paramFound);
                     tok_getParamPhonesStr(tok->markupParams,KWXFadeBeg,valStr3,valStr,VAL_STR_LEN,& paramFound);
                     tok_getParamPhonesStr(tok->markupParams,KWXFadeEnd,valStr3,valStr2,VAL_STR_LEN,& paramFound);
                     tok_putItem(this, tok, PICODATA_ITEM_CMD, PICODATA_ITEMINFO1_CMD_PLAY,
-                                picodata_getPuTypeFromExtension(tok->markupParams[0].paramVal, /*input*/TRUE), 0, tok->markupParams[0].paramVal);
+                                picodata_getPuTypeForPlay(this->common, tok->markupParams[0].paramVal), 0, tok->markupParams[0].paramVal);
                     tok_startIgnore(tok);
                 } else {
                     if (tok->ignLevel > 0) {
@@ -1047,6 +1079,11 @@ static void tok_putToSimpleToken (picodata_ProcessingUnit this, tok_subobj_t * t
 {
     int i, len;
 
+#if PICODATA_WORD_EVENTS
+    if (tok->tokenPos == 0) {
+        tok->tokenOfs = tok->charOfs;
+    }
+#endif
     if (str[0] != 0) {
         len = picoos_strlen((picoos_char*)str);
         for (i = 0; i < len; i++) {
@@ -1297,13 +1334,53 @@ static void tok_treatMarkup (picodata_ProcessingUnit this, tok_subobj_t * tok)
 
 
 
-static void tok_treatChar (picodata_ProcessingUnit this, tok_subobj_t * tok, picoos_uchar ch, picoos_bool markupHandling)
+/* token type and subtype of the complete UTF8 character in tok->utf */
+static void tok_getTokenType (tok_subobj_t * tok, pico_tokenType * type, pico_tokenSubType * subtype)
 {
-    picoos_int32 i, id;
+    picoos_int32 id;
     picoos_uint8 uval8;
-    pico_tokenType type = PICODATA_ITEMINFO1_TOKTYPE_UNDEFINED;
-    pico_tokenSubType subtype = -1;
     picoos_bool dummy;
+
+    (*type) = PICODATA_ITEMINFO1_TOKTYPE_UNDEFINED;
+    (*subtype) = -1;
+    id = (NULL == tok->graphTab) ? 0 : picoktab_graphOffset(tok->graphTab, tok->utf);
+    if (id > 0) {
+        if (picoktab_getIntPropTokenType(tok->graphTab, id, &uval8)) {
+            (*type) = (pico_tokenType)uval8;
+            if ((*type) == PICODATA_ITEMINFO1_TOKTYPE_LETTERV) {
+                (*type) = PICODATA_ITEMINFO1_TOKTYPE_LETTER;
+            }
+        }
+        dummy = picoktab_getIntPropTokenSubType(tok->graphTab, id, subtype);
+    } else if (tok->utf[tok->utfpos-1] <= (picoos_uchar)' ') {
+        (*type) = PICODATA_ITEMINFO1_TOKTYPE_SPACE;
+    }
+}
+
+
+/* looks up the token types of all ASCII characters once, so that
+   tok_treatChar and tok_treatAsciiRun can do without the graph table
+   for them */
+static void tok_initAsciiTokenTypes (tok_subobj_t * tok)
+{
+    picoos_int32 ch;
+
+    for (ch = 0; ch < 128; ch++) {
+        tok->utf[0] = (picoos_uchar)ch;
+        tok->utf[1] = 0;
+        tok->utfpos = 1;
+        tok_getTokenType(tok, &tok->asciiTokenType[ch], &tok->asciiTokenSubType[ch]);
+    }
+    tok->utfpos = 0;
+    tok->utflen = 0;
+}
+
+
+static void tok_treatChar (picodata_ProcessingUnit this, tok_subobj_t * tok, picoos_uchar ch, picoos_bool markupHandling)
+{
+    picoos_int32 i;
+    pico_tokenType type;
+    pico_tokenSubType subtype;
     utf8char0c utf2;
     picoos_int32 utf2pos;
 
@@ -1321,21 +1398,11 @@ static void tok_treatChar (picodata_ProcessingUnit this, tok_subobj_t * tok, pic
             break;
         case UTF_CHAR_COMPLETE:
             markupHandling = (markupHandling && (tok->markupHandlingMode == MARKUP_HANDLING_ENABLED));
-            id = picoktab_graphOffset(tok->graphTab, tok->utf);
-            if (id > 0) {
-                if (picoktab_getIntPropTokenType(tok->graphTab, id, &uval8)) {
-                    type = (pico_tokenType)uval8;
-                    if (type == PICODATA_ITEMINFO1_TOKTYPE_LETTERV) {
-                        type = PICODATA_ITEMINFO1_TOKTYPE_LETTER;
-                    }
-                }
-                dummy = picoktab_getIntPropTokenSubType(tok->graphTab, id, &subtype);
-            } else if (tok->utf[tok->utfpos-1] <= (picoos_uchar)' ') {
-                type = PICODATA_ITEMINFO1_TOKTYPE_SPACE;
-                subtype =  -1;
+            if (tok->utf[0] < (picoos_uchar)'\200') {
+                type = tok->asciiTokenType[tok->utf[0]];
+                subtype = tok->asciiTokenSubType[tok->utf[0]];
             } else {
-                type = PICODATA_ITEMINFO1_TOKTYPE_UNDEFINED;
-                subtype =  -1;
+                tok_getTokenType(tok, &type, &subtype);
             }
             if ((tok->utf[tok->utfpos-1] > (picoos_uchar)' ')) {
                 tok->nrEOL = 0;
@@ -1378,6 +1445,59 @@ static void tok_treatChar (picodata_ProcessingUnit this, tok_subobj_t * tok, pic
 }
 
 
+/* reads the next input byte, keeping track of its offset */
+static picoos_int16 tok_getCh (picodata_ProcessingUnit this, tok_subobj_t * tok)
+{
+    picoos_int16 ch;
+
+    ch = picodata_cbGetCh(this->cbIn);
+#if PICODATA_WORD_EVENTS
+    if (ch != PICO_EOF) {
+        if (tok->utfpos == 0) {
+            tok->charOfs = tok->nrBytesIn;
+        }
+        tok->nrBytesIn++;
+    }
+#endif
+    return ch;
+}
+
+
+/**
+ * Reads input characters as long as they are ASCII characters that only
+ * extend the current letter, digit or space token, and appends them to it
+ * directly. This has the same effect as passing them to tok_treatChar one
+ * by one. The first character that does not qualify is passed to
+ * tok_treatChar; reading stops once output is pending.
+ */
+static void tok_treatAsciiRun (picodata_ProcessingUnit this, tok_subobj_t * tok)
+{
+    picoos_int16 ch;
+    picoos_uchar uch;
+
+    while ((tok->outWritePos == tok->outReadPos) &&
+           (tok->markupState == MSNotInMarkup) && (tok->utfpos == 0) &&
+           ((tok->tokenType == PICODATA_ITEMINFO1_TOKTYPE_LETTER) ||
+            (tok->tokenType == PICODATA_ITEMINFO1_TOKTYPE_DIGIT) ||
+            (tok->tokenType == PICODATA_ITEMINFO1_TOKTYPE_SPACE)) &&
+           (PICO_EOF != (ch = tok_getCh(this, tok)))) {
+        uch = (picoos_uchar) ch;
+        if ((uch < (picoos_uchar)'\200') && (uch != NULLC) && (uch != EOL) &&
+            (uch != (picoos_uchar)'<') && (tok->tokenPos < IN_BUF_SIZE) &&
+            (tok->asciiTokenType[uch] == tok->tokenType) &&
+            (tok->asciiTokenSubType[uch] == tok->tokenSubType)) {
+            if (uch > (picoos_uchar)' ') {
+                tok->nrEOL = 0;
+            }
+            tok->tokenStr[tok->tokenPos] = uch;
+            tok->tokenPos++;
+        } else {
+            tok_treatChar(this, tok, uch, /*markupHandling*/TRUE);
+        }
+    }
+}
+
+
 static void tok_treatSimpleToken (picodata_ProcessingUnit this, tok_subobj_t * tok)
 {
     if (tok->tokenPos < IN_BUF_SIZE) {
@@ -1390,6 +1510,11 @@ static void tok_treatSimpleToken (picodata_ProcessingUnit this, tok_subobj_t * t
         tok_treatMarkupAsSimpleToken(this, tok);
         tok_treatSimpleToken(this, tok);
     } else if ((tok->tokenPos > 0) && ((tok->ignLevel <= 0) || (tok->tokenType == PICODATA_ITEMINFO1_TOKTYPE_SPACE))) {
+#if PICODATA_WORD_EVENTS
+        if ((tok->tokenType != PICODATA_ITEMINFO1_TOKTYPE_SPACE) && (tok->tokenType != PICODATA_ITEMINFO1_TOKTYPE_CHAR)) {
+            tok_putWordItem(tok, tok->tokenOfs);
+        }
+#endif
         tok_putItem(this, tok, PICODATA_ITEM_TOKEN, tok->tokenType, (picoos_uint8)tok->tokenSubType, 0, tok->tokenStr);
     }
     tok->tokenPos = 0;
@@ -1432,6 +1557,11 @@ static pico_status_t tokReset(register picodata_ProcessingUnit this, picoos_int3
     tok->tokenType = PICODATA_ITEMINFO1_TOKTYPE_UNDEFINED;
     tok->tokenSubType =  -1;
     tok->tokenPos = 0;
+#if PICODATA_WORD_EVENTS
+    tok->nrBytesIn = 0;
+    tok->charOfs = 0;
+    tok->tokenOfs = 0;
+#endif
 
     tok->nrEOL = 0;
 
@@ -1458,6 +1588,8 @@ static pico_status_t tokReset(register picodata_ProcessingUnit this, picoos_int3
     tok->xsampa2svoxpa_mapper = picokfst_getFST(this->voice->kbArray[PICOKNOW_KBID_FST_XSAMPA2SVOXPA]);
     PICODBG_TRACE(("got xsampa2svoxpa_mapper @ %i",tok->xsampa2svoxpa_mapper));
 
+    tok_initAsciiTokenTypes(tok);
+
 
 
     return PICO_OK;
@@ -1560,9 +1692,10 @@ picodata_step_result_t tokStep(register picodata_ProcessingUnit this,
             }
 
         }
-        else if (PICO_EOF != (ch = picodata_cbGetCh(this->cbIn))) {
+        else if (PICO_EOF != (ch = tok_getCh(this, tok))) {
             PICODBG_DEBUG(("read in %c", (picoos_char) ch));
             tok_treatChar(this, tok, (picoos_uchar) ch, /*markupHandling*/TRUE);
+            tok_treatAsciiRun(this, tok);
         }
         else {
             return PICODATA_PU_IDLE;
@@ -41,6 +41,19 @@ extern "C" {
 }
 #endif
 
+/* nr of (FST state, input position) pairs remembered per transduction as
+   not leading to any solution, so that the search does not explore them
+   again; must be a power of 2, 0 disables the memo */
+#ifndef PICOTRNS_FAIL_MEMO_SIZE
+#define PICOTRNS_FAIL_MEMO_SIZE 0
+#endif
+
+/* max. nr of steps per transduction, 0 for no limit; when reached, the
+   last solution found so far is used, or the input if there is none */
+#ifndef PICOTRNS_MAX_STEPS
+#define PICOTRNS_MAX_STEPS 0
+#endif
+
 
 
 picoos_uint8 picotrns_unplane(picoos_int16 symIn, picoos_uint8 * plane) {
@@ -141,6 +154,12 @@ struct picotrns_transductionState {
                               3 = after finish */
     picoos_uint32 nrSol;   /* nr of solutions so far */
     picoos_int16  recPos;  /* recursion position; must be signed! */
+#if PICOTRNS_FAIL_MEMO_SIZE > 0
+    picoos_int16  cleanPos; /* recursion positions from here on have
+                               neither led to a solution nor been cut
+                               short by the path length so far */
+    picoos_uint32 failMemo[PICOTRNS_FAIL_MEMO_SIZE]; /* state/inPos keys */
+#endif
 };
 
 typedef struct picotrns_altDesc {
@@ -434,10 +453,44 @@ static void NoteSolution (picoos_uint32 * nrSol, picotrns_printSolutionFct print
 
 static void StartTransduction (struct picotrns_transductionState * transductionState)
 {
+#if PICOTRNS_FAIL_MEMO_SIZE > 0
+    picoos_uint16 i;
+
+    for (i = 0; i < PICOTRNS_FAIL_MEMO_SIZE; i++) {
+        (*transductionState).failMemo[i] = 0;
+    }
+    (*transductionState).cleanPos = 0;
+#endif
     (*transductionState).phase = 0;
 }
 
 
+#if PICOTRNS_FAIL_MEMO_SIZE > 0
+
+/* Returns the fail memo slot for starting in 'state' at 'inPos', and its
+   key in '*key'; keys are never 0, which marks an empty slot. */
+
+static picoos_uint32 * FailMemoSlot (struct picotrns_transductionState * transductionState,
+                                     picokfst_state_t state, picoos_int32 inPos, picoos_uint32 * key)
+{
+    (*key) = ((picoos_uint32) inPos << 16) | (picoos_uint16) state;
+    return & (*transductionState).failMemo[(inPos * 37 + state) & (PICOTRNS_FAIL_MEMO_SIZE - 1)];
+}
+
+/* Notes that a solution was found or the path cut short at recursion
+   position 'recPos'. Its search, and that of all positions before it,
+   may no longer be noted as failed. */
+
+static void TaintRecPos (struct picotrns_transductionState * transductionState, picoos_int16 recPos)
+{
+    if ((*transductionState).cleanPos <= recPos) {
+        (*transductionState).cleanPos = recPos + 1;
+    }
+}
+
+#endif
+
+
 
 /* Performs one step in the transduction of 'inSeqLen' input symbols with corresponding
    reference positions in 'inSeq'. '*transductionState' must have been
@@ -468,6 +521,10 @@ static void TransductionStep (picokfst_FST fst, struct picotrns_transductionStat
     picokfst_symid_t outSym;
     picoos_int32 outRefPos;
     picoos_int32 tmpRecPos;
+#if PICOTRNS_FAIL_MEMO_SIZE > 0
+    picoos_uint32 key;
+    picoos_uint32 * slot;
+#endif
 
     (*finished) = 0;
     tmpRecPos = (*transductionState).recPos;
@@ -508,6 +565,9 @@ static void TransductionStep (picokfst_FST fst, struct picotrns_transductionStat
                     if ((nextInPos == inSeqLen) && picokfst_kfstIsAcceptingState(fst,endFSTState)) {
                         NoteSolution(& (*transductionState).nrSol,printSolution,altDesc,tmpRecPos+1,
                                      outSeq,outSeqLen,maxOutSeqLen);
+#if PICOTRNS_FAIL_MEMO_SIZE > 0
+                        TaintRecPos(transductionState, tmpRecPos);
+#endif
                     }
 
                     /* go to next position if possible, start search for follower alternative symbols */
@@ -520,12 +580,32 @@ static void TransductionStep (picokfst_FST fst, struct picotrns_transductionStat
                         ap->startFSTState = endFSTState;
                         ap->inPos = nextInPos;
                         ap->altState = 0;
+#if PICOTRNS_FAIL_MEMO_SIZE > 0
+                        if ((*transductionState).cleanPos > tmpRecPos) {
+                            (*transductionState).cleanPos = tmpRecPos;
+                        }
+                        /* skip alternatives known to lead nowhere */
+                        if (*FailMemoSlot(transductionState, endFSTState, nextInPos, & key) == key) {
+                            ap->altState = 4;
+                        }
+#endif
 
                     } else {
                         /* do not go on due to limited path but still treat alternatives in current position */
                         PICODBG_WARN(("--- transduction path too long; may fail to find solution\n"));
+#if PICOTRNS_FAIL_MEMO_SIZE > 0
+                        TaintRecPos(transductionState, tmpRecPos);
+#endif
                     }
                 } else {  /* no more acceptable alternative found in current position */
+#if PICOTRNS_FAIL_MEMO_SIZE > 0
+                    /* all alternatives searched in vain */
+                    if (tmpRecPos >= (*transductionState).cleanPos) {
+                        ap = & altDesc[tmpRecPos];
+                        slot = FailMemoSlot(transductionState, ap->startFSTState, ap->inPos, & key);
+                        (*slot) = key;
+                    }
+#endif
                     /* backtrack to previous recursion */
                     tmpRecPos = tmpRecPos - 1;
                 }
@@ -589,6 +669,13 @@ pico_status_t picotrns_transduce (picokfst_FST fst, picoos_bool firstSolOnly,
         TransductionStep(fst,&transductionState,altDescBuf,maxAltDescLen,firstSolOnly,printSolution,
                          inSeq,inSeqLen,outSeq,outSeqLen,maxOutSeqLen,&finished);
         (*nrSteps)++;
+#if PICOTRNS_MAX_STEPS > 0
+        if ((*nrSteps >= PICOTRNS_MAX_STEPS) && (transductionState.phase == 1)) {
+            /* give up searching, keeping what was found so far */
+            PICODBG_WARN(("--- transduction step limit reached\n"));
+            transductionState.phase = 2;
+        }
+#endif
     }
 
     return PICO_OK;
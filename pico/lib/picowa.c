@@ -84,6 +84,8 @@ static pico_status_t waInitialize(register picodata_ProcessingUnit this, picoos_
     wa_subobj_t * wa;
 
     picoknow_kb_id_t ulexKbIds[PICOKNOW_MAX_NUM_ULEX] = PICOKNOW_KBID_ULEX_ARRAY;
+    picoknow_kb_id_t ulexIndexKbIds[PICOKNOW_MAX_NUM_ULEX] =
+        PICOKNOW_KBID_ULEX_INDEX_ARRAY;
 
     PICODBG_DEBUG(("calling"));
 
@@ -109,12 +111,15 @@ static pico_status_t waInitialize(register picodata_ProcessingUnit this, picoos_
                                        NULL, NULL);
     }
     PICODBG_DEBUG(("got lex"));
+    picoklex_setIndex(wa->lex,
+                      this->voice->kbArray[PICOKNOW_KBID_LEX_MAIN_INDEX]);
 
     /* kb ulex[] */
     wa->numUlex = 0;
     for (i = 0; i<PICOKNOW_MAX_NUM_ULEX; i++) {
         ulex = picoklex_getLex(this->voice->kbArray[ulexKbIds[i]]);
         if (NULL != ulex) {
+            picoklex_setIndex(ulex, this->voice->kbArray[ulexIndexKbIds[i]]);
             wa->ulex[wa->numUlex++] = ulex;
         }
     }
@@ -0,0 +1,1128 @@
+#!/usr/bin/env python3
+# Copyright (C) 2024 DiUS Computing Pty Ltd.
+# Licensed under the Apache 2.0 license.
+#
+# Host-side helper used by the component build to stage the PicoTTS language
+# resources (*_ta.bin, *_sg.bin) for flashing.
+#
+# A pico resource file looks like this (all multi-byte values little endian):
+#
+#   svoxhdr   = " (C) SVOX AG " downshifted by 0x20 (13 bytes)
+#   hdrlen    = u16, followed by hdrlen bytes of header fields
+#   datalen   = u32, followed by datalen bytes of data
+#   data      = NRKBS1 {KBNAME ' '}=NRKBS {KBID1 OFFSET4 SIZE4}=NRKBS kbs
+#
+# The staged copy may additionally carry a knowledge base directory trailer
+# (see esp_picorsrc.c), which lets the loader build its knowledge base list
+# without walking the name and entry tables in flash.
+#
+# Selected knowledge bases may also be stored block compressed (see
+# esp_picokbc.h). Only the directory describes those correctly, so
+# compression implies a directory.
+#
+# Several staged resources may be combined into a bundle, which the
+# component flashes in place of a single resource:
+#
+#   bundle    = MAGIC4 VERSION1 NUM1 RESERVED2 {OFFSET4 SIZE4}=NUM resources
+#
+# Each resource starts on a BUNDLE_ALIGN boundary, OFFSET being relative to
+# the start of the bundle.
+#
+# Knowledge bases the engine can do without (see OPTIONAL_KBIDS) may be
+# stripped from the staged copy entirely.
+#
+# Knowledge bases can also be marked for promotion into RAM at load time.
+# The mark and its priority live in the directory only, the kb itself is
+# left untouched.
+#
+# The main lexicon may be given a minimal perfect hash index, stored as an
+# additional kb (see picoklex.c for its layout and hash functions).
+#
+# User lexica are built from a word list into a resource of their own,
+# holding a lexicon kb in the same format as the main lexicon plus its
+# index. Pronunciations are given in the phonetic alphabet of the <phoneme>
+# tag and mapped to phone ids with the language's own alphabet FSTs (see
+# picokfst.c and picotrns.c).
+#
+# The sentence phonology FSTs, which picospho.c applies one after the other,
+# may be composed into fewer FSTs. A run of FSTs adjacent in that order and
+# stored in the same resource is replaced by its composition, stored under
+# the kb id of the first one. A composition is only used while it keeps
+# single byte transition entries, does not grow much beyond the FSTs it
+# replaces, and transduces a sample of inputs exactly like the cascade.
+#
+# Viseme tables map each phone id of a language to a viseme number, one
+# byte per id, and are built from a list of visemes and the phonemes (in
+# X-SAMPA, or as id:N for phones without a symbol of their own) they cover.
+# Phone ids not covered map to viseme 0.
+
+import argparse
+import random
+import struct
+import sys
+import time
+import zlib
+
+SVOX_MARKER = bytes(c - 0x20 for c in b' (C) SVOX AG ')
+
+KBDIR_MAGIC = b'PKBD'
+KBDIR_VERSION = 1
+KBDIR_ALIGN = 4
+KBDIR_FLAG_COMPRESSED = 0x01
+KBDIR_FLAG_PROMOTE = 0x02
+
+KB_ALIGN = 4
+
+BUNDLE_MAGIC = b'PBND'
+BUNDLE_VERSION = 1
+BUNDLE_ALIGN = 16
+
+# Kbs the engine copes without: debug symbols, the phoneme markup parsers
+# (XSAMPA/SVOXPA, only used by <phoneme> tags), the lexicon indices and the
+# user lexica/rules
+OPTIONAL_KBIDS = (8, 25, 26, 27, 33, 49, 50, 57, 58, 59, 60)
+
+# Lexicon kbs keep their search index uncompressed, and must be compressed
+# in whole lexblocks (see picoklex.c)
+LEX_KBIDS = (9, 57, 58)
+LEXBLOCK_SIZE = 512
+
+LEX_MAIN_KBID = 9
+LEX_INDEX_KBID = 33
+LEX_INDEX_NAME = 'LEX_MAIN_INDEX'
+LEX_INDEX_KEYS_PER_BUCKET = 4
+LEX_INDEX_MAX_SEEDS = 64
+
+ULEX_KBIDS = {1: 57, 2: 58}
+ULEX_INDEX_KBIDS = {1: 59, 2: 60}
+ULEX_CONTENT_TYPE = 'USERLEX'
+ULEX_MAX_GRAPHLEN = 254
+ULEX_MAX_PHONLEN = 253
+ULEX_MAX_ENTRIES_PER_GRAPH = 4  # PICOKLEX_MAX_NRRES
+
+FST_XSAMPA_PARSER_KBID = 25
+FST_SVOXPA_PARSER_KBID = 26
+FST_XSAMPA2SVOXPA_KBID = 27
+FST_PLANE_ASCII = 1
+# picotok's transducer works on 10*(PICOTRNS_MAX_NUM_POSSYM+2) bytes of
+# 24 byte alternative descriptors
+FST_MAX_PATH_LEN = 10 * (255 + 2) // 24
+FST_POS_INSERT = -1
+
+# Sentence phonology FSTs, in the order picospho applies them
+FST_SPHO_KBIDS = (20, 21, 22, 23, 24, 28, 29, 30, 31, 32)
+# picospho's transducer works on 60*PICOTRNS_MAX_NUM_POSSYM bytes of
+# 24 byte alternative descriptors
+FST_SPHO_MAX_PATH_LEN = 60 * 255 // 24
+SPHO_COMPOSE_MAX_STATES = 255
+SPHO_COMPOSE_MAX_GROWTH = 1.5
+SPHO_COMPOSE_CHECK_INPUTS = 500
+SPHO_COMPOSE_CHECK_MAX_LEN = 40
+
+
+def lex_entries(kb):
+    """Yields (graph, lexpos) for each entry of a lexicon kb, lexpos being
+    relative to the start of the lexblocks."""
+    nrblocks = struct.unpack_from('<H', kb, 0)[0]
+    base = 2 + nrblocks * 5
+    for block in range(nrblocks):
+        pos = block * LEXBLOCK_SIZE
+        end = pos + LEXBLOCK_SIZE
+        while pos < end and kb[base + pos] != 0:
+            graphlen = kb[base + pos]
+            yield bytes(kb[base + pos + 1:base + pos + graphlen]), pos
+            pos += graphlen + kb[base + pos + graphlen]
+
+
+def _lex_index_hash(graph, seed):
+    h = 2166136261 ^ seed
+    for b in graph:
+        h = ((h ^ b) * 16777619) & 0xffffffff
+    return h
+
+
+def _lex_index_slot(h, displ, nrkeys):
+    h = (h + displ * 0x9e3779b9) & 0xffffffff
+    h ^= h >> 16
+    h = (h * 0x85ebca6b) & 0xffffffff
+    h ^= h >> 13
+    h = (h * 0xc2b2ae35) & 0xffffffff
+    h ^= h >> 16
+    return h % nrkeys
+
+
+def _place_lex_index_buckets(buckets, nrkeys):
+    """Finds a displacement for each bucket such that all hashes end up in
+    distinct slots. Returns the displacements and the hash in each slot, or
+    None if some bucket cannot be placed."""
+    displ = [0] * len(buckets)
+    slots = [None] * nrkeys
+    # place the largest buckets first, while most slots are free
+    for b in sorted(range(len(buckets)), key=lambda b: -len(buckets[b])):
+        if not buckets[b]:
+            break
+        for d in range(0x10000):
+            s = [_lex_index_slot(h, d, nrkeys) for h in buckets[b]]
+            if len(set(s)) == len(s) and all(slots[i] is None for i in s):
+                break
+        else:
+            return None
+        displ[b] = d
+        for h, i in zip(buckets[b], s):
+            slots[i] = h
+    return displ, slots
+
+
+def build_lex_index(kb):
+    """Builds a minimal perfect hash index over the distinct graphs of a
+    lexicon kb, mapping each to the lexpos of its first entry. Each slot
+    also holds the top byte of the graph's hash, which rejects most graphs
+    not in the lexicon without reading the lexicon."""
+    nrblocks = struct.unpack_from('<H', kb, 0)[0]
+    first = {}
+    for graph, lexpos in lex_entries(kb):
+        first.setdefault(graph, lexpos)
+    nrkeys = len(first)
+    if nrkeys == 0:
+        return None
+    nrbuckets = (nrkeys + LEX_INDEX_KEYS_PER_BUCKET - 1) // \
+        LEX_INDEX_KEYS_PER_BUCKET
+    for seed in range(LEX_INDEX_MAX_SEEDS):
+        hashes = {_lex_index_hash(g, seed): pos for g, pos in first.items()}
+        if len(hashes) != nrkeys:
+            continue  # graphs with the same hash, try another seed
+        buckets = [[] for _ in range(nrbuckets)]
+        for h in hashes:
+            buckets[h % nrbuckets].append(h)
+        placed = _place_lex_index_buckets(buckets, nrkeys)
+        if placed is None:
+            continue
+        displ, slots = placed
+        index = struct.pack('<IIIHH', nrkeys, nrbuckets, seed, nrblocks, 0)
+        index += struct.pack('<%dH' % nrbuckets, *displ)
+        index += b''.join(struct.pack('<I', hashes[h] | (h >> 24) << 24)
+                          for h in slots)
+        return index
+    raise ValueError('failed to build a lexicon index')
+
+
+def _fst_num(kb, pos):
+    """Reads a variable length number (see BytesToNum in picokfst.c).
+    Returns the number and the position after it."""
+    val = 0
+    while kb[pos] < 128:
+        val = (val << 7) + kb[pos]
+        pos += 1
+    val = (val << 7) + kb[pos] - 128
+    return (-(val - 1) // 2 - 1 if val % 2 else val // 2), pos + 1
+
+
+def _fst_fixed_num(kb, pos, nrbytes):
+    val = int.from_bytes(kb[pos:pos + nrbytes], 'big')
+    return -(val - 1) // 2 - 1 if val % 2 else val // 2
+
+
+def _fst_num_bytes(num):
+    """Encodes a number so that _fst_num() reads it back."""
+    val = 2 * num if num >= 0 else -2 * num - 1
+    out = [128 + (val & 127)]
+    val >>= 7
+    while val:
+        out.append(val & 127)
+        val >>= 7
+    return bytes(reversed(out))
+
+
+def _fst_fixed_num_bytes(num, nrbytes):
+    val = 2 * num if num >= 0 else -2 * num - 1
+    return val.to_bytes(nrbytes, 'big')
+
+
+class Fst:
+    """Read-only view of an FST kb, transducing like picotrns_transduce()
+    does."""
+
+    def __init__(self, kb):
+        self.kb = kb
+        pos = 4
+        fields = []
+        for _ in range(10):
+            val, pos = _fst_num(kb, pos)
+            fields.append(val)
+        (self.mode, self.nr_classes, self.nr_states, self.term_class,
+         self.hash_size, hash_offs, self.entry_size, trans_offs,
+         in_eps_offs, acc_offs) = fields
+        self.hash_pos = 4 + hash_offs
+        self.trans_pos = 4 + trans_offs
+        self.in_eps_pos = 4 + in_eps_offs
+        self.acc_pos = 4 + acc_offs
+
+    def _pairs(self, in_sym):
+        """Yields the (outSym, class) pairs for an input symbol."""
+        kb = self.kb
+        offs = _fst_fixed_num(kb, self.hash_pos + 4 * (in_sym %
+                                                       self.hash_size), 4)
+        if offs <= 0:
+            return
+        cell = self.hash_pos + offs
+        while True:
+            sym, pos = _fst_num(kb, cell)
+            next_offs, pos = _fst_num(kb, pos)
+            if sym == in_sym:
+                break
+            if next_offs <= 0:
+                return
+            cell += next_offs
+        while True:
+            out_sym, pos = _fst_num(kb, pos)
+            if out_sym == -1:
+                return
+            pair_class, pos = _fst_num(kb, pos)
+            yield out_sym, pair_class
+
+    def _trans(self, state, pair_class):
+        if not (1 <= state <= self.nr_states and
+                1 <= pair_class <= self.nr_classes):
+            return 0
+        pos = self.trans_pos + self.entry_size * \
+            ((state - 1) * self.nr_classes + pair_class - 1)
+        return int.from_bytes(self.kb[pos:pos + self.entry_size], 'big')
+
+    def _in_eps(self, state):
+        """Yields the (outSym, endState) input epsilon transitions."""
+        if not 1 <= state <= self.nr_states:
+            return
+        offs = _fst_fixed_num(self.kb, self.in_eps_pos + 4 * (state - 1), 4)
+        if offs <= 0:
+            return
+        pos = self.in_eps_pos + offs
+        while True:
+            out_sym, pos = _fst_num(self.kb, pos)
+            if out_sym == -1:
+                return
+            end_state, pos = _fst_num(self.kb, pos)
+            yield out_sym, end_state
+
+    def _accepting(self, state):
+        return 1 <= state <= self.nr_states and \
+            self.kb[self.acc_pos + state - 1] == 1
+
+    def _alternatives(self, state, syms, pos):
+        if pos < len(syms):
+            for out_sym, pair_class in self._pairs(syms[pos]):
+                end_state = self._trans(state, pair_class)
+                if end_state > 0:
+                    yield out_sym, end_state, pos + 1
+        for out_sym, end_state in self._in_eps(state):
+            yield out_sym, end_state, pos
+
+    def _search(self, state, syms, pos, depth):
+        for out_sym, end_state, next_pos in \
+                self._alternatives(state, syms, pos):
+            if next_pos == len(syms) and self._accepting(end_state):
+                return [out_sym]
+            if depth < FST_MAX_PATH_LEN - 1:
+                rest = self._search(end_state, syms, next_pos, depth + 1)
+                if rest is not None:
+                    return [out_sym] + rest
+        return None
+
+    def transduce(self, syms):
+        """Returns the output symbols of the first solution with epsilons
+        removed, or None if the input is not accepted."""
+        if not syms:
+            return []
+        out = self._search(1, syms, 0, 0)
+        return None if out is None else [sym for sym in out if sym != 0]
+
+    def transduce_all(self, possyms, max_path_len):
+        """Transduces (pos, sym) pairs like picotrns_transduce() does when
+        searching all solutions: the last solution found is kept, and the
+        input is passed on if there is none. Epsilons are removed from the
+        output, like picotrns_eliminate_epsilons() does."""
+        solution = [] if not possyms else None
+        path = []
+
+        def search(state, pos):
+            nonlocal solution
+            alternatives = []
+            if pos < len(possyms):
+                ref, sym = possyms[pos]
+                if sym == 0:
+                    alternatives.append((0, state, pos + 1, ref))
+                else:
+                    for out_sym, pair_class in self._pairs(sym):
+                        end_state = self._trans(state, pair_class)
+                        if end_state > 0:
+                            alternatives.append(
+                                (out_sym, end_state, pos + 1, ref))
+            for out_sym, end_state in self._in_eps(state):
+                alternatives.append((out_sym, end_state, pos, FST_POS_INSERT))
+            for out_sym, end_state, next_pos, ref in alternatives:
+                path.append((ref, out_sym))
+                if next_pos == len(possyms) and self._accepting(end_state):
+                    solution = list(path)
+                if len(path) < max_path_len:
+                    search(end_state, next_pos)
+                path.pop()
+
+        search(1, 0)
+        if solution is None:
+            solution = possyms
+        return [(ref, sym) for ref, sym in solution if sym != 0]
+
+
+class FstTable:
+    """FST held as plain tables, for composing FSTs and writing them back
+    as kbs. 'pairs' maps input symbols to their (outSym, class) pairs,
+    'trans' and 'in_eps' (lists of (outSym, endState)) are indexed by state
+    and 'trans' rows also by class, row and column 0 being unused."""
+
+    def __init__(self, nr_states, nr_classes, pairs, trans, in_eps,
+                 accepting, hash_size, mode=0, term_class=0):
+        self.nr_states = nr_states
+        self.nr_classes = nr_classes
+        self.pairs = pairs
+        self.trans = trans
+        self.in_eps = in_eps
+        self.accepting = accepting
+        self.hash_size = hash_size
+        self.mode = mode
+        self.term_class = term_class
+
+    @classmethod
+    def from_fst(cls, fst):
+        pairs = {}
+        kb = fst.kb
+        for h in range(fst.hash_size):
+            offs = _fst_fixed_num(kb, fst.hash_pos + 4 * h, 4)
+            cell = fst.hash_pos + offs
+            while offs > 0:
+                sym, pos = _fst_num(kb, cell)
+                offs, pos = _fst_num(kb, pos)
+                pairs[sym] = list(fst._pairs(sym))
+                cell += offs
+        states = range(fst.nr_states + 1)
+        classes = range(fst.nr_classes + 1)
+        return cls(fst.nr_states, fst.nr_classes, pairs,
+                   [[fst._trans(s, c) for c in classes] for s in states],
+                   [list(fst._in_eps(s)) for s in states],
+                   [fst._accepting(s) for s in states],
+                   fst.hash_size, fst.mode, fst.term_class)
+
+    def _moves(self, a, b, f, other):
+        """Yields the moves of the composed state (a, b, f), as (inSym,
+        altKey, outSym, target); inSym is None for input epsilons. The
+        altKey orders the moves for an input symbol like the search of the
+        cascade would try them. f is set after an insertion by 'other',
+        and then keeps this FST from moving without output, so that no
+        interleaving of the two is produced twice."""
+        for x, pairs in self.pairs.items():
+            for i, (y, pair_class) in enumerate(pairs):
+                a2 = self.trans[a][pair_class]
+                if a2 <= 0:
+                    continue
+                if y == 0:
+                    if not f:
+                        yield x, (i, -1), 0, (a2, b, 0)
+                    continue
+                for j, (z, other_class) in enumerate(other.pairs.get(y, ())):
+                    b2 = other.trans[b][other_class]
+                    if b2 > 0:
+                        yield x, (i, j), z, (a2, b2, 0)
+        for y, a2 in self.in_eps[a]:
+            if y == 0:
+                if not f:
+                    yield None, None, 0, (a2, b, 0)
+                continue
+            for z, other_class in other.pairs.get(y, ()):
+                b2 = other.trans[b][other_class]
+                if b2 > 0:
+                    yield None, None, z, (a2, b2, 0)
+        for z, b2 in other.in_eps[b]:
+            yield None, None, z, (a, b2, 1)
+
+    def compose(self, other, max_states):
+        """Returns the FST transducing like this one followed by 'other',
+        or None if it takes more than 'max_states' states."""
+        index = {(1, 1, 0): 0}
+        states = [(1, 1, 0)]
+        moves = []
+        i = 0
+        while i < len(states):
+            moves.append(list(self._moves(*states[i], other)))
+            for move in moves[-1]:
+                if move[3] not in index:
+                    index[move[3]] = len(states)
+                    states.append(move[3])
+            if len(states) > 4 * max_states:
+                return None
+            i += 1
+        # only keep states from which an accepting state can be reached
+        accepting = [self.accepting[a] and other.accepting[b]
+                     for a, b, _ in states]
+        preds = [[] for _ in states]
+        for s, state_moves in enumerate(moves):
+            for move in state_moves:
+                preds[index[move[3]]].append(s)
+        live = set(s for s in range(len(states)) if accepting[s])
+        todo = list(live)
+        while todo:
+            for p in preds[todo.pop()]:
+                if p not in live:
+                    live.add(p)
+                    todo.append(p)
+        if 0 not in live:
+            return None
+        keep = sorted(live)
+        if len(keep) > max_states:
+            return None
+        number = {s: n + 1 for n, s in enumerate(keep)}
+        # every distinct (input, alternative, output) gets a column of end
+        # states, and equal columns share a pair class
+        columns = {}
+        in_eps = [[]]
+        for s in keep:
+            eps = []
+            for x, key, z, target in moves[s]:
+                t = index[target]
+                if t not in live:
+                    continue
+                if x is None:
+                    if (z, number[t]) not in eps:
+                        eps.append((z, number[t]))
+                else:
+                    columns.setdefault((x, key, z), {})[number[s]] = \
+                        number[t]
+            in_eps.append(eps)
+        classes = {}
+        pairs = {}
+        for x, key, z in sorted(columns):
+            column = tuple(sorted(columns[(x, key, z)].items()))
+            pair_class = classes.setdefault(column, len(classes) + 1)
+            if (z, pair_class) not in pairs.setdefault(x, []):
+                pairs[x].append((z, pair_class))
+        trans = [[0] * (len(classes) + 1) for _ in range(len(keep) + 1)]
+        for column, pair_class in classes.items():
+            for s, t in column:
+                trans[s][pair_class] = t
+        return FstTable(len(keep), len(classes), pairs, trans, in_eps,
+                        [False] + [accepting[s] for s in keep],
+                        self.hash_size, self.mode, self.term_class)
+
+    def build(self):
+        """Returns the FST as a kb (see picokfst.c for the layout)."""
+        entry_size = 1 if self.nr_states < 256 else 2
+        hash_table = bytearray(4 * self.hash_size)
+        cells = bytearray()
+        chains = {}
+        for x in self.pairs:
+            chains.setdefault(x % self.hash_size, []).append(x)
+        for h, syms in sorted(chains.items()):
+            hash_table[4 * h:4 * h + 4] = _fst_fixed_num_bytes(
+                len(hash_table) + len(cells), 4)
+            for n, x in enumerate(syms):
+                cell = _fst_num_bytes(x)
+                cell_end = b''.join(_fst_num_bytes(y) + _fst_num_bytes(c)
+                                    for y, c in self.pairs[x]) + \
+                    _fst_num_bytes(-1)
+                # the next cell's offset is relative to this one
+                offs = 0
+                if n + 1 < len(syms):
+                    while offs != len(cell) + len(_fst_num_bytes(offs)) + \
+                            len(cell_end):
+                        offs = len(cell) + len(_fst_num_bytes(offs)) + \
+                            len(cell_end)
+                cells += cell + _fst_num_bytes(offs) + cell_end
+        trans = b''.join(self.trans[s][c].to_bytes(entry_size, 'big')
+                         for s in range(1, self.nr_states + 1)
+                         for c in range(1, self.nr_classes + 1))
+        eps_table = bytearray(4 * self.nr_states)
+        eps_lists = bytearray()
+        for s in range(1, self.nr_states + 1):
+            if self.in_eps[s]:
+                eps_table[4 * (s - 1):4 * s] = _fst_fixed_num_bytes(
+                    len(eps_table) + len(eps_lists), 4)
+                for y, t in self.in_eps[s]:
+                    eps_lists += _fst_num_bytes(y) + _fst_num_bytes(t)
+                eps_lists += _fst_num_bytes(-1)
+        acc = bytes(1 if self.accepting[s] else 0
+                    for s in range(1, self.nr_states + 1))
+        # offsets are relative to the end of the 4 byte kb header, which
+        # the header fields themselves follow
+        alpha = bytes(hash_table + cells)
+        eps = bytes(eps_table + eps_lists)
+        fields = b''
+        while True:
+            offs = len(fields)
+            new_fields = b''.join(_fst_num_bytes(v) for v in (
+                self.mode, self.nr_classes, self.nr_states, self.term_class,
+                self.hash_size, offs, entry_size, offs + len(alpha),
+                offs + len(alpha) + len(trans),
+                offs + len(alpha) + len(trans) + len(eps)))
+            if len(new_fields) == len(fields):
+                break
+            fields = new_fields
+        return b'xxxx' + new_fields + alpha + trans + eps + acc
+
+
+def _random_fst_inputs(table, rng, count, max_len):
+    """Yields up to 'count' input sequences accepted by the FST, as
+    (pos, sym) pairs, by walking it at random."""
+    moves = [[] for _ in range(table.nr_states + 1)]
+    for x, pairs in table.pairs.items():
+        for _, pair_class in pairs:
+            for s in range(1, table.nr_states + 1):
+                if table.trans[s][pair_class] > 0:
+                    moves[s].append((x, table.trans[s][pair_class]))
+    for s in range(1, table.nr_states + 1):
+        moves[s] += [(None, t) for _, t in table.in_eps[s]]
+    for _ in range(count):
+        state, syms = 1, []
+        for _ in range(4 * max_len):
+            if table.accepting[state] and \
+                    (rng.random() < 0.1 or len(syms) >= max_len):
+                yield [(pos, sym) for pos, sym in enumerate(syms)]
+                break
+            if not moves[state]:
+                break
+            sym, state = rng.choice(moves[state])
+            if sym is not None:
+                syms.append(sym)
+
+
+def _transduces_like(fsts, fst, inputs):
+    """Checks that 'fst' transduces the inputs like the cascade 'fsts'
+    does in picospho.c."""
+    for possyms in inputs:
+        out = possyms
+        for f in fsts:
+            out = f.transduce_all(out, FST_SPHO_MAX_PATH_LEN)
+        if fst.transduce_all(possyms, FST_SPHO_MAX_PATH_LEN) != out:
+            return False
+    return True
+
+
+def phonemes_to_ids(rsrc, phonemes, alphabet):
+    """Maps a phoneme string to phone ids like picodata_mapPAStrToPAIds()
+    does for a <phoneme> tag."""
+    syms = [(FST_PLANE_ASCII << 8) + b for b in phonemes.encode('ascii')]
+    if alphabet == 'xsampa':
+        fsts = (FST_XSAMPA_PARSER_KBID, FST_XSAMPA2SVOXPA_KBID)
+    else:
+        fsts = (FST_SVOXPA_PARSER_KBID,)
+    for kbid in fsts:
+        if rsrc.find_kb(str(kbid)) is None or rsrc.kb_content(kbid) is None:
+            raise ValueError('resource has no %s support' % alphabet)
+        syms = Fst(rsrc.kb_content(kbid)).transduce(syms)
+        if not syms:
+            raise ValueError('not valid %s: %s' % (alphabet, phonemes))
+    return bytes(sym & 0xff for sym in syms)
+
+
+def build_lex(entries):
+    """Builds a lexicon kb from (graph, pos, phon) entries. Entries are
+    sorted by graph, entries with the same graph keep their order. All
+    entries sharing a 3 byte graph prefix go into the same lexblock where
+    they fit, as the search index can only tell prefixes apart."""
+    entries = sorted(entries, key=lambda e: e[0])
+    groups = []
+    for graph, pos, phon in entries:
+        entry = bytes([len(graph) + 1]) + graph + \
+            bytes([len(phon) + 2, pos]) + phon
+        prefix = graph[:3].ljust(3, b'\0')
+        if groups and groups[-1][0] == prefix:
+            groups[-1][1].append(entry)
+        else:
+            groups.append((prefix, [entry]))
+    blocks = []  # [prefix, content]
+    for prefix, group in groups:
+        size = sum(len(e) for e in group)
+        if not blocks or len(blocks[-1][1]) + size > LEXBLOCK_SIZE:
+            blocks.append([prefix, b''])
+        for entry in group:
+            if len(blocks[-1][1]) + len(entry) > LEXBLOCK_SIZE:
+                blocks.append([prefix, b''])
+            blocks[-1][1] += entry
+    if len(blocks) > 0xffff:
+        raise ValueError('lexicon too large')
+    # the first block also takes any graph sorting before its first entry
+    if blocks:
+        blocks[0][0] = b'\0\0\0'
+    kb = struct.pack('<H', len(blocks))
+    kb += b''.join(prefix + struct.pack('<H', i)
+                   for i, (prefix, _) in enumerate(blocks))
+    kb += b''.join(content.ljust(LEXBLOCK_SIZE, b'\0')
+                   for _, content in blocks)
+    return kb
+
+
+def build_resource(name, content_type, contents):
+    """Builds a resource from a list of (kbid, content, kbname)."""
+    fields = ' NAME %s VERSION 1.0.0.0-0-0 DATE %s TIME %s CONTENT_TYPE %s ' \
+        % (name, time.strftime('%Y-%m-%d'), time.strftime('%H:%M:%S.000'),
+           content_type)
+    header = bytes([5]) + fields.encode('ascii')
+    # keep the data, and with it every kb, 4 byte aligned
+    header += bytes(-(len(SVOX_MARKER) + 2 + len(header) + 4) % KB_ALIGN)
+    raw = SVOX_MARKER + struct.pack('<H', len(header)) + header + \
+        struct.pack('<I', 1) + b'\0'
+    rsrc = Resource(raw)
+    rsrc._rebuild([(kbid, content, len(content), kbname)
+                   for kbid, content, kbname in contents])
+    return rsrc
+
+
+class Resource:
+    def __init__(self, raw):
+        if raw[:len(SVOX_MARKER)] != SVOX_MARKER:
+            raise ValueError('not a pico resource (no SVOX header)')
+        hdrlen = struct.unpack_from('<H', raw, 13)[0]
+        self.header = raw[:15 + hdrlen]
+        datalen = struct.unpack_from('<I', raw, 15 + hdrlen)[0]
+        self.data_offs = 15 + hdrlen + 4
+        self.data = raw[self.data_offs:self.data_offs + datalen]
+        if len(self.data) != datalen:
+            raise ValueError('truncated resource data')
+        self.kbs = self._parse_kb_list()
+        self.flags = {}
+        self.prio = {}
+
+    def _parse_kb_list(self):
+        data = self.data
+        num = data[0]
+        pos = 1
+        names = []
+        for _ in range(num):
+            while data[pos] != 0 and data[pos] <= 0x20:
+                pos += 1
+            start = pos
+            while data[pos] > 0x20:
+                pos += 1
+            names.append(data[start:pos].decode('ascii'))
+        pos += 1  # termination of last name
+        self.table_pos = pos
+        kbs = []
+        for name in names:
+            kbid = data[pos]
+            offset, size = struct.unpack_from('<II', data, pos + 1)
+            pos += 9
+            kbs.append((kbid, offset, size, name))
+        return kbs
+
+    def kb_content(self, kbid):
+        for i, offset, size, _ in self.kbs:
+            if i == kbid:
+                return self.data[offset:offset + size] if offset else None
+        raise ValueError('no kb with id %d' % kbid)
+
+    def find_kb(self, name):
+        """Looks up a kb id by its name in the resource, or by number."""
+        for kbid, _, _, kbname in self.kbs:
+            if name == kbname or name == str(kbid):
+                return kbid
+        return None
+
+    def compress(self, kbid, block_size):
+        """Replaces the content of the kb with a block compressed version.
+        Returns the number of bytes saved."""
+        kb = self.kb_content(kbid)
+        if kb is None:
+            return 0
+        rawsize = 0
+        if kbid in LEX_KBIDS:
+            if block_size % LEXBLOCK_SIZE:
+                raise ValueError('lexicon block size must be a multiple '
+                                 'of %d' % LEXBLOCK_SIZE)
+            nrblocks = struct.unpack_from('<H', kb, 0)[0]
+            rawsize = 2 + nrblocks * 5
+        blocks = []
+        for pos in range(rawsize, len(kb), block_size):
+            z = zlib.compressobj(9, zlib.DEFLATED, -15)
+            blocks.append(z.compress(kb[pos:pos + block_size]) + z.flush())
+        ckb = struct.pack('<III', rawsize, block_size, len(blocks))
+        offs = len(ckb) + 4 * (len(blocks) + 1) + rawsize
+        for block in blocks:
+            ckb += struct.pack('<I', offs)
+            offs += len(block)
+        ckb += struct.pack('<I', offs)
+        ckb += kb[:rawsize] + b''.join(blocks)
+        if len(ckb) >= len(kb):
+            return 0
+        self._replace(kbid, ckb)
+        self.flags[kbid] = KBDIR_FLAG_COMPRESSED
+        return len(kb) - len(ckb)
+
+    def add_lex_index(self):
+        """Adds (or replaces) the index over the main lexicon, which must
+        not be compressed yet. Returns the size of the index."""
+        kb = self.kb_content(LEX_MAIN_KBID)
+        if kb is None or \
+                self.flags.get(LEX_MAIN_KBID, 0) & KBDIR_FLAG_COMPRESSED:
+            raise ValueError('no uncompressed main lexicon to index')
+        index = build_lex_index(kb)
+        if index is None:
+            return 0
+        contents = [(i, self.kb_content(i), size, name)
+                    for i, _, size, name in self.kbs if i != LEX_INDEX_KBID]
+        contents.append((LEX_INDEX_KBID, index, len(index), LEX_INDEX_NAME))
+        self._rebuild(contents)
+        return len(index)
+
+    def promote(self, kbid):
+        """Marks the kb for promotion into RAM. Kbs marked earlier get
+        the higher priority (lower number) when the RAM budget is tight."""
+        if kbid in self.prio:
+            return
+        self.flags[kbid] = self.flags.get(kbid, 0) | KBDIR_FLAG_PROMOTE
+        self.prio[kbid] = min(len(self.prio) + 1, 255)
+
+    def strip(self, kbid):
+        """Removes the kb from the resource altogether. Returns the number
+        of bytes saved."""
+        if kbid not in OPTIONAL_KBIDS:
+            raise ValueError('kb %d is required by the engine' % kbid)
+        before = len(self.data)
+        self._rebuild([(i, self.kb_content(i), size, name)
+                       for i, _, size, name in self.kbs if i != kbid])
+        self.flags.pop(kbid, None)
+        self.prio.pop(kbid, None)
+        return before - len(self.data)
+
+    def compose_spho(self):
+        """Composes runs of adjacent sentence phonology FSTs where that is
+        safe (see the top of this file). Returns the number of FSTs before
+        and after."""
+        ids = [kbid for kbid, _, _, _ in self.kbs]
+        present = [kbid for kbid in FST_SPHO_KBIDS
+                   if kbid in ids and
+                   self.kb_content(kbid) is not None and
+                   not self.flags.get(kbid, 0) & KBDIR_FLAG_COMPRESSED]
+        rng = random.Random(0)
+        runs = []  # [kbids, table, content]
+        for kbid in present:
+            content = self.kb_content(kbid)
+            table = FstTable.from_fst(Fst(content))
+            if runs and FST_SPHO_KBIDS.index(kbid) == \
+                    FST_SPHO_KBIDS.index(runs[-1][0][-1]) + 1:
+                kbids, head, _ = runs[-1]
+                composed = head.compose(table, SPHO_COMPOSE_MAX_STATES)
+                if composed is not None:
+                    kb = composed.build()
+                    fsts = [Fst(self.kb_content(i)) for i in kbids] + \
+                        [Fst(content)]
+                    replaced = sum(len(f.kb) for f in fsts)
+                    first = FstTable.from_fst(fsts[0])
+                    inputs = _random_fst_inputs(
+                        first, rng, SPHO_COMPOSE_CHECK_INPUTS,
+                        SPHO_COMPOSE_CHECK_MAX_LEN)
+                    if len(kb) <= SPHO_COMPOSE_MAX_GROWTH * replaced and \
+                            _transduces_like(fsts, Fst(kb), inputs):
+                        runs[-1] = [kbids + [kbid], composed, kb]
+                        continue
+            runs.append([[kbid], table, content])
+        heads = dict((kbids[0], content) for kbids, _, content in runs
+                     if len(kbids) > 1)
+        absorbed = [i for kbids, _, _ in runs for i in kbids[1:]]
+        self._rebuild([(i, heads.get(i, self.kb_content(i)),
+                        len(heads[i]) if i in heads else size, name)
+                       for i, _, size, name in self.kbs
+                       if i not in absorbed])
+        for i in absorbed:
+            self.flags.pop(i, None)
+            self.prio.pop(i, None)
+        return len(present), len(runs)
+
+    def _replace(self, kbid, content):
+        """Rebuilds the data with new content for kb 'kbid'. The directory
+        keeps the original (uncompressed) kb size."""
+        self._rebuild([(i, content if i == kbid else self.kb_content(i),
+                        size, name) for i, _, size, name in self.kbs])
+
+    def _rebuild(self, contents):
+        """Rebuilds the data from a list of (kbid, content, size, name)."""
+        names = b''.join(name.encode('ascii') + b' '
+                         for _, _, _, name in contents)
+        data = bytearray([len(contents)]) + names
+        self.table_pos = len(data)
+        data += bytes(len(contents) * 9)
+        kbs = []
+        pos = self.table_pos
+        for i, content, size, name in contents:
+            if content is None:
+                offset, stored = 0, size
+            else:
+                data += bytes(-len(data) % KB_ALIGN)
+                offset, stored = len(data), len(content)
+                data += content
+            struct.pack_into('<BII', data, pos, i, offset, stored)
+            pos += 9
+            kbs.append((i, offset, size, name))
+        self.data = bytes(data)
+        self.kbs = kbs
+
+    def kbdir(self):
+        """Builds the directory trailer for this resource. The trailer is
+        placed at the first 4-byte aligned position after the data."""
+        body = KBDIR_MAGIC + struct.pack(
+            '<BBHI', KBDIR_VERSION, len(self.kbs), 0, len(self.data))
+        for kbid, offset, size, _ in self.kbs:
+            body += struct.pack('<BBBBII', kbid, self.flags.get(kbid, 0),
+                                self.prio.get(kbid, 0), 0, offset, size)
+        checksum = sum(struct.unpack('<%dI' % (len(body) // 4), body))
+        return body + struct.pack('<I', ~checksum & 0xffffffff)
+
+    def serialise(self, with_kbdir):
+        out = self.header + struct.pack('<I', len(self.data)) + self.data
+        if with_kbdir:
+            out += bytes(-len(out) % KBDIR_ALIGN)
+            out += self.kbdir()
+        return out
+
+
+def cmd_stage(args):
+    with open(args.input, 'rb') as f:
+        rsrc = Resource(f.read())
+    strip = [rsrc.find_kb(name) for name in args.strip]
+    if args.keep:
+        keep = [rsrc.find_kb(name) for name in args.keep]
+        strip += [kbid for kbid, _, _, _ in rsrc.kbs if kbid not in keep]
+    strip = [kbid for kbid, _, _, _ in rsrc.kbs if kbid in strip]
+    saved = sum(rsrc.strip(kbid) for kbid in strip)
+    if strip:
+        print('%s: stripped %d kbs, %d bytes saved' %
+              (args.input, len(strip), saved))
+    if args.lex_index and rsrc.find_kb(str(LEX_MAIN_KBID)) is not None:
+        size = rsrc.add_lex_index()
+        print('%s: added lexicon index, %d bytes' % (args.input, size))
+    if args.compose_spho:
+        before, after = rsrc.compose_spho()
+        if before != after:
+            print('%s: composed %d sentence phonology FSTs into %d' %
+                  (args.input, before, after))
+    for name in args.compress:
+        kbid = rsrc.find_kb(name)
+        if kbid is None:
+            continue  # not every language has every kb
+        saved = rsrc.compress(kbid, args.block_size)
+        print('%s: compressed kb %s, %d bytes saved' %
+              (args.input, name, saved))
+    for name in args.promote:
+        kbid = rsrc.find_kb(name)
+        if kbid is not None:
+            rsrc.promote(kbid)
+    with open(args.output, 'wb') as f:
+        f.write(rsrc.serialise(args.kbdir or bool(rsrc.flags)))
+
+
+def cmd_bundle(args):
+    resources = []
+    for name in args.inputs:
+        with open(name, 'rb') as f:
+            raw = f.read()
+        Resource(raw)  # validate
+        resources.append(raw)
+    out = BUNDLE_MAGIC + struct.pack(
+        '<BBH', BUNDLE_VERSION, len(resources), 0)
+    offset = len(out) + 8 * len(resources)
+    body = b''
+    for raw in resources:
+        pad = bytes(-(offset + len(body)) % BUNDLE_ALIGN)
+        body += pad
+        out += struct.pack('<II', offset + len(body), len(raw))
+        body += raw
+    with open(args.output, 'wb') as f:
+        f.write(out + body)
+
+
+def _main_lex_pos(rsrc):
+    """Returns a dict of graph to list of POS in the main lexicon."""
+    kb = rsrc.kb_content(LEX_MAIN_KBID)
+    base = 2 + struct.unpack_from('<H', kb, 0)[0] * 5
+    pos = {}
+    for graph, lexpos in lex_entries(kb):
+        pos.setdefault(graph, []).append(kb[base + lexpos + len(graph) + 2])
+    return pos
+
+
+def cmd_ulex(args):
+    with open(args.ta, 'rb') as f:
+        ta = Resource(f.read())
+    name = ta.header[15:].split(b' NAME ', 1)[-1].split()[0].decode('ascii')
+    lang = name.split('_')[0]
+    main_pos = _main_lex_pos(ta)
+    counts = {}
+    for poslist in main_pos.values():
+        for p in poslist:
+            counts[p] = counts.get(p, 0) + 1
+    default_pos = max(counts, key=counts.get)
+    entries = []
+    poses = {}  # graph to the POS of its entries so far
+    with open(args.input, encoding='utf-8') as f:
+        for nr, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            fields = line.split('\t') if '\t' in line else line.split()
+            fields = [field.strip() for field in fields]
+            if len(fields) not in (2, 3):
+                raise ValueError('%s:%d: expected word, phonemes and '
+                                 'optional POS' % (args.input, nr))
+            graph = fields[0].lower().encode('utf-8')
+            try:
+                phon = phonemes_to_ids(ta, fields[1], args.alphabet)
+            except ValueError as e:
+                raise ValueError('%s:%d: %s' % (args.input, nr, e))
+            if len(fields) == 3 and fields[2].isdigit():
+                poslist = [int(fields[2])]
+            elif len(fields) == 3:
+                poslist = main_pos.get(fields[2].lower().encode('utf-8'))
+                if poslist is None:
+                    raise ValueError('%s:%d: no POS for %s in the main '
+                                     'lexicon' % (args.input, nr, fields[2]))
+                poslist = poslist[:1]
+            else:
+                poslist = main_pos.get(graph, [default_pos])
+            if len(graph) > ULEX_MAX_GRAPHLEN or len(phon) > ULEX_MAX_PHONLEN:
+                raise ValueError('%s:%d: entry too long' % (args.input, nr))
+            for p in poslist:
+                same = poses.setdefault(graph, [])
+                if p in same:
+                    continue  # (graph, POS) must be unique
+                if len(same) == ULEX_MAX_ENTRIES_PER_GRAPH:
+                    raise ValueError('%s:%d: more than %d entries for %s' % (
+                        args.input, nr, ULEX_MAX_ENTRIES_PER_GRAPH,
+                        fields[0]))
+                same.append(p)
+                entries.append((graph, p, phon))
+    if not entries:
+        raise ValueError('%s: no words' % args.input)
+    lex = build_lex(entries)
+    index = build_lex_index(lex)
+    rsrc_name = '%s_ulex%d_%08x' % (lang, args.slot,
+                                    zlib.crc32(lex) & 0xffffffff)
+    rsrc = build_resource(rsrc_name, ULEX_CONTENT_TYPE, [
+        (ULEX_KBIDS[args.slot], lex, 'LEX_USER_%d' % args.slot),
+        (ULEX_INDEX_KBIDS[args.slot], index,
+         'LEX_USER_%d_INDEX' % args.slot)])
+    with open(args.output, 'wb') as f:
+        f.write(rsrc.serialise(False))
+    print('%s: %d entries, %d bytes' % (rsrc_name, len(entries),
+                                        len(rsrc.serialise(False))))
+
+
+def cmd_visemes(args):
+    with open(args.ta, 'rb') as f:
+        ta = Resource(f.read())
+    table = bytearray(256)
+    mapped = {}  # phone id to the phoneme mapping it
+    skipped = []
+    with open(args.input, encoding='utf-8') as f:
+        for nr, line in enumerate(f, 1):
+            fields = line.split('#', 1)[0].split()
+            if not fields:
+                continue
+            if not fields[0].isdigit() or not 0 < int(fields[0]) < 256:
+                raise ValueError('%s:%d: expected viseme number 1-255 and '
+                                 'phonemes' % (args.input, nr))
+            for ph in fields[1:]:
+                if ph.startswith('id:') and ph[3:].isdigit():
+                    ids = bytes([int(ph[3:]) & 0xff])  # phone id as such
+                else:
+                    try:
+                        ids = phonemes_to_ids(ta, ph, 'xsampa')
+                    except ValueError:
+                        ids = b''
+                # phonemes that are no single phone of the language, and
+                # phones mapped by an earlier phoneme, are left alone
+                if len(ids) != 1 or ids[0] in mapped:
+                    skipped.append(ph)
+                    continue
+                mapped[ids[0]] = ph
+                table[ids[0]] = int(fields[0])
+    if not mapped:
+        raise ValueError('%s: no phonemes of the language' % args.input)
+    with open(args.output, 'wb') as f:
+        f.write(table)
+    print('%d phones mapped, skipped %s' % (len(mapped),
+                                            ' '.join(skipped) or 'none'))
+
+
+def cmd_list(args):
+    with open(args.input, 'rb') as f:
+        rsrc = Resource(f.read())
+    for kbid, offset, size, name in rsrc.kbs:
+        print('%3d  %-16s offset %8d  size %8d' % (kbid, name, offset, size))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Stage PicoTTS language resources for flashing')
+    sub = parser.add_subparsers(dest='cmd', required=True)
+
+    p = sub.add_parser('stage', help='stage a resource file for flashing')
+    p.add_argument('--kbdir', action='store_true',
+                   help='append a knowledge base directory trailer')
+    p.add_argument('--compress', action='append', default=[], metavar='KB',
+                   help='store the named kb block compressed (implies '
+                   '--kbdir), may be given multiple times')
+    p.add_argument('--block-size', type=int, default=1024,
+                   help='uncompressed size of a compression block')
+    p.add_argument('--strip', action='append', default=[], metavar='KB',
+                   help='remove the named optional kb, may be given '
+                   'multiple times')
+    p.add_argument('--keep', action='append', default=[], metavar='KB',
+                   help='remove every kb not named by a --keep option')
+    p.add_argument('--promote', action='append', default=[], metavar='KB',
+                   help='mark the named kb for promotion into RAM at load '
+                   'time (implies --kbdir), in order of priority')
+    p.add_argument('--lex-index', action='store_true',
+                   help='add a perfect hash index over the main lexicon '
+                   '(as kb %s)' % LEX_INDEX_NAME)
+    p.add_argument('--compose-spho', action='store_true',
+                   help='compose the sentence phonology FSTs into fewer '
+                   'FSTs where that is safe')
+    p.add_argument('input')
+    p.add_argument('output')
+    p.set_defaults(func=cmd_stage)
+
+    p = sub.add_parser('bundle',
+                       help='combine staged resource files into a bundle')
+    p.add_argument('output')
+    p.add_argument('inputs', nargs='+')
+    p.set_defaults(func=cmd_bundle)
+
+    p = sub.add_parser('ulex',
+                       help='build a user lexicon resource from a word list')
+    p.add_argument('--slot', type=int, choices=sorted(ULEX_KBIDS),
+                   default=1, help='user lexicon slot, when two user '
+                   'lexica are to be used together')
+    p.add_argument('--alphabet', choices=('xsampa', 'svoxpa'),
+                   default='xsampa', help='phonetic alphabet of the word list')
+    p.add_argument('ta', help='text analysis resource of the language')
+    p.add_argument('input', help='word list, one "word phonemes [POS]" '
+                   'per line')
+    p.add_argument('output')
+    p.set_defaults(func=cmd_ulex)
+
+    p = sub.add_parser('visemes',
+                       help='build a viseme table from a viseme list')
+    p.add_argument('ta', help='text analysis resource of the language')
+    p.add_argument('input', help='viseme list, one "viseme phonemes..." '
+                   'per line')
+    p.add_argument('output')
+    p.set_defaults(func=cmd_visemes)
+
+    p = sub.add_parser('list', help='list the knowledge bases in a resource')
+    p.add_argument('input')
+    p.set_defaults(func=cmd_list)
+
+    args = parser.parse_args()
+    try:
+        args.func(args)
+    except (OSError, ValueError) as e:
+        sys.exit('%s: %s' % (parser.prog, e))
+
+
+if __name__ == '__main__':
+    main()